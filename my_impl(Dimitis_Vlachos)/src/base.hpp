@@ -12,13 +12,22 @@ typedef uint64_t travel_indice_t;
 typedef uint64_t travel_flight_indice_pair_t;
 typedef uint64_t travel_indice_pair_t;
 
-/*Don't play with them ...the app is hardcoded to use only 2*/
+/*merge_path relations (travel_t::relation/node)*/
 static const travel_indice_t k_invalid_relation = (travel_indice_t)std::numeric_limits<travel_indice_t>::max();
-static const travel_indice_t k_mate = (travel_indice_t)1;
-static const travel_indice_t k_node_zero = 0;
-static const travel_indice_t k_node_one = 1;
-static const travel_indice_t k_node_range = 2;
+static const travel_indice_t k_range = (travel_indice_t)1;     /*merge_path keeps t1 + a range of the sorted travel2 (travel_t::range)*/
 static const travel_indice_t k_relation_shift = (sizeof(travel_indice_t) << 3) >> 1;
+static const uint8_t k_node_ranged = 0x80;                      /*travel_t::node flag : relation is a range of composition node (node & ~k_node_ranged)*/
+static const uint32_t k_compose_nodes = k_node_ranged;          /*Composition nodes of a merge phase (node id bits)*/
+
+/*Visited airports set carried by each travel : exact up to k_visited_bits airports , a bloom filter above that*/
+static const uint32_t k_visited_words = 4;
+static const uint32_t k_visited_bits = k_visited_words << 6;
+
+enum expand_mode_t {
+    expand_mode_auto = 0,                   /*Owner computes on multi socket hosts , work stealing otherwise*/
+    expand_mode_steal = 1,                  /*Shared frontier , work stealing*/
+    expand_mode_owner = 2,                  /*Airports sharded across threads , travels routed to their owner*/
+};
 
 enum flight_class_t {
     flight_class_a = 0,
@@ -53,6 +62,21 @@ struct Parameters {
     int32_t b_silent;                       /*!< Dump stuff in console..?*/
     int32_t perm_size;                      /*Size of permutation ring buffer*/
     uint32_t merge_buffer_thresold;         /*Thresold per part*/
+    int32_t b_mt_stats;                     /*Dump per thread busy/idle time of compute_path at shutdown*/
+    int32_t expand_mode;                    /*compute_path mode (expand_mode_t)*/
+    int32_t b_verify_kernels;               /*Check the vector kernels against their scalar versions at startup*/
+    int32_t force_isa;                      /*Instruction set of the vector kernels (ff_isa_t , auto : widest the CPU supports)*/
+    int32_t prefetch_distance;              /*Items ahead the batch loops prefetch flights for (default 8 , 0 : off , -1 : calibrated at startup)*/
+    uint32_t bidir_thresold;                /*Frontier size that switches compute_path to bidirectional (0 : never)*/
+    int32_t b_stream_paths;                 /*Stream the first leg into merge/find_cheapest instead of storing its paths*/
+    int32_t b_path_dag;                     /*Keep each leg as a DAG of flights and search the cheapest travel over the DAGs*/
+    int32_t b_branch_bound;                 /*Prune the DAG search against the best cost found so far (implies b_path_dag)*/
+    int32_t b_dp_engine;                    /*Cheapest travel by time ordered DP over the leg DAGs (implies b_path_dag)*/
+    int32_t b_best_first;                   /*Best first search over the leg DAGs on a multi queue (implies b_path_dag)*/
+    int32_t b_suffix_minima;                /*Cheapest join of the legs by suffix minima instead of merge_path + find_cheapest*/
+    std::string transfer_patterns_file;     /*Transfer pattern index , built/completed at startup (empty : not used)*/
+    uint64_t max_memory;                    /*compute_path/merge_path memory budget in bytes , spills to spill_dir past it (0 : no limit)*/
+    std::string spill_dir;                  /*Directory of the compute_path/merge_path spill files*/
 };
 
 extern "C" {
@@ -67,18 +91,38 @@ extern "C" {
             uint32_t index;                 /*(relative)Index in flight list*/
             f32 cost;                       /*!< The cost of the flight. */
             f32 discount;                   /*!< The discount applied to the cost. */
+            uint32_t from_id;               /*Dense id of the departure airport (flight_index.cpp)*/
+            uint32_t to_id;                 /*Dense id of the arrival airport (flight_index.cpp)*/
+            uint64_t alliance_mask;         /*Bit i : the company is in alliance i (mt.cpp , first 64 alliances)*/
         };
         uint8_t _align[64];                 /*1 cache line*/
     };
 }
 
+/*
+    Running price of a travel , kept up to date as flights are appended (mt.cpp : mt_cost_*).
+    A flight's discount only depends on its two neighbours , so everything but the last flight is final.
+*/
+struct travel_cost_t {
+    f32 fixed;                              /*Price of all flights but the last one*/
+    f32 cost;                               /*Price of the whole travel (same as compute_cost)*/
+    f32 first_tier;                         /*Discount the first flight gets from the second one (1 : single flight)*/
+    f32 last_tier;                          /*Discount the last flight gets from the one before it (1 : single flight)*/
+};
+
 /**
  * \struct travel_t
  * \brief Store a travel.
  * This structure don't need to be modified but feel free to change it if you want.
  */
 struct travel_t {
-    travel_t() : relation(k_invalid_relation) , node(k_node_zero) {}
+    travel_t() : relation(k_invalid_relation) , node(0) {
+        for (uint32_t i = 0;i < k_visited_words;++i) {
+            visited[i] = 0;
+        }
+        price.fixed = price.cost = 0.0f;
+        price.first_tier = price.last_tier = 1.0f;
+    }
  
     inline travel_t& operator= (const travel_t& other) {
         if (&other == this) {
@@ -87,16 +131,58 @@ struct travel_t {
         this->flights = other.flights;
         this->relation = other.relation;
         this->node = other.node;
+        this->price = other.price;
+        for (uint32_t i = 0;i < k_visited_words;++i) {
+            this->visited[i] = other.visited[i];
+        }
         return *this;
     }
 
-    inline void mate(const travel_indice_t a,const travel_indice_t b,const travel_indice_t n) {
-        this->node = n;
-        this->relation = (a << k_relation_shift) | b;
+    inline void swap(travel_t& other) {
+        std::swap(this->relation,other.relation);
+        std::swap(this->node,other.node);
+        std::swap(this->price,other.price);
+        for (uint32_t i = 0;i < k_visited_words;++i) {
+            std::swap(this->visited[i],other.visited[i]);
+        }
+        this->flights.swap(other.flights);
+    }
+
+    static inline uint32_t visited_word(const uint32_t airport) {
+        return (airport >> 6) & (k_visited_words - 1);
+    }
+
+    static inline uint64_t visited_mask(const uint32_t airport) {
+        return (uint64_t)1 << (airport & 63);
+    }
+
+    /*Adds a dense airport id to the visited set*/
+    inline void visit(const uint32_t airport) {
+        visited[visited_word(airport)] |= visited_mask(airport);
+    }
+
+    /*False means never visited , true is exact only when all airport ids fit in k_visited_bits*/
+    inline bool maybe_visited(const uint32_t airport) const {
+        return 0 != (visited[visited_word(airport)] & visited_mask(airport));
+    }
+
+    /*
+        This travel's flights followed by any of the sorted travel2 [first,first + count) of composition node n
+        (merge_path , k_range). Those can be ranged too : a chain of legs is never flattened before find_cheapest
+    */
+    inline void range(const travel_indice_t first,const travel_indice_t count,const travel_indice_t n) {
+        this->node = (uint8_t)(n | k_node_ranged);
+        this->relation = (first << k_relation_shift) | count;
+    }
+
+    inline bool ranged() const {
+        return (relation != k_invalid_relation) && (0 != (node & k_node_ranged));
     }
 
     travel_indice_t relation;
     uint8_t node;
+    uint64_t visited[k_visited_words];                                  /*Visited airports (see visit()/maybe_visited())*/
+    travel_cost_t price;                                                /*Running price (see travel_cost_t)*/
     std::vector<override_stl_allocator(flight_indice_t)> flights;       /*!< A travel is just a list of indices to flights. */
 };
 
@@ -0,0 +1,90 @@
+/*
+    bidir module : Backward half of the bidirectional compute_path
+*/
+
+#include "bidir.hpp"
+
+void bd_clear(suffix_table_t& table) {
+    table.begin.clear();
+    table.end.clear();
+    table.nodes.clear();
+}
+
+/*
+    Same backward sweep as fi_feasible : departures in decreasing take off order , so all successors
+    (take off after this flight lands) already have their chains. A chain of p is p alone (complete if p lands at
+    the destination , open otherwise) or p + a chain of less than max_hops flights of a successor that doesn't pass
+    through p's arrival airport. Open chains of every length are kept since the longer ones are built on them.
+*/
+boolean_t bd_build(suffix_table_t& table,const uint32_t to,const uint64_t t_mid,const uint64_t t_max,
+                   const uint64_t max_layover_time,const uint64_t* feasible,const uint32_t max_hops) {
+    const uint32_t flights_size = (uint32_t)g_flight_index.departures.size();
+    const uint64_t* take_off = &g_flight_index.departures_take_off[0];
+    const uint64_t* land = &g_flight_index.departures_land[0];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    const flight_indice_t* departures = &g_flight_index.departures[0];
+
+    bd_clear(table);
+    table.t_mid = t_mid;
+    table.max_hops = max_hops;
+    table.begin.assign(flights_size,0);
+    table.end.assign(flights_size,0);
+
+    for (uint32_t i = flights_size;i-- > 0;) {
+        const uint32_t p = g_flight_index.by_take_off[i];
+        const uint32_t a = arrival[p];
+
+        if (take_off[p] < t_mid) { //Done , everything left takes off earlier
+            break;
+        }
+
+        table.begin[p] = table.end[p] = (uint32_t)table.nodes.size();
+
+        if ((land[p] > t_max) || (0 == (fi_feasible_bits(feasible,p) & 1))) {
+            continue;
+        }
+
+        if (land[p] < take_off[p]) { //Successors could still be undecided
+            bd_clear(table);
+            return false;
+        }
+
+        suffix_node_t n;
+        n.flight = departures[p];
+        n.next = k_no_suffix;
+        n.hops = 1;
+        n.complete = (a == to);
+        for (uint32_t w = 0;w < k_visited_words;++w) {
+            n.visited[w] = 0;
+        }
+        n.visited[travel_t::visited_word(a)] |= travel_t::visited_mask(a);
+        table.nodes.push_back(n);
+
+        if (a != to) {
+            uint32_t q_first,q_last;
+            fi_next_departures(p,0,max_layover_time,q_first,q_last);
+
+            for (uint32_t q = q_first;q < q_last;++q) {
+                for (uint32_t s = table.begin[q],s_end = table.end[q];s < s_end;++s) {
+                    if ((table.nodes[s].hops >= max_hops) || 
+                        (table.nodes[s].visited[travel_t::visited_word(a)] & travel_t::visited_mask(a))) {
+                        continue;
+                    }
+
+                    n.next = s;
+                    n.hops = table.nodes[s].hops + 1;
+                    n.complete = table.nodes[s].complete;
+                    for (uint32_t w = 0;w < k_visited_words;++w) {
+                        n.visited[w] = table.nodes[s].visited[w];
+                    }
+                    n.visited[travel_t::visited_word(a)] |= travel_t::visited_mask(a);
+                    table.nodes.push_back(n);
+                }
+            }
+        }
+
+        table.end[p] = (uint32_t)table.nodes.size();
+    }
+
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef _bidir_hpp_
+#define _bidir_hpp_
+/*
+    bidir module : Backward half of the bidirectional compute_path
+    Every path to the destination is split at its first flight that takes off at or after t_mid.
+    The suffix table holds , for every departure taking off at or after t_mid , the simple flight chains
+    of up to max_hops flights that start with it : complete ones end with their first arrival at the destination ,
+    open ones have exactly max_hops flights and end elsewhere. The forward search stops at the split flight and
+    joins the travel with the chains whose airports it hasn't visited : complete chains give final travels , open
+    ones go back to the frontier and the forward search carries on from their last flight (the two halves meet
+    at depth max_hops past the split , the table stays bounded by depth whatever the length of the paths).
+*/
+#include "flight_index.hpp"
+
+static const uint32_t k_no_suffix = (uint32_t)std::numeric_limits<uint32_t>::max();
+
+struct suffix_node_t {                              /*One chain : flight + rest of the chain*/
+    flight_indice_t flight;                         /*Flight index*/
+    uint32_t next;                                  /*Node of the rest of the chain , k_no_suffix at its last flight*/
+    uint32_t hops;                                  /*Flights of the chain*/
+    boolean_t complete;                             /*Ends at the destination (else an open chain)*/
+    uint64_t visited[k_visited_words];              /*Arrival airports of the whole chain (travel_t::visited bits)*/
+};
+
+struct suffix_table_t {
+    uint64_t t_mid;                                 /*Split time*/
+    uint32_t max_hops;                              /*Depth of the backward half*/
+    std::vector<uint32_t> begin,end;                /*Chains of departure position p : nodes [begin[p],end[p])*/
+    std::vector<suffix_node_t> nodes;
+};
+
+/*
+    Builds the chains (up to max_hops flights) of every feasible departure taking off in [t_mid,..] ,
+    returns false (table cleared) if the departures can't be swept in take off order
+*/
+boolean_t bd_build(suffix_table_t& table,const uint32_t to,const uint64_t t_mid,const uint64_t t_max,
+                   const uint64_t max_layover_time,const uint64_t* feasible,const uint32_t max_hops);
+
+/*Chain s of the table is one the forward search joins : complete , or open with exactly max_hops flights*/
+static inline boolean_t bd_joinable(const suffix_table_t& table,const uint32_t s) {
+    return table.nodes[s].complete || (table.nodes[s].hops == table.max_hops);
+}
+void bd_clear(suffix_table_t& table);
+
+#endif
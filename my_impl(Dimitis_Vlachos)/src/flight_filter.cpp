@@ -0,0 +1,326 @@
+/*
+    flight_filter module : Candidate filter over the columnar departure fields
+*/
+
+#include "flight_filter.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FF_X86 1
+#include <immintrin.h>
+#endif
+
+ff_filter_fn g_ff_filter = ff_filter_scalar;            /*Until ff_init*/
+ff_delimiters_fn g_ff_delimiters = ff_delimiters_scalar;
+static ff_isa_t g_ff_isa = ff_isa_scalar;
+static const char* const k_ff_isa_names[] = { "auto" , "scalar" , "sse2" , "avx2" , "avx512" };
+
+/*One departure at a time*/
+uint64_t ff_filter_scalar(const uint64_t* land,const uint32_t* to_id,const uint32_t count,const uint64_t t_max,const uint64_t* visited) {
+    uint64_t mask = 0;
+
+    for (uint32_t i = 0;i < count;++i) {
+        const uint32_t a = to_id[i];
+        const uint64_t seen = visited[travel_t::visited_word(a)] & travel_t::visited_mask(a);
+        mask |= (uint64_t)((land[i] <= t_max) && (0 == seen)) << i;
+    }
+
+    return mask;
+}
+
+/*One byte at a time*/
+uint64_t ff_delimiters_scalar(const char* text,const uint32_t count) {
+    uint64_t mask = 0;
+
+    for (uint32_t i = 0;i < count;++i) {
+        const char c = text[i];
+        mask |= (uint64_t)((c == ';') || (c == '\r') || (c == '\n')) << i;
+    }
+
+    return mask;
+}
+
+#if defined(FF_X86)
+
+/*16 bytes per iteration*/
+__attribute__((target("sse2")))
+static uint64_t ff_delimiters_sse2(const char* text,const uint32_t count) {
+    const __m128i semicolon = _mm_set1_epi8(';');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    uint64_t mask = 0;
+    uint32_t i = 0;
+
+    for (;(i + 16) <= count;i += 16) {
+        const __m128i t = _mm_loadu_si128((const __m128i*)(text + i));
+        const __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(t,semicolon),_mm_or_si128(_mm_cmpeq_epi8(t,cr),_mm_cmpeq_epi8(t,lf)));
+        mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(hit) << i;
+    }
+
+    if (i < count) {
+        mask |= ff_delimiters_scalar(text + i,count - i) << i;
+    }
+
+    return mask;
+}
+
+/*32 bytes per iteration (also the AVX-512 one : AVX-512F has no byte compares)*/
+__attribute__((target("avx2")))
+static uint64_t ff_delimiters_avx2(const char* text,const uint32_t count) {
+    const __m256i semicolon = _mm256_set1_epi8(';');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    uint64_t mask = 0;
+    uint32_t i = 0;
+
+    for (;(i + 32) <= count;i += 32) {
+        const __m256i t = _mm256_loadu_si256((const __m256i*)(text + i));
+        const __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(t,semicolon),_mm256_or_si256(_mm256_cmpeq_epi8(t,cr),_mm256_cmpeq_epi8(t,lf)));
+        mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(hit) << i;
+    }
+
+    if (i < count) {
+        mask |= ff_delimiters_scalar(text + i,count - i) << i;
+    }
+
+    return mask;
+}
+
+/*2 departures per iteration : unsigned 64 bit compare out of 32 bit ones (SSE2 has neither) , visited bits one by one*/
+__attribute__((target("sse2")))
+static uint64_t ff_filter_sse2(const uint64_t* land,const uint32_t* to_id,const uint32_t count,const uint64_t t_max,const uint64_t* visited) {
+    const __m128i bias = _mm_set1_epi32((int)0x80000000u);
+    const __m128i tmax = _mm_xor_si128(_mm_set1_epi64x((long long)t_max),bias);
+    uint64_t mask = 0;
+    uint32_t i = 0;
+
+    for (;(i + 2) <= count;i += 2) {
+        const __m128i l = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(land + i)),bias);
+        const __m128i gt = _mm_cmpgt_epi32(l,tmax);
+        const __m128i eq = _mm_cmpeq_epi32(l,tmax);
+        //Per 64 bit lane : high word greater , or high word equal and low word greater (sign bit of the high word)
+        const __m128i late = _mm_or_si128(gt,_mm_and_si128(eq,_mm_shuffle_epi32(gt,_MM_SHUFFLE(2,2,0,0))));
+        const uint32_t reject = (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(late));
+        const uint32_t a0 = to_id[i],a1 = to_id[i + 1];
+        const uint32_t seen = (uint32_t)(0 != (visited[travel_t::visited_word(a0)] & travel_t::visited_mask(a0))) |
+                             ((uint32_t)(0 != (visited[travel_t::visited_word(a1)] & travel_t::visited_mask(a1))) << 1);
+
+        mask |= (uint64_t)(~(reject | seen) & 0x3u) << i;
+    }
+
+    if (i < count) {
+        mask |= ff_filter_scalar(land + i,to_id + i,count - i,t_max,visited) << i;
+    }
+
+    return mask;
+}
+
+/*GCC 12 flags the _mm512_undefined inputs of its own intrinsics*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/*16 departures per iteration : 2x8 land compares , 16 visited lookups with one permute*/
+__attribute__((target("avx512f")))
+static uint64_t ff_filter_avx512(const uint64_t* land,const uint32_t* to_id,const uint32_t count,const uint64_t t_max,const uint64_t* visited) {
+    const __m512i tmax = _mm512_set1_epi64((long long)t_max);
+    const __m512i vis = _mm512_broadcast_i64x4(_mm256_loadu_si256((const __m256i*)visited)); //32 bit word w in lanes w and w+8
+    const __m512i bit_mask = _mm512_set1_epi32(31);
+    const __m512i one = _mm512_set1_epi32(1);
+    uint64_t mask = 0;
+    uint32_t i = 0;
+
+    for (;(i + 16) <= count;i += 16) {
+        const __mmask8 late0 = _mm512_cmpgt_epu64_mask(_mm512_loadu_si512((const void*)(land + i)),tmax);
+        const __mmask8 late1 = _mm512_cmpgt_epu64_mask(_mm512_loadu_si512((const void*)(land + i + 8)),tmax);
+        const __m512i ids = _mm512_loadu_si512((const void*)(to_id + i));
+        const __m512i words = _mm512_permutexvar_epi32(_mm512_srli_epi32(ids,5),vis);
+        const __m512i bits = _mm512_srlv_epi32(words,_mm512_and_si512(ids,bit_mask));
+        const __mmask16 seen = _mm512_test_epi32_mask(bits,one);
+        const uint32_t reject = (uint32_t)late0 | ((uint32_t)late1 << 8) | (uint32_t)seen;
+
+        mask |= (uint64_t)(~reject & 0xffffu) << i;
+    }
+
+    if (i < count) {
+        mask |= ff_filter_scalar(land + i,to_id + i,count - i,t_max,visited) << i;
+    }
+
+    return mask;
+}
+
+#pragma GCC diagnostic pop
+
+/*8 departures per iteration : 2x4 land compares , 8 visited lookups with one permute*/
+__attribute__((target("avx2")))
+static uint64_t ff_filter_avx2(const uint64_t* land,const uint32_t* to_id,const uint32_t count,const uint64_t t_max,const uint64_t* visited) {
+    const __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ULL); //Unsigned compare via the signed one
+    const __m256i tmax = _mm256_xor_si256(_mm256_set1_epi64x((long long)t_max),bias);
+    const __m256i vis = _mm256_loadu_si256((const __m256i*)visited);
+    const __m256i bit_mask = _mm256_set1_epi32(31);
+    uint64_t mask = 0;
+    uint32_t i = 0;
+
+    for (;(i + 8) <= count;i += 8) {
+        const __m256i l0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(land + i)),bias);
+        const __m256i l1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(land + i + 4)),bias);
+        const uint32_t late = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(l0,tmax))) |
+                             ((uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(l1,tmax))) << 4);
+        const __m256i ids = _mm256_loadu_si256((const __m256i*)(to_id + i));
+        const __m256i words = _mm256_permutevar8x32_epi32(vis,_mm256_srli_epi32(ids,5));
+        const __m256i bits = _mm256_srlv_epi32(words,_mm256_and_si256(ids,bit_mask));
+        const uint32_t seen = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_slli_epi32(bits,31)));
+
+        mask |= (uint64_t)(~(late | seen) & 0xffu) << i;
+    }
+
+    if (i < count) {
+        mask |= ff_filter_scalar(land + i,to_id + i,count - i,t_max,visited) << i;
+    }
+
+    return mask;
+}
+
+#endif
+
+static ff_filter_fn ff_variant(const ff_isa_t isa) {
+    switch (isa) {
+#if defined(FF_X86)
+        case ff_isa_sse2 : return ff_filter_sse2;
+        case ff_isa_avx2 : return ff_filter_avx2;
+        case ff_isa_avx512 : return ff_filter_avx512;
+#endif
+        default : return ff_filter_scalar;
+    }
+}
+
+static ff_delimiters_fn ff_delimiters_variant(const ff_isa_t isa) {
+    switch (isa) {
+#if defined(FF_X86)
+        case ff_isa_sse2 : return ff_delimiters_sse2;
+        case ff_isa_avx2 : return ff_delimiters_avx2;
+        case ff_isa_avx512 : return ff_delimiters_avx2;
+#endif
+        default : return ff_delimiters_scalar;
+    }
+}
+
+/*cpuid (and the OS saving the wider registers , libgcc checks XCR0) , built for every x86 target*/
+boolean_t ff_supported(const ff_isa_t isa) {
+#if defined(FF_X86)
+    __builtin_cpu_init();
+    switch (isa) {
+        case ff_isa_scalar : return true;
+        case ff_isa_sse2 : return 0 != __builtin_cpu_supports("sse2");
+        case ff_isa_avx2 : return 0 != __builtin_cpu_supports("avx2");
+        case ff_isa_avx512 : return 0 != __builtin_cpu_supports("avx512f");
+        default : return false;
+    }
+#else
+    return ff_isa_scalar == isa;
+#endif
+}
+
+ff_isa_t ff_init(const ff_isa_t force) {
+    ff_isa_t isa = ff_isa_scalar;
+
+    if ((ff_isa_auto != force) && ff_supported(force)) {
+        isa = force;
+    } else {
+        if (ff_isa_auto != force) {
+            printf("Flight filter : %s not supported by this CPU , picking the best one\n",k_ff_isa_names[force]);
+        }
+        for (int32_t i = (int32_t)ff_isa_avx512;i > (int32_t)ff_isa_scalar;--i) {
+            if (ff_supported((ff_isa_t)i)) {
+                isa = (ff_isa_t)i;
+                break;
+            }
+        }
+    }
+
+    g_ff_isa = isa;
+    g_ff_filter = ff_variant(isa);
+    g_ff_delimiters = ff_delimiters_variant(isa);
+    return isa;
+}
+
+const char* ff_isa() {
+    return k_ff_isa_names[g_ff_isa];
+}
+
+/*Random blocks of every length , land times clustered around t_max so both outcomes show up*/
+static boolean_t ff_verify_variant(const ff_isa_t isa) {
+    const ff_filter_fn filter = ff_variant(isa);
+    const uint32_t rounds = 4096;
+    uint64_t land[k_filter_block];
+    uint32_t to_id[k_filter_block];
+    uint64_t visited[k_visited_words];
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+    for (uint32_t r = 0;r < rounds;++r) {
+        const uint32_t count = r % (k_filter_block + 1);
+        //Somewhere in 2012 , or (odd rounds) just under a 32 bit boundary with any high word : the SSE2 compare works on halves
+        const uint64_t t_max = (r & 1) ? (((uint64_t)(r * 0x9e3779b1u) << 32) | 0xffffffc0ULL) : (1334707200ULL + (r * 3600ULL));
+
+        for (uint32_t i = 0;i < k_visited_words;++i) {
+            seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+            visited[i] = seed & (seed >> 17);
+        }
+
+        for (uint32_t i = 0;i < count;++i) {
+            seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+            land[i] = t_max - 64 + ((seed >> 33) & 127);
+            to_id[i] = (uint32_t)(seed >> 11) & 1023; //Ids above k_visited_bits wrap like travel_t::visited_word
+        }
+
+        const uint64_t a = filter(land,to_id,count,t_max,visited);
+        const uint64_t b = ff_filter_scalar(land,to_id,count,t_max,visited);
+        if (a != b) {
+            printf("Flight filter (%s) mismatch : round %u , count %u , %llx != %llx\n",k_ff_isa_names[isa],r,count,
+                    (unsigned long long)a,(unsigned long long)b);
+            return false;
+        }
+    }
+
+    printf("Flight filter (%s) : %u blocks verified%s\n",k_ff_isa_names[isa],rounds,(isa == g_ff_isa) ? " (selected)" : "");
+    return true;
+}
+
+/*Random text blocks of every length , mostly delimiters and digits*/
+static boolean_t ff_verify_delimiters(const ff_isa_t isa) {
+    static const char k_alphabet[] = ";\r\n0A: ";
+    const ff_delimiters_fn scan = ff_delimiters_variant(isa);
+    const uint32_t rounds = 4096;
+    char text[k_filter_block];
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+
+    for (uint32_t r = 0;r < rounds;++r) {
+        const uint32_t count = r % (k_filter_block + 1);
+
+        for (uint32_t i = 0;i < count;++i) {
+            seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+            text[i] = k_alphabet[(seed >> 33) % (sizeof(k_alphabet) - 1)];
+        }
+
+        const uint64_t a = scan(text,count);
+        const uint64_t b = ff_delimiters_scalar(text,count);
+        if (a != b) {
+            printf("Tokenizer (%s) mismatch : round %u , count %u , %llx != %llx\n",k_ff_isa_names[isa],r,count,
+                    (unsigned long long)a,(unsigned long long)b);
+            return false;
+        }
+    }
+
+    printf("Tokenizer (%s) : %u blocks verified\n",k_ff_isa_names[isa],rounds);
+    return true;
+}
+
+/*Every variant this CPU runs , not only the selected one*/
+boolean_t ff_verify() {
+    for (int32_t i = (int32_t)ff_isa_sse2;i <= (int32_t)ff_isa_avx512;++i) {
+        if (ff_supported((ff_isa_t)i) && (!ff_verify_variant((ff_isa_t)i) || !ff_verify_delimiters((ff_isa_t)i))) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef _flight_filter_hpp_
+#define _flight_filter_hpp_
+/*
+    flight_filter module : Candidate filter over the columnar departure fields
+    Tests a block of up to 64 departures at once and returns a match bitmask (bit j = departure j) :
+        land_time <= t_max && !(visited has the bit of to_id)
+    Every version (scalar , SSE2 , AVX2 , AVX-512F) is built into the binary with target attributes ,
+    ff_init picks the widest one the CPU supports (cpuid) unless forced (-force_isa).
+    The flights file tokenizer's delimiter scan (parse_flights) is dispatched the same way.
+    compute_cost and the merge_path pairs are not : they gather flight records / copy flight lists per travel ,
+    there is no lane parallel work in them for a wider instruction set to take.
+*/
+#include "base.hpp"
+
+static const uint32_t k_filter_block = 64;                  /*Departures per mask word*/
+
+enum ff_isa_t {
+    ff_isa_auto = 0,                                        /*Widest supported*/
+    ff_isa_scalar,
+    ff_isa_sse2,
+    ff_isa_avx2,
+    ff_isa_avx512
+};
+
+typedef uint64_t (*ff_filter_fn)(const uint64_t* land,const uint32_t* to_id,const uint32_t count,const uint64_t t_max,const uint64_t* visited);
+
+typedef uint64_t (*ff_delimiters_fn)(const char* text,const uint32_t count);
+
+extern ff_filter_fn g_ff_filter;                            /*Selected version (scalar until ff_init)*/
+extern ff_delimiters_fn g_ff_delimiters;                    /*Selected version (scalar until ff_init)*/
+
+uint64_t ff_filter_scalar(const uint64_t* land,const uint32_t* to_id,const uint32_t count,const uint64_t t_max,const uint64_t* visited);
+uint64_t ff_delimiters_scalar(const char* text,const uint32_t count);
+
+/*count <= k_filter_block , visited : k_visited_words words (airport ids are masked like travel_t::visited_word)*/
+static inline uint64_t ff_filter(const uint64_t* land,const uint32_t* to_id,const uint32_t count,const uint64_t t_max,const uint64_t* visited) {
+    return g_ff_filter(land,to_id,count,t_max,visited);
+}
+
+/*count <= k_filter_block , bit j = text[j] is a field or line delimiter (';' , '\r' , '\n')*/
+static inline uint64_t ff_delimiters(const char* text,const uint32_t count) {
+    return g_ff_delimiters(text,count);
+}
+
+/*Selects the version (not thread safe , call before the workers start) , a forced one the CPU lacks falls back to auto*/
+ff_isa_t ff_init(const ff_isa_t force);
+boolean_t ff_supported(const ff_isa_t isa);
+
+/*Name of the selected instruction set*/
+const char* ff_isa();
+
+/*Compares every supported version against the scalar ones on random blocks , returns false on the first mismatch*/
+boolean_t ff_verify();
+
+#endif
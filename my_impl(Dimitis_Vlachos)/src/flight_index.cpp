@@ -0,0 +1,290 @@
+/*
+    flight_index module : Per airport departure lists , built once at load time
+*/
+
+#include "flight_index.hpp"
+
+flight_index_t g_flight_index;
+
+struct departure_sort_t {                                                   /*Orders departures by (take off time,flight index)*/
+    const std::vector<flight_ref_t>* flights;
+
+    inline bool operator() (const flight_indice_t a,const flight_indice_t b) const {
+        const flight_ref_t& fa = flights->at(a);
+        const flight_ref_t& fb = flights->at(b);
+        if (fa.take_off_time != fb.take_off_time) {
+            return fa.take_off_time < fb.take_off_time;
+        }
+        return a < b;
+    }
+};
+
+struct land_sort_t {                                                        /*Orders departure positions by (land time,position)*/
+    inline bool operator() (const uint32_t a,const uint32_t b) const {
+        const uint64_t la = g_flight_index.departures_land[a];
+        const uint64_t lb = g_flight_index.departures_land[b];
+        return (la != lb) ? (la < lb) : (a < b);
+    }
+};
+
+struct position_sort_t {                                                    /*Orders departure positions by (take off time,flight index)*/
+    inline bool operator() (const uint32_t a,const uint32_t b) const {
+        const uint64_t ta = g_flight_index.departures_take_off[a];
+        const uint64_t tb = g_flight_index.departures_take_off[b];
+        if (ta != tb) {
+            return ta < tb;
+        }
+        return g_flight_index.departures[a] < g_flight_index.departures[b];
+    }
+};
+
+/*Maps an airport's string index to its dense id*/
+uint32_t fi_airport_id(const indexed_string_t airport) {
+    const std::vector<indexed_string_t>& airports = g_flight_index.airports;
+    std::vector<indexed_string_t>::const_iterator it = std::lower_bound(airports.begin(),airports.end(),airport);
+
+    if ((it == airports.end()) || (*it != airport)) {
+        return k_invalid_airport;
+    }
+
+    return (uint32_t)(it - airports.begin());
+}
+
+/*
+    Assigns dense airport ids to every flight and groups flights by departure airport.
+    flights_ref[i] must be the flight with index i.
+*/
+boolean_t fi_init(std::vector<flight_ref_t>& flights_ref) {
+    const uint32_t flights_size = (uint32_t)flights_ref.size();
+    std::vector<indexed_string_t>& airports = g_flight_index.airports;
+    std::vector<uint32_t>& offset = g_flight_index.departures_offset;
+    std::vector<flight_indice_t>& departures = g_flight_index.departures;
+    std::vector<uint64_t>& take_off = g_flight_index.departures_take_off;
+    std::vector<uint64_t>& land = g_flight_index.departures_land;
+    std::vector<uint32_t>& to = g_flight_index.departures_to;
+    departure_sort_t cmp;
+
+    fi_shutdown();
+
+    //Distinct airports
+    airports.reserve((flights_size << 1) + 1);
+    for (uint32_t i = 0;i < flights_size;++i) {
+        airports.push_back(flights_ref[i].from_hash);
+        airports.push_back(flights_ref[i].to_hash);
+    }
+    std::sort(airports.begin(),airports.end());
+    airports.erase(std::unique(airports.begin(),airports.end()),airports.end());
+
+    const uint32_t airports_size = (uint32_t)airports.size();
+
+    //Count departures per airport
+    offset.assign(airports_size + 1,0);
+    for (uint32_t i = 0;i < flights_size;++i) {
+        flight_ref_t& f = flights_ref[i];
+        f.from_id = fi_airport_id(f.from_hash);
+        f.to_id = fi_airport_id(f.to_hash);
+        ++offset[f.from_id + 1];
+    }
+
+    for (uint32_t i = 0;i < airports_size;++i) {
+        offset[i + 1] += offset[i];
+    }
+
+    //Scatter + sort each airport's list by take off time
+    std::vector<uint32_t> head(offset.begin(),offset.end() - 1);
+    departures.resize(flights_size);
+    for (uint32_t i = 0;i < flights_size;++i) {
+        departures[head[flights_ref[i].from_id]++] = (flight_indice_t)i;
+    }
+
+    cmp.flights = &flights_ref;
+    take_off.resize(flights_size);
+    land.resize(flights_size);
+    to.resize(flights_size);
+    for (uint32_t i = 0;i < airports_size;++i) {
+        std::sort(departures.begin() + offset[i],departures.begin() + offset[i + 1],cmp);
+    }
+
+    g_flight_index.positions.resize(flights_size);
+    for (uint32_t i = 0;i < flights_size;++i) {
+        g_flight_index.positions[departures[i]] = i;
+        take_off[i] = flights_ref[departures[i]].take_off_time;
+        land[i] = flights_ref[departures[i]].land_time;
+        to[i] = flights_ref[departures[i]].to_id;
+    }
+
+    //Zone map
+    std::vector<departure_zone_t>& zones = g_flight_index.zones;
+    zones.resize((flights_size + k_departure_zone - 1) / k_departure_zone);
+    for (uint32_t z = 0,zones_size = (uint32_t)zones.size();z < zones_size;++z) {
+        departure_zone_t& zone = zones[z];
+        const uint32_t b = z * k_departure_zone;
+        const uint32_t e = ((flights_size - b) < k_departure_zone) ? flights_size : b + k_departure_zone;
+
+        zone.land_min = std::numeric_limits<uint64_t>::max();
+        for (uint32_t i = 0;i < k_visited_words;++i) {
+            zone.arrivals[i] = 0;
+        }
+
+        for (uint32_t i = b;i < e;++i) {
+            zone.land_min = (land[i] < zone.land_min) ? land[i] : zone.land_min;
+            zone.arrivals[travel_t::visited_word(to[i])] |= travel_t::visited_mask(to[i]);
+        }
+    }
+
+    //Global take off order , for the backward sweep of fi_feasible
+    std::vector<uint32_t>& by_take_off = g_flight_index.by_take_off;
+    by_take_off.resize(flights_size);
+    for (uint32_t i = 0;i < flights_size;++i) {
+        by_take_off[i] = i;
+    }
+    std::sort(by_take_off.begin(),by_take_off.end(),position_sort_t());
+
+    g_flight_index.visited_exact = (airports_size <= k_visited_bits);
+
+    printf("Flight index : %u airports , %u departures , %u zones\n",airports_size,flights_size,(uint32_t)zones.size());
+    return true;
+}
+
+void fi_shutdown() {
+    g_flight_index.airports.clear();
+    g_flight_index.departures_offset.clear();
+    g_flight_index.departures.clear();
+    g_flight_index.departures_take_off.clear();
+    g_flight_index.departures_land.clear();
+    g_flight_index.departures_to.clear();
+    g_flight_index.zones.clear();
+    g_flight_index.by_take_off.clear();
+    g_flight_index.positions.clear();
+    g_flight_index.inbound_offset.clear();
+    g_flight_index.inbound.clear();
+    g_flight_index.next_begin.clear();
+    g_flight_index.next_end.clear();
+    g_flight_index.connect_layover_time = 0;
+    g_flight_index.feasible.clear();
+    g_flight_index.feasible_next = 0;
+}
+
+/*
+    Feasibility profile of a leg : departure p is feasible when it lands by t_max and either arrives at to or 
+    is followed within max layover by a feasible departure (revisits are ignored , so it's only a necessary condition).
+    One backward sweep in take off order : a successor takes off after its predecessor lands , so it's always decided first.
+    next_feasible[p] is the first feasible position >= p of p's departure list among the decided ones.
+*/
+const uint64_t* fi_feasible(const uint32_t to,const uint64_t t_max,const uint64_t max_layover_time) {
+    std::vector<feasible_profile_t>& cache = g_flight_index.feasible;
+    const uint32_t flights_size = (uint32_t)g_flight_index.departures.size();
+
+    for (uint32_t i = 0,j = (uint32_t)cache.size();i < j;++i) {
+        if ((cache[i].to == to) && (cache[i].t_max == t_max) && (cache[i].max_layover_time == max_layover_time)) {
+            return &cache[i].bits[0];
+        }
+    }
+
+    if (cache.size() < k_feasible_cache) {
+        cache.push_back(feasible_profile_t());
+        g_flight_index.feasible_next = (uint32_t)cache.size() - 1;
+    }
+
+    feasible_profile_t& profile = cache[g_flight_index.feasible_next];
+    g_flight_index.feasible_next = (g_flight_index.feasible_next + 1) % k_feasible_cache;
+
+    profile.to = to;
+    profile.t_max = t_max;
+    profile.max_layover_time = max_layover_time;
+    profile.bits.assign((flights_size / k_departure_zone) + 1,0);
+
+    const uint64_t* take_off = &g_flight_index.departures_take_off[0];
+    const uint64_t* land = &g_flight_index.departures_land[0];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    const uint32_t* offset = &g_flight_index.departures_offset[0];
+    std::vector<uint32_t> next_feasible(flights_size,flights_size); //flights_size : none (yet)
+
+    for (uint32_t i = flights_size;i-- > 0;) {
+        const uint32_t p = g_flight_index.by_take_off[i];
+        const uint32_t a = arrival[p];
+        boolean_t ok = (land[p] <= t_max);
+
+        if (ok && (a != to) && (land[p] >= take_off[p])) { //(A flight landing before its take off can't rely on the sweep order)
+            const uint32_t q = (max_layover_time == g_flight_index.connect_layover_time) ? g_flight_index.next_begin[p] :
+                               (uint32_t)(std::upper_bound(take_off + offset[a],take_off + offset[a + 1],land[p]) - take_off);
+
+            ok = (q < offset[a + 1]) && (next_feasible[q] < offset[a + 1]) && 
+                 (take_off[next_feasible[q]] <= (land[p] + max_layover_time));
+        }
+
+        //Positions after p in its own list are decided already , anything past the list's end is >= its end
+        if (ok) {
+            profile.bits[p / k_departure_zone] |= (uint64_t)1 << (p % k_departure_zone);
+            next_feasible[p] = p;
+        } else if ((p + 1) < flights_size) {
+            next_feasible[p] = next_feasible[p + 1];
+        }
+    }
+
+    return &profile.bits[0];
+}
+
+/*
+    Connection graph for max_layover_time : flights grouped by arrival airport and sorted by land time ,
+    fi_connect then sweeps each group against the airport's departure list.
+*/
+void fi_connect_init(const uint64_t max_layover_time) {
+    const uint32_t flights_size = (uint32_t)g_flight_index.departures.size();
+    const uint32_t airports_size = fi_airports();
+    const uint32_t* to = &g_flight_index.departures_to[0];
+    std::vector<uint32_t>& offset = g_flight_index.inbound_offset;
+    std::vector<uint32_t>& inbound = g_flight_index.inbound;
+
+    offset.assign(airports_size + 1,0);
+    for (uint32_t p = 0;p < flights_size;++p) {
+        ++offset[to[p] + 1];
+    }
+
+    for (uint32_t i = 0;i < airports_size;++i) {
+        offset[i + 1] += offset[i];
+    }
+
+    std::vector<uint32_t> head(offset.begin(),offset.end() - 1);
+    inbound.resize(flights_size);
+    for (uint32_t p = 0;p < flights_size;++p) {
+        inbound[head[to[p]]++] = p;
+    }
+
+    for (uint32_t i = 0;i < airports_size;++i) {
+        std::sort(inbound.begin() + offset[i],inbound.begin() + offset[i + 1],land_sort_t());
+    }
+
+    g_flight_index.next_begin.assign(flights_size,0);
+    g_flight_index.next_end.assign(flights_size,0);
+    g_flight_index.connect_layover_time = max_layover_time;
+}
+
+/*Both windows only move forward as the land time grows : one merge like pass per airport*/
+void fi_connect(const uint32_t airport) {
+    const uint64_t* take_off = &g_flight_index.departures_take_off[0];
+    const uint64_t* land = &g_flight_index.departures_land[0];
+    const uint64_t max_layover_time = g_flight_index.connect_layover_time;
+    const uint32_t end = fi_departures_end(airport);
+    uint32_t first = g_flight_index.departures_offset[airport],last = first;
+
+    for (uint32_t i = g_flight_index.inbound_offset[airport],j = g_flight_index.inbound_offset[airport + 1];i < j;++i) {
+        const uint32_t p = g_flight_index.inbound[i];
+
+        while ((first < end) && (take_off[first] <= land[p])) {
+            ++first;
+        }
+        last = (last > first) ? last : first;
+        while ((last < end) && (take_off[last] <= (land[p] + max_layover_time))) {
+            ++last;
+        }
+
+        g_flight_index.next_begin[p] = first;
+        g_flight_index.next_end[p] = last;
+    }
+}
+
+uint64_t fi_connect_bytes() {
+    return (g_flight_index.inbound_offset.capacity() + g_flight_index.inbound.capacity() +
+            g_flight_index.next_begin.capacity() + g_flight_index.next_end.capacity()) * sizeof(uint32_t);
+}
@@ -0,0 +1,120 @@
+#ifndef _flight_index_hpp_
+#define _flight_index_hpp_
+/*
+    flight_index module : Per airport departure lists , built once at load time
+*/
+#include "base.hpp"
+#include <algorithm>
+
+static const uint32_t k_invalid_airport = (uint32_t)std::numeric_limits<uint32_t>::max();
+static const uint32_t k_departure_zone = 64;        /*Departures per zone map entry (<= k_filter_block)*/
+
+struct departure_zone_t {                           /*Summary of k_departure_zone consecutive departures*/
+    uint64_t land_min;                              /*Earliest land time*/
+    uint64_t arrivals[k_visited_words];             /*Arrival airports , same bits as travel_t::visited*/
+};
+
+static const uint32_t k_feasible_cache = 8;         /*Feasibility profiles kept around*/
+
+struct feasible_profile_t {                         /*Departures that can still reach to before t_max*/
+    uint32_t to;                                    /*Dense id of destination*/
+    uint64_t t_max,max_layover_time;
+    std::vector<uint64_t> bits;                     /*Bit p = departure position p is feasible*/
+};
+
+struct flight_index_t {
+    std::vector<indexed_string_t> airports;         /*Dense airport id -> string index (sorted)*/
+    std::vector<uint32_t> departures_offset;        /*Departures of airport a live in [offset[a],offset[a+1])*/
+    std::vector<flight_indice_t> departures;        /*Flight indices grouped by departure airport , sorted by take off time*/
+    std::vector<uint64_t> departures_take_off;      /*Take off time of each departure (columnar copy for the binary searches)*/
+    std::vector<uint64_t> departures_land;          /*Land time of each departure (columnar , flight_filter)*/
+    std::vector<uint32_t> departures_to;            /*Dense arrival airport id of each departure (columnar , flight_filter)*/
+    std::vector<departure_zone_t> zones;            /*Zone map : departures [z * k_departure_zone,(z + 1) * k_departure_zone)*/
+    std::vector<uint32_t> by_take_off;              /*Departure positions ordered by (take off time,flight index)*/
+    std::vector<uint32_t> positions;                /*Flight index -> departure position*/
+    std::vector<uint32_t> inbound_offset;           /*Arrivals of airport a live in inbound[inbound_offset[a],inbound_offset[a+1])*/
+    std::vector<uint32_t> inbound;                  /*Departure positions grouped by arrival airport , sorted by land time*/
+    std::vector<uint32_t> next_begin;               /*Connection graph : departures that can follow p are [next_begin[p],next_end[p])*/
+    std::vector<uint32_t> next_end;                 /*(a window of the arrival airport's departure list)*/
+    uint64_t connect_layover_time;                  /*Max layover of the connection graph (0 : not built)*/
+    std::vector<feasible_profile_t> feasible;       /*Feasibility profile cache (round robin)*/
+    uint32_t feasible_next;                         /*Next cache slot to replace*/
+    boolean_t visited_exact;                        /*All airport ids fit in travel_t::visited*/
+};
+
+extern flight_index_t g_flight_index;
+
+boolean_t fi_init(std::vector<flight_ref_t>& flights_ref);
+void fi_shutdown();
+uint32_t fi_airport_id(const indexed_string_t airport);
+const uint64_t* fi_feasible(const uint32_t to,const uint64_t t_max,const uint64_t max_layover_time);
+
+/*Connection graph : fi_connect_init once , then fi_connect for every airport (any thread , any order)*/
+void fi_connect_init(const uint64_t max_layover_time);
+void fi_connect(const uint32_t airport);
+uint64_t fi_connect_bytes();
+
+/*64 feasibility bits of the departures [pos,zone end) , pos's zone is one word of the profile*/
+static inline uint64_t fi_feasible_bits(const uint64_t* feasible,const uint32_t pos) {
+    return feasible[pos / k_departure_zone] >> (pos % k_departure_zone);
+}
+
+/*Number of distinct airports*/
+static inline uint32_t fi_airports() {
+    return (uint32_t)g_flight_index.airports.size();
+}
+
+/*End of airport's departure list*/
+static inline uint32_t fi_departures_end(const uint32_t airport) {
+    return g_flight_index.departures_offset[airport + 1];
+}
+
+/*True when no departure of zone can pass : all land after t_max , or all arrive at visited airports*/
+static inline boolean_t fi_zone_rejects(const uint32_t zone,const uint64_t t_max,const uint64_t* visited) {
+    const departure_zone_t& z = g_flight_index.zones[zone];
+    uint64_t unvisited = 0;
+
+    for (uint32_t i = 0;i < k_visited_words;++i) {
+        unvisited |= z.arrivals[i] & ~visited[i];
+    }
+
+    return (z.land_min > t_max) || (0 == unvisited);
+}
+
+/*Range [first,last) of departures from airport that take off in [t_lo,t_hi]*/
+static inline void fi_departures_window(const uint32_t airport,const uint64_t t_lo,const uint64_t t_hi,
+                                        uint32_t& first,uint32_t& last) {
+    if ((airport >= fi_airports()) || (t_lo > t_hi)) {
+        first = last = 0;
+        return;
+    }
+
+    const uint64_t* base = &g_flight_index.departures_take_off.front();
+    const uint64_t* b = base + g_flight_index.departures_offset[airport];
+    const uint64_t* e = base + g_flight_index.departures_offset[airport + 1];
+
+    b = std::lower_bound(b,e,t_lo);
+    e = std::upper_bound(b,e,t_hi);
+
+    first = (uint32_t)(b - base);
+    last = (uint32_t)(e - base);
+}
+
+/*
+    Departures that can follow position p (take off within (land,land + max layover]) and take off at t_min or later.
+    One lookup in the connection graph when it was built for max_layover_time , binary searches otherwise.
+*/
+static inline void fi_next_departures(const uint32_t p,const uint64_t t_min,const uint64_t max_layover_time,
+                                      uint32_t& first,uint32_t& last) {
+    const uint64_t land = g_flight_index.departures_land[p];
+
+    if (((land + 1) >= t_min) && (max_layover_time == g_flight_index.connect_layover_time)) {
+        first = g_flight_index.next_begin[p];
+        last = g_flight_index.next_end[p];
+        return;
+    }
+
+    fi_departures_window(g_flight_index.departures_to[p],((land + 1) > t_min) ? land + 1 : t_min,land + max_layover_time,first,last);
+}
+
+#endif
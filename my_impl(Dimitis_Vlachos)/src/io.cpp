@@ -79,6 +79,9 @@ boolean_t streamed_travel_list_writer_c::init(const std::vector<override_stl_all
         write(hdr,hdr_buffer,hdr_buffer_head,hdr_buffer_len,(flight_indice_t)flights_size); 
         write(hdr,hdr_buffer,hdr_buffer_head,hdr_buffer_len,(flight_indice_t)(data_stream_offs >> 32));
         write(hdr,hdr_buffer,hdr_buffer_head,hdr_buffer_len,(flight_indice_t)(data_stream_offs));
+        write(hdr,hdr_buffer,hdr_buffer_head,hdr_buffer_len,(flight_indice_t)(travels[i].relation >> 32)); //merge_path composition
+        write(hdr,hdr_buffer,hdr_buffer_head,hdr_buffer_len,(flight_indice_t)(travels[i].relation));
+        write(hdr,hdr_buffer,hdr_buffer_head,hdr_buffer_len,(flight_indice_t)travels[i].node);
 
         //Data section
         for (uint32_t j = 0;j < flights_size;++j) {
@@ -108,20 +111,14 @@ void streamed_travel_list_reader_c::shutdown() {
         fclose(m_hdr);
 
         //Cleanup contexts
-        m_hdr = fopen(m_hdr_filename.c_str(),"wb");
-        if (m_hdr) {
-            fclose(m_hdr);
-        }
+        remove(m_hdr_filename.c_str());
     }
 
     if (m_data) {
         fclose(m_data);
 
         //Cleanup contexts
-        m_data = fopen(m_data_filename.c_str(),"wb");
-        if (m_data) {
-            fclose(m_data);
-        }
+        remove(m_data_filename.c_str());
     }
 
     m_hdr_buffer = 0;
@@ -148,8 +145,7 @@ boolean_t streamed_travel_list_reader_c::next_bulk(std::vector<override_stl_allo
         rd_len = m_hdr_len - m_hdr_head;
     }
 
-    rd_block_len = (rd_len * sizeof(flight_indice_t));
-    rd_block_len = (rd_block_len << 1) + rd_block_len;
+    rd_block_len = rd_len * k_stream_record_words * sizeof(flight_indice_t);
     
     uint64_t dummy;
 
@@ -159,11 +155,13 @@ boolean_t streamed_travel_list_reader_c::next_bulk(std::vector<override_stl_allo
     res.reserve(rd_len);
 
     for (uint64_t i = 0;i < rd_len;++i) {
-        const uint64_t indice = (i << 1) + i;
+        const uint64_t indice = i * k_stream_record_words;
         const uint64_t offset = ((uint64_t)m_hdr_buffer[indice + 1] << 32) | (uint64_t)m_hdr_buffer[indice + 2];
 
         res.push_back(travel_t());
         res.back().flights.resize(m_hdr_buffer[indice]);
+        res.back().relation = ((travel_indice_t)m_hdr_buffer[indice + 3] << 32) | (travel_indice_t)m_hdr_buffer[indice + 4];
+        res.back().node = (uint8_t)m_hdr_buffer[indice + 5];
     
         fseeko64(m_data,offset,SEEK_SET);//SEEK_CURR);
         dummy += fread((void*)&res.back().flights.front(),sizeof(flight_indice_t),m_hdr_buffer[indice],m_data);
@@ -196,7 +194,7 @@ boolean_t streamed_travel_list_reader_c::init(const std::vector<override_stl_all
     m_hdr_filename = hdr_fn;
     m_data_filename = data_fn;
 
-    m_hdr_buffer = new flight_indice_t[bulk_size * 3];
+    m_hdr_buffer = new flight_indice_t[bulk_size * k_stream_record_words];
 
     m_hdr = fopen64(hdr_fn.c_str(),"rb");
     if (!m_hdr) {
@@ -12,13 +12,16 @@
 
 //TODO MMAPPED stream reader ?
 
+/*hdr.bin : travel count (2 words) + pad , then one record per travel : flights , data.bin offset (2) , relation (2) , node*/
+static const uint32_t k_stream_record_words = 6;
+
 class streamed_travel_list_c {
     private:
 
     public:
 
     streamed_travel_list_c() {}
-    ~streamed_travel_list_c() {  }
+    virtual ~streamed_travel_list_c() {  }
 
     virtual boolean_t init(const std::vector<override_stl_allocator(travel_t)>& travels,const std::string& fpath,
                         const uint32_t bulk_size) { return false; }
@@ -0,0 +1,100 @@
+/*
+    leg_join module : Cheapest join of consecutive legs without building the merged lists
+*/
+
+#include "leg_join.hpp"
+
+void lj_clear(join_table_t& table) {
+    table.take_off.clear();
+    table.all.clear();
+    table.group_offset.clear();
+    table.members.clear();
+    table.same.clear();
+    table.partner.clear();
+}
+
+/*One counting sort pass for the company groups (positions stay ascending) , then each suffix min is a backward sweep*/
+void lj_build(join_table_t& table,const std::vector<leg_summary_t>& summaries,const std::vector<f32>& value,const uint32_t companies) {
+    const uint32_t n = (uint32_t)summaries.size();
+
+    table.take_off.resize(n);
+    table.all.resize(n + 1);
+    table.group_offset.assign(companies + 1,0);
+    table.members.resize(n);
+    table.same.resize(n);
+    table.partner.resize(n);
+
+    for (uint32_t i = 0;i < n;++i) {
+        table.take_off[i] = summaries[i].take_off;
+        ++table.group_offset[summaries[i].first_company + 1];
+    }
+
+    for (uint32_t c = 0;c < companies;++c) {
+        table.group_offset[c + 1] += table.group_offset[c];
+    }
+
+    std::vector<uint32_t> fill(table.group_offset.begin(),table.group_offset.end() - 1);
+    for (uint32_t i = 0;i < n;++i) {
+        table.members[fill[summaries[i].first_company]++] = i;
+    }
+
+    table.all[n] = std::numeric_limits<f32>::infinity();
+    for (uint32_t i = n;i-- > 0;) {
+        const f32 v = value[(i * k_join_classes) + 0];
+        table.all[i] = (v < table.all[i + 1]) ? v : table.all[i + 1];
+    }
+
+    for (uint32_t c = 0;c < companies;++c) {
+        f32 same = std::numeric_limits<f32>::infinity();
+        f32 partner = std::numeric_limits<f32>::infinity();
+
+        for (uint32_t k = table.group_offset[c + 1];k-- > table.group_offset[c];) {
+            const f32* v = &value[table.members[k] * k_join_classes];
+            partner = (v[1] < partner) ? v[1] : partner;
+            same = (v[2] < same) ? v[2] : same;
+            table.partner[k] = partner;
+            table.same[k] = same;
+        }
+    }
+}
+
+/*First member of group c at or after position first*/
+static inline uint32_t lj_group_lower_bound(const join_table_t& table,const uint32_t c,const uint32_t first) {
+    const uint32_t* b = &table.members[0] + table.group_offset[c];
+    const uint32_t* e = &table.members[0] + table.group_offset[c + 1];
+
+    return (uint32_t)(std::lower_bound(b,e,first) - &table.members[0]);
+}
+
+uint32_t lj_best(const join_table_t& table,const join_partners_t& partners,const uint64_t land,const uint32_t company,f32* best) {
+    const uint32_t n = (uint32_t)table.take_off.size();
+    const uint32_t first = (uint32_t)(std::upper_bound(table.take_off.begin(),table.take_off.end(),land) - table.take_off.begin());
+
+    for (uint32_t c = 0;c < k_join_classes;++c) {
+        best[c] = std::numeric_limits<f32>::infinity();
+    }
+
+    if (first == n) {
+        return first;
+    }
+
+    best[0] = table.all[first];
+
+    //Same company
+    uint32_t k = lj_group_lower_bound(table,company,first);
+    if (k < table.group_offset[company + 1]) {
+        best[2] = table.same[k];
+    }
+
+    //Shared alliance
+    for (uint32_t p = partners.offset[company],p_end = partners.offset[company + 1];p < p_end;++p) {
+        const uint32_t c = partners.partners[p];
+
+        k = lj_group_lower_bound(table,c,first);
+        if ((k < table.group_offset[c + 1]) && (table.partner[k] < best[1])) {
+            best[1] = table.partner[k];
+        }
+    }
+
+    return first;
+}
@@ -0,0 +1,74 @@
+#ifndef _leg_join_hpp_
+#define _leg_join_hpp_
+/*
+    leg_join module : Cheapest join of consecutive legs without building the merged lists (-suffix_minima)
+    Each travel of a leg is reduced to a fixed size summary , its price only depends on the discount tier of its
+    two junctions (lj_price). Tiers are 1 (any pair) , 0.8 (shared alliance) and 0.7 (same company) and a price never
+    drops when a tier grows , so the cheapest continuation of a travel is the min over three junction classes of a
+    suffix minimum over the next leg (sorted by first take off) : over all of it (1) , over the companies that share
+    an alliance with our last flight's one (0.8) , over our last flight's company (0.7).
+    A travel seen in a class above its real one only gets a higher price , its own class still has the right one.
+*/
+#include "base.hpp"
+
+static const uint32_t k_join_classes = 3;                      /*Junction classes*/
+static const f32 k_join_tier[k_join_classes] = { 1.0f , 0.8f , 0.7f };
+
+struct leg_summary_t {                                          /*Fixed size record of a travel*/
+    uint64_t take_off,land;                                     /*First flight take off , last flight land*/
+    uint32_t first_company,last_company;                        /*Dense company ids*/
+    uint32_t travel;                                            /*Position in the leg's travel list*/
+    uint32_t hops;                                              /*Flights*/
+    f32 inner;                                                  /*Final price of the flights between the first and the last one*/
+    f32 first_cost,last_cost;                                   /*Full price of the first/last flight*/
+    f32 first_tier,last_tier;                                   /*Tier of the junction inside the travel next to the first/last flight*/
+
+    inline bool operator< (const leg_summary_t& other) const {  /*By take off , ties keep the travel list order*/
+        return (take_off != other.take_off) ? (take_off < other.take_off) : (travel < other.travel);
+    }
+};
+
+struct join_partners_t {                                        /*Companies sharing an alliance with c (c included) : CSR*/
+    uint32_t companies;
+    std::vector<uint32_t> offset;
+    std::vector<uint32_t> partners;
+    std::vector<uint8_t> shared;                                /*[c1 * companies + c2] : c1 and c2 share an alliance*/
+};
+
+struct join_table_t {                                           /*Suffix minima of a leg (summaries sorted by take off)*/
+    std::vector<uint64_t> take_off;
+    std::vector<f32> all;                                       /*[i] : min of the class 1 values of [i,n)*/
+    std::vector<uint32_t> group_offset;                         /*Positions of company c : members [group_offset[c],group_offset[c + 1])*/
+    std::vector<uint32_t> members;                              /*Ascending within a group*/
+    std::vector<f32> same,partner;                              /*Suffix minima of the 0.7 / 0.8 values within each group*/
+};
+
+/*Price of the travel's flights given the tiers of its left/right junctions (1 : no junction)*/
+static inline f32 lj_price(const leg_summary_t& s,const f32 left,const f32 right) {
+    if (1 == s.hops) {
+        return s.first_cost * ((left < right) ? left : right);
+    }
+
+    return s.inner + (s.first_cost * ((left < s.first_tier) ? left : s.first_tier)) +
+           (s.last_cost * ((s.last_tier < right) ? s.last_tier : right));
+}
+
+/*Junction class of a last flight flown by c1 followed by a first flight flown by c2*/
+static inline uint32_t lj_class(const join_partners_t& partners,const uint32_t c1,const uint32_t c2) {
+    return (c1 == c2) ? 2 : partners.shared[(c1 * partners.companies) + c2];
+}
+
+/*
+    summaries : the leg sorted , value : k_join_classes values per summary (cheapest price from it to the end
+    of the chain with that tier on its left junction) , companies : dense company count
+*/
+void lj_build(join_table_t& table,const std::vector<leg_summary_t>& summaries,const std::vector<f32>& value,const uint32_t companies);
+void lj_clear(join_table_t& table);
+
+/*
+    Cheapest value per junction class (+infinity : none) of the travels taking off after land ,
+    for a travel whose last flight is flown by company. Returns the first such position.
+*/
+uint32_t lj_best(const join_table_t& table,const join_partners_t& partners,const uint64_t land,const uint32_t company,f32* best);
+
+#endif
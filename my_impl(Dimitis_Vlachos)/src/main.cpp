@@ -8,6 +8,8 @@
 #include "base.hpp"
 #include "mt.hpp"
 #include "profiling.hpp"
+#include "path_dag.hpp"
+#include "flight_filter.hpp"
 
 using namespace std;
 
@@ -18,7 +20,7 @@ void print_params(Parameters &parameters);
 void print_flight(flight_indice_t ref_ind,ofstream& output);
 void read_parameters(Parameters& parameters, int32_t argc, char **argv);
 void split_string(vector<string>& result, string line, char separator);
-void parse_flights(Parameters& params,vector<flight_ref_t>& flights_ref);
+void parse_flights(Parameters& params,vector<flight_ref_t>& flights_ref,vector<flight_ref_t>& schedule);
 void parse_alliance(vector<string> &alliance, string line);
 void parse_alliances(vector<vector<indexed_string_t> > &alliances, string filename);
 bool company_are_in_a_common_alliance(const string& c1, const string& c2, vector<vector<indexed_string_t> >& alliances);
@@ -41,12 +43,9 @@ void env_init(); /*For optimized time_gm*/
 
 char* g_timezone = 0; /*For optimized time_gm*/
 
-static travel_t find_cheapest(vector<override_stl_allocator(travel_t)>& travels, vector<vector<indexed_string_t> >&alliances){
-    travel_t result;
+static boolean_t find_cheapest(travel_t& result,f32& cost,vector<override_stl_allocator(travel_t)>& travels, vector<vector<indexed_string_t> >&alliances){
     profiler_profile_me();
-    mt_find_cheapest(result,travels,alliances);
-    
-    return result;//compiler's RVO opt pass does its job
+    return mt_find_cheapest(result,cost,travels,alliances);
 }
 
 static void compute_path(const indexed_string_t to,vector<override_stl_allocator(travel_t)>& travels, uint64_t t_min, uint64_t t_max, Parameters parameters) {
@@ -59,14 +58,190 @@ static void fill_travel(vector<override_stl_allocator(travel_t)>& travels,indexe
     mt_fill_travel(travels,starting_point,t_min,t_max);
 }
 
-static void merge_path(vector<override_stl_allocator(travel_t)>& travel1, vector<override_stl_allocator(travel_t)>& travel2,const travel_indice_t relation = k_invalid_relation,const travel_indice_t node = k_node_zero) {
+static void merge_path(vector<override_stl_allocator(travel_t)>& travel1, vector<override_stl_allocator(travel_t)>& travel2,const travel_indice_t relation = k_invalid_relation,const boolean_t b_spill = false) {
+    profiler_profile_me();
+    mt_merge_path(travel1,travel2,relation,b_spill);
+}
+
+/*compute_path of the first leg + merge_path with the tails + find_cheapest , without storing the first leg's paths*/
+static boolean_t stream_cheapest(travel_t& result,f32& cost,const indexed_string_t to,vector<override_stl_allocator(travel_t)>& travels, uint64_t t_min, uint64_t t_max,
+                                 const vector<override_stl_allocator(travel_t)>* const* tails,const uint32_t tail_count) {
+    profiler_profile_me();
+    return mt_stream_cheapest(result,cost,to,travels,t_min,t_max,tails,tail_count);
+}
+
+/*Streamed work_hard : only the way back is stored*/
+static travel_t work_hard_streamed(Parameters& parameters) {
+    vector<override_stl_allocator(travel_t)> travels,travels_back;
+    const vector<override_stl_allocator(travel_t)>* tails[] = { &travels_back };
+    travel_t result;
+    f32 cost;
+
+    fill_travel(travels_back,parameters.to, parameters.ar_time_min, parameters.ar_time_max);
+    compute_path(parameters.from, travels_back, parameters.ar_time_min, parameters.ar_time_max, parameters);
+
+    fill_travel(travels,parameters.from, parameters.dep_time_min, parameters.dep_time_max);
+    stream_cheapest(result,cost,parameters.to,travels,parameters.dep_time_min,parameters.dep_time_max,tails,1);
+    return result;
+}
+
+/*Streamed play_hard for one airport : the first leg of each order is streamed , the other two are stored*/
+static travel_t play_hard_streamed(Parameters& parameters,const indexed_string_t vacation) {
+    vector<override_stl_allocator(travel_t)> travels,vacation_to_conference,conference_to_home;
+    vector<override_stl_allocator(travel_t)> conference_to_vacation,vacation_to_home;
+    const vector<override_stl_allocator(travel_t)>* tails1[] = { &vacation_to_conference , &conference_to_home };
+    const vector<override_stl_allocator(travel_t)>* tails2[] = { &conference_to_vacation , &vacation_to_home };
+    travel_t result1,result2;
+    f32 cost1,cost2;
+    boolean_t found1,found2;
+
+    //home -> vacation -> conference -> home
+    fill_travel(vacation_to_conference,vacation, parameters.dep_time_min, parameters.dep_time_max);
+    compute_path(parameters.to,vacation_to_conference, parameters.dep_time_min, parameters.dep_time_max, parameters);
+    fill_travel(conference_to_home, parameters.to, parameters.ar_time_min, parameters.ar_time_max);
+    compute_path( parameters.from,conference_to_home, parameters.ar_time_min, parameters.ar_time_max, parameters);
+    fill_travel(travels, parameters.from, parameters.dep_time_min-parameters.vacation_time_max, parameters.dep_time_min-parameters.vacation_time_min);
+    found1 = stream_cheapest(result1,cost1,vacation,travels, parameters.dep_time_min-parameters.vacation_time_max, 
+                             parameters.dep_time_min-parameters.vacation_time_min,tails1,2);
+
+    //home -> conference -> vacation -> home
+    fill_travel(conference_to_vacation,parameters.to, parameters.ar_time_min, parameters.ar_time_max);
+    compute_path( vacation,conference_to_vacation, parameters.ar_time_min, parameters.ar_time_max, parameters);
+    fill_travel(vacation_to_home,vacation, parameters.ar_time_max+parameters.vacation_time_min, parameters.ar_time_max+parameters.vacation_time_max);
+    compute_path( parameters.from,vacation_to_home, parameters.ar_time_max+parameters.vacation_time_min, parameters.ar_time_max+parameters.vacation_time_max, parameters);
+    fill_travel(travels, parameters.from, parameters.dep_time_min, parameters.dep_time_max);
+    found2 = stream_cheapest(result2,cost2,parameters.to,travels, parameters.dep_time_min, parameters.dep_time_max,tails2,2);
+
+    //Ties go to the second order like in find_cheapest over both lists
+    if (found2 && (!found1 || (cost2 <= cost1))) {
+        return result2;
+    }
+
+    return result1;
+}
+
+/*Leg as a DAG of flights instead of a list of travels*/
+static void build_path_dag(path_dag_t& dag,const indexed_string_t from,const indexed_string_t to, uint64_t t_min, uint64_t t_max) {
+    vector<override_stl_allocator(travel_t)> travels;
     profiler_profile_me();
-    mt_merge_path(travel1,travel2,relation,node);
+    mt_fill_travel(travels,from,t_min,t_max);
+    mt_build_path_dag(dag,to,travels,t_min,t_max);
+}
+
+static boolean_t dag_cheapest(travel_t& result,f32& cost,path_dag_t* const* dags,const uint32_t leg_count) {
+    profiler_profile_me();
+    return mt_dag_cheapest(result,cost,dags,leg_count);
+}
+
+/*work_hard over leg DAGs : no travel list is ever stored*/
+static travel_t work_hard_dag(Parameters& parameters) {
+    path_dag_t there,back;
+    path_dag_t* dags[] = { &there , &back };
+    travel_t result;
+    f32 cost;
+
+    build_path_dag(there,parameters.from,parameters.to,parameters.dep_time_min,parameters.dep_time_max);
+    build_path_dag(back,parameters.to,parameters.from,parameters.ar_time_min,parameters.ar_time_max);
+    dag_cheapest(result,cost,dags,2);
+    return result;
+}
+
+/*play_hard for one airport over leg DAGs*/
+static travel_t play_hard_dag(Parameters& parameters,const indexed_string_t vacation) {
+    path_dag_t legs[6];
+    path_dag_t* order1[] = { &legs[0] , &legs[1] , &legs[2] };
+    path_dag_t* order2[] = { &legs[3] , &legs[4] , &legs[5] };
+    travel_t result1,result2;
+    f32 cost1,cost2;
+    boolean_t found1,found2;
+
+    //home -> vacation -> conference -> home
+    build_path_dag(legs[0],parameters.from,vacation,parameters.dep_time_min-parameters.vacation_time_max,parameters.dep_time_min-parameters.vacation_time_min);
+    build_path_dag(legs[1],vacation,parameters.to,parameters.dep_time_min,parameters.dep_time_max);
+    build_path_dag(legs[2],parameters.to,parameters.from,parameters.ar_time_min,parameters.ar_time_max);
+    found1 = dag_cheapest(result1,cost1,order1,3);
+
+    //home -> conference -> vacation -> home
+    build_path_dag(legs[3],parameters.from,parameters.to,parameters.dep_time_min,parameters.dep_time_max);
+    build_path_dag(legs[4],parameters.to,vacation,parameters.ar_time_min,parameters.ar_time_max);
+    build_path_dag(legs[5],vacation,parameters.from,parameters.ar_time_max+parameters.vacation_time_min,parameters.ar_time_max+parameters.vacation_time_max);
+    found2 = dag_cheapest(result2,cost2,order2,3);
+
+    //Ties go to the second order like in find_cheapest over both lists
+    if (found2 && (!found1 || (cost2 <= cost1))) {
+        return result2;
+    }
+
+    return result1;
+}
+
+/*Travel list of a leg (fill_travel + compute_path)*/
+static void build_leg(vector<override_stl_allocator(travel_t)>& travels,const indexed_string_t from,const indexed_string_t to,
+                      uint64_t t_min,uint64_t t_max,Parameters& parameters) {
+    fill_travel(travels,from,t_min,t_max);
+    compute_path(to,travels,t_min,t_max,parameters);
+}
+
+static boolean_t join_cheapest(travel_t& result,f32& cost,vector<override_stl_allocator(travel_t)>* const* legs,const uint32_t leg_count) {
+    profiler_profile_me();
+    return mt_join_cheapest(result,cost,legs,leg_count);
+}
+
+/*work_hard by suffix minima over the two legs : nothing is merged*/
+static travel_t work_hard_join(Parameters& parameters) {
+    vector<override_stl_allocator(travel_t)> there,back;
+    vector<override_stl_allocator(travel_t)>* legs[] = { &there , &back };
+    travel_t result;
+    f32 cost;
+
+    build_leg(there,parameters.from,parameters.to,parameters.dep_time_min,parameters.dep_time_max,parameters);
+    build_leg(back,parameters.to,parameters.from,parameters.ar_time_min,parameters.ar_time_max,parameters);
+    join_cheapest(result,cost,legs,2);
+    return result;
+}
+
+/*play_hard for one airport by suffix minima over the three legs of each order*/
+static travel_t play_hard_join(Parameters& parameters,const indexed_string_t vacation) {
+    vector<override_stl_allocator(travel_t)> legs[3];
+    vector<override_stl_allocator(travel_t)>* order[] = { &legs[0] , &legs[1] , &legs[2] };
+    travel_t result1,result2;
+    f32 cost1,cost2;
+    boolean_t found1,found2;
+
+    //home -> vacation -> conference -> home
+    build_leg(legs[0],parameters.from,vacation,parameters.dep_time_min-parameters.vacation_time_max,parameters.dep_time_min-parameters.vacation_time_min,parameters);
+    build_leg(legs[1],vacation,parameters.to,parameters.dep_time_min,parameters.dep_time_max,parameters);
+    build_leg(legs[2],parameters.to,parameters.from,parameters.ar_time_min,parameters.ar_time_max,parameters);
+    found1 = join_cheapest(result1,cost1,order,3);
+
+    //home -> conference -> vacation -> home
+    for (uint32_t k = 0;k < 3;++k) {
+        legs[k].clear();
+    }
+    build_leg(legs[0],parameters.from,parameters.to,parameters.dep_time_min,parameters.dep_time_max,parameters);
+    build_leg(legs[1],parameters.to,vacation,parameters.ar_time_min,parameters.ar_time_max,parameters);
+    build_leg(legs[2],vacation,parameters.from,parameters.ar_time_max+parameters.vacation_time_min,parameters.ar_time_max+parameters.vacation_time_max,parameters);
+    found2 = join_cheapest(result2,cost2,order,3);
+
+    //Ties go to the second order like in find_cheapest over both lists
+    if (found2 && (!found1 || (cost2 <= cost1))) {
+        return result2;
+    }
+
+    return result1;
 }
 
 travel_t work_hard(Parameters& parameters, vector<vector<indexed_string_t> >& alliances) {
     vector<override_stl_allocator(travel_t)> travels;
 
+    if (parameters.b_suffix_minima) {
+        return work_hard_join(parameters);
+    } else if (parameters.b_path_dag) {
+        return work_hard_dag(parameters);
+    } else if (parameters.b_stream_paths) {
+        return work_hard_streamed(parameters);
+    }
+
     //First, we need to create as much travels as it as the number of flights that take off from the
     //first city
     fill_travel(travels,parameters.from, parameters.dep_time_min, parameters.dep_time_max);
@@ -76,9 +251,16 @@ travel_t work_hard(Parameters& parameters, vector<vector<indexed_string_t> >& al
     //Then we need to travel back
     fill_travel(travels_back,parameters.to, parameters.ar_time_min, parameters.ar_time_max);
     compute_path(parameters.from, travels_back, parameters.ar_time_min, parameters.ar_time_max, parameters);
-    merge_path(travels, travels_back);
 
-    return find_cheapest(travels, alliances);
+    //One travel per outbound path , find_cheapest walks the ways back it can take (from disk past -max_memory)
+    travel_t result;
+    f32 cost;
+    mt_init_merge_phase_relations();
+    merge_path(travels, travels_back, k_range, true);
+
+    find_cheapest(result, cost, travels, alliances);
+    mt_shutdown_merge_phase_relations();
+    return result;
 }
  
 vector<override_stl_allocator(travel_t)> play_hard(Parameters& parameters, vector<vector<indexed_string_t> >& alliances) {
@@ -86,11 +268,24 @@ vector<override_stl_allocator(travel_t)> play_hard(Parameters& parameters, vecto
     list<indexed_string_t>::iterator it = parameters.airports_of_interest.begin();
 
     for (; it != parameters.airports_of_interest.end(); it++) {
+        if (parameters.b_suffix_minima) {
+            results.push_back(play_hard_join(parameters,*it));
+            continue;
+        } else if (parameters.b_path_dag) {
+            results.push_back(play_hard_dag(parameters,*it));
+            continue;
+        } else if (parameters.b_stream_paths) {
+            results.push_back(play_hard_streamed(parameters,*it));
+            continue;
+        }
+
     mt_init_merge_phase_relations();
         
 
         const indexed_string_t current_airport_of_interest = *it;
-        vector<override_stl_allocator(travel_t)>* all_travels;
+        travel_t result1,result2;
+        f32 cost1,cost2;
+        boolean_t found1,found2;
         /*
          * The first part compute a travel from home -> vacation -> conference -> home
          */
@@ -108,16 +303,15 @@ vector<override_stl_allocator(travel_t)> play_hard(Parameters& parameters, vecto
         fill_travel(*conference_to_home, parameters.to, parameters.ar_time_min, parameters.ar_time_max);
         compute_path( parameters.from,*conference_to_home, parameters.ar_time_min, parameters.ar_time_max, parameters);
      
-        merge_path(*home_to_vacation,*vacation_to_conference);
-        delete vacation_to_conference;  
- 
- 
-        mt_merge_phase_link_node(*home_to_vacation,*conference_to_home,k_node_zero);
-
-        merge_path(*home_to_vacation,*conference_to_home,k_mate,k_node_zero);
+        //Composed from the last leg backwards : each travel keeps its own flights + a range of the next leg
+        merge_path(*vacation_to_conference,*conference_to_home,k_range);
         delete  conference_to_home; 
 
-        all_travels = home_to_vacation;
+        merge_path(*home_to_vacation,*vacation_to_conference,k_range,true);
+        delete vacation_to_conference;  
+
+        found1 = find_cheapest(result1,cost1,*home_to_vacation,alliances);
+        delete home_to_vacation;
  
         /*
          * The second part compute a travel from home -> conference -> vacation -> home
@@ -137,23 +331,17 @@ vector<override_stl_allocator(travel_t)> play_hard(Parameters& parameters, vecto
         compute_path( parameters.from,*vacation_to_home, parameters.ar_time_max+parameters.vacation_time_min, parameters.ar_time_max+parameters.vacation_time_max, parameters);
 
 
-        merge_path(*home_to_conference,*conference_to_vacation);
-        delete conference_to_vacation; 
-
-        mt_merge_phase_link_node(*home_to_conference,*vacation_to_home,k_node_one);
-
-        merge_path(*home_to_conference,*vacation_to_home,k_mate,k_node_one);
+        merge_path(*conference_to_vacation,*vacation_to_home,k_range);
         delete vacation_to_home;
 
-        const uint32_t hsize = home_to_conference->size();
-        for (register uint32_t i = 0, j = hsize;i < j;++i) {
-            all_travels->push_back(home_to_conference->at(i));
-        }
+        merge_path(*home_to_conference,*conference_to_vacation,k_range,true);
+        delete conference_to_vacation; 
 
+        found2 = find_cheapest(result2,cost2,*home_to_conference,alliances);
         delete home_to_conference;
 
-        results.push_back(find_cheapest(*all_travels,alliances));
-        delete all_travels;
+        //Ties go to the second order like in find_cheapest over both lists
+        results.push_back((found2 && (!found1 || (cost2 <= cost1))) ? result2 : result1);
 
         mt_shutdown_merge_phase_relations();
 
@@ -190,7 +378,8 @@ static inline flight_class_t classify_flight(const Parameters& params,const uint
 }
 
 
-void parse_flights(Parameters& params,vector<flight_ref_t>& flights_ref) {
+/*flights_ref : flights of the time windows , schedule : every flight of the file (-transfer_patterns only , else left empty)*/
+void parse_flights(Parameters& params,vector<flight_ref_t>& flights_ref,vector<flight_ref_t>& schedule) {
 //  profiler_profile_me();
     ifstream file;
     file.open(params.flights_file.c_str());
@@ -213,15 +402,17 @@ void parse_flights(Parameters& params,vector<flight_ref_t>& flights_ref) {
     file.read(code,len);
  
 
-    //Count lines
-    head = 0;
+    //Count lines (the delimiter scan picks its instruction set at startup , ff_init)
     lines = 0;
-    while (head < len) {
-        const char c = code[head++];
-        if ((c == '\r') || (c == '\n') || (head == len)) {
-            ++lines;
+    for (head = 0;head < len;head += k_filter_block) {
+        const uint32_t count = ((len - head) < k_filter_block) ? (len - head) : k_filter_block;
+        for (uint64_t mask = ff_delimiters(code + head,count);mask != 0;mask &= mask - 1) {
+            lines += (code[head + __builtin_ctzll(mask)] != ';') ? 1 : 0;
         }
     }
+    if ((len > 0) && (code[len - 1] != '\r') && (code[len - 1] != '\n')) {
+        ++lines;
+    }
 
     //alloc+parse
     flights_ref.reserve(lines+2);
@@ -230,14 +421,26 @@ void parse_flights(Parameters& params,vector<flight_ref_t>& flights_ref) {
     head = 0;
     start = 0;
 
+    //Delimiters come from the scan 64 bytes at a time , a line end restarts it past the blanks that follow
     while (head < len) {
-        const char c = code[head++];
-        if (c == ';') {
-            code[head - 1] = '\0'; // PATCH
-            ++q_len;
-            continue;
-        } else if ((c == '\r') || (c == '\n') || (head == len)) {
-            code[head - 1] = '\0'; // PATCH
+        const uint32_t base = head;
+        const uint32_t count = ((len - base) < k_filter_block) ? (len - base) : k_filter_block;
+        uint64_t mask = ff_delimiters(code + base,count);
+
+        if (base + count == len) { //The last byte ends the last line
+            mask |= 1ULL << (count - 1);
+        }
+
+        head = base + count;
+        for (;mask != 0;mask &= mask - 1) {
+            const uint32_t at = base + __builtin_ctzll(mask);
+            if (code[at] == ';') {
+                code[at] = '\0'; // PATCH
+                ++q_len;
+                continue;
+            }
+
+            code[at] = '\0'; // PATCH
 
             if (++q_len == 7) {         
                 const char* p = (const char*)(code + start);
@@ -248,6 +451,16 @@ void parse_flights(Parameters& params,vector<flight_ref_t>& flights_ref) {
                 to_p = p; p += strlen(p) + 1;
                 ref.land_time = convert_string_to_timestamp(p);   p += strlen(p) + 1;
 
+                if (!params.transfer_patterns_file.empty()) { //Tries are built on the whole schedule , any window can use them
+                    flight_ref_t whole;
+                    whole.take_off_time = ref.take_off_time;
+                    whole.land_time = ref.land_time;
+                    whole.from_hash = ss_register(std::string(from_p));
+                    whole.to_hash = ss_register(std::string(to_p));
+                    whole.index = (uint32_t)schedule.size();
+                    schedule.push_back(whole);
+                }
+
                 const flight_class_t fclass = classify_flight(params,ref.take_off_time,ref.land_time);
                 if (fclass != flight_class_invalid) {
                     ref.cost = atof(p); p += strlen(p) + 1;
@@ -263,12 +476,13 @@ void parse_flights(Parameters& params,vector<flight_ref_t>& flights_ref) {
                 ++actual_index;
             }
 
+            head = at + 1;
             while ((head < len) && isspace(code[head])) {
                 ++head;
             }
             start = head;
             q_len = 0;
-            continue;
+            break;
         }
     }
 
@@ -346,6 +560,7 @@ int main(int argc, char **argv) {
     env_init();
     {
         vector<flight_ref_t> flights_ref; 
+        vector<flight_ref_t> schedule;
 
         profiler_profile_me_ex("init_contexts");
         if (!ss_init()) {
@@ -359,13 +574,13 @@ int main(int argc, char **argv) {
         mt_init(parameters);
 
         //Parse flights
-        parse_flights(parameters,flights_ref);
+        parse_flights(parameters,flights_ref,schedule);
 
         //Parse alliances
         parse_alliances(alliances, parameters.alliances_file);
 
         //Initialize multi-thread ops
-        mt_set_work_data(flights_ref,alliances);
+        mt_set_work_data(flights_ref,alliances,schedule);
     }
 
     printf("Intializing contexts...OK\n");
@@ -511,6 +726,7 @@ time_t convert_to_timestamp(int32_t day,int32_t month,int32_t year,int32_t hour,
     time.tm_hour = hour;
     time.tm_min = minute;
     time.tm_sec = seconde;
+    time.tm_isdst = 0;
     return timegm(&time);
 }
 
@@ -572,6 +788,20 @@ void print_flight(flight_indice_t ref_ind,ofstream& output) {
 
 void read_parameters(Parameters& parameters, int32_t argc, char **argv){
     parameters.b_silent = 0;
+    parameters.b_mt_stats = 0;
+    parameters.b_verify_kernels = 0;
+    parameters.force_isa = 0; //ff_isa_auto
+    parameters.prefetch_distance = 8; //Fixed , -prefetch_distance auto calibrates it at startup
+    parameters.bidir_thresold = 256*1024; //Go bidirectional past 256K partial travels
+    parameters.b_stream_paths = 0;
+    parameters.b_path_dag = 0;
+    parameters.b_suffix_minima = 0;
+    parameters.b_branch_bound = 0;
+    parameters.b_dp_engine = 0;
+    parameters.b_best_first = 0;
+    parameters.max_memory = 0;
+    parameters.spill_dir = "/tmp";
+    parameters.expand_mode = (int32_t)expand_mode_auto;
     parameters.perm_size = 32;
     parameters.merge_buffer_thresold = 128*1024; //Merge up to 128K travels/Pass
 
@@ -613,6 +843,61 @@ void read_parameters(Parameters& parameters, int32_t argc, char **argv){
             parameters.nb_threads = atoi(argv[++i]);
         }else if(current_parameter == "-b_silent"){
             parameters.b_silent = 1;
+        }else if(current_parameter == "-expand_mode"){
+            const string mode = argv[++i];
+            if (mode == "steal") {
+                parameters.expand_mode = (int32_t)expand_mode_steal;
+            } else if (mode == "owner") {
+                parameters.expand_mode = (int32_t)expand_mode_owner;
+            } else {
+                parameters.expand_mode = (int32_t)expand_mode_auto;
+            }
+        }else if(current_parameter == "-bidir_thresold"){
+            parameters.bidir_thresold = (uint32_t)atol(argv[++i]);
+        }else if(current_parameter == "-path_dag"){
+            parameters.b_path_dag = 1;
+        }else if(current_parameter == "-dp"){ //DP runs over the leg DAGs
+            parameters.b_path_dag = 1;
+            parameters.b_dp_engine = 1;
+        }else if(current_parameter == "-best_first"){ //Best first runs over the leg DAGs
+            parameters.b_path_dag = 1;
+            parameters.b_best_first = 1;
+        }else if(current_parameter == "-bnb"){ //Branch and bound runs over the leg DAGs
+            parameters.b_path_dag = 1;
+            parameters.b_branch_bound = 1;
+        }else if(current_parameter == "-max_memory"){ //In MB
+            parameters.max_memory = (uint64_t)atol(argv[++i]) << 20;
+        }else if(current_parameter == "-spill_dir"){
+            parameters.spill_dir = argv[++i];
+        }else if(current_parameter == "-transfer_patterns"){
+            parameters.transfer_patterns_file = argv[++i];
+        }else if(current_parameter == "-suffix_minima"){
+            parameters.b_suffix_minima = 1;
+        }else if(current_parameter == "-stream_paths"){
+            parameters.b_stream_paths = 1;
+        }else if(current_parameter == "-force_isa"){
+            const string isa = argv[++i];
+            if (isa == "scalar") {
+                parameters.force_isa = (int32_t)ff_isa_scalar;
+            } else if (isa == "sse2") {
+                parameters.force_isa = (int32_t)ff_isa_sse2;
+            } else if (isa == "avx2") {
+                parameters.force_isa = (int32_t)ff_isa_avx2;
+            } else if (isa == "avx512") {
+                parameters.force_isa = (int32_t)ff_isa_avx512;
+            } else if (isa == "auto") {
+                parameters.force_isa = (int32_t)ff_isa_auto;
+            } else {
+                cerr<<"Unknown -force_isa "<<isa<<" (scalar , sse2 , avx2 , avx512 or auto)"<<endl;
+                exit(0);
+            }
+        }else if(current_parameter == "-prefetch_distance"){
+            const string distance = argv[++i];
+            parameters.prefetch_distance = (distance == "auto") ? -1 : (int32_t)atol(distance.c_str());
+        }else if(current_parameter == "-verify_kernels"){
+            parameters.b_verify_kernels = 1;
+        }else if(current_parameter == "-mt_stats"){
+            parameters.b_mt_stats = 1;
         }else if(current_parameter == "-perm_size"){
             parameters.perm_size = (int32_t)atol(argv[++i]);
         }else if(current_parameter == "-merge_buf_thresold"){
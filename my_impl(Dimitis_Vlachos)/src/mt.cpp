@@ -5,52 +5,270 @@
 #include "mt.hpp"
 #include "io.hpp"
 #include "permutations.hpp"
+#include "flight_index.hpp"
+#include "work_stealing.hpp"
+#include "spsc_queue.hpp"
+#include "flight_filter.hpp"
+#include "bidir.hpp"
+#include "path_generator.hpp"
+#include "path_dag.hpp"
+#include "multi_queue.hpp"
+#include "transfer_patterns.hpp"
+#include "leg_join.hpp"
 
 extern "C" {
     #include <pthread.h>
     #include <unistd.h>
 }
 
+static const uint32_t k_expand_chunk = 64;                                   /*Travels per work stealing chunk in compute_path*/
+static const uint32_t k_route_queue_len = 128;                               /*Slots per SPSC queue in owner computes mode*/
+static const uint32_t k_stream_batch = 256;                                  /*Paths pulled from the generator at once*/
+static const uint32_t k_bnb_depths = 16;                                     /*Branch and bound stats : depths counted apart (the last one is "and more")*/
+static const uint32_t k_bnb_greedy_budget = 4096;                            /*Branch and bound : expansions of the greedy seed search*/
+static const f32 k_bnb_slack = 1e-5f;                                        /*Branch and bound : relative slack for float rounding*/
+static const f32 k_cost_slack = 1e-5f;                                       /*find_cheapest : running prices this close to the minimum are costed again*/
+static const f32 k_rest_unknown = -1.0f;                                     /*merge_phase_node_t::rest not computed yet*/
+static const uint32_t k_max_alliance_masks = 64;                             /*flight_ref_t::alliance_mask bits*/
+static const uint32_t k_dp_tiers = 3;                                        /*DP : discounts a flight can get from the one before it*/
+static const f32 k_dp_tier[k_dp_tiers] = { 1.0f , 0.8f , 0.7f };
+static const uint32_t k_dp_no_state = (uint32_t)std::numeric_limits<uint32_t>::max();
+static const uint32_t k_best_first_heaps = 4;                                /*Best first : heaps per thread in the multi queue*/
+static const uint32_t k_spill_share = 4;                                     /*-max_memory : frontier and final travels get budget / 4 each*/
+static const uint32_t k_spill_bulk = 4096;                                   /*-max_memory : travels per spill file read*/
+static const uint32_t k_max_join_legs = 8;                                  /*-suffix_minima : legs per chain*/
+static const uint32_t k_depth_kernels = 8;                                   /*Hop counts with their own (unrolled) path kernels*/
+static const uint64_t k_nothing_visited[k_visited_words] = {0};              /*Empty visited set for flight_filter*/
+static const uint32_t k_prefetch_candidates[] = { 0 , 1 , 2 , 4 , 8 , 16 , 32 }; /*-prefetch_distance auto : distances tried*/
+static const uint32_t k_prefetch_calibration = 1 << 15;                      /*-prefetch_distance auto : synthetic travels*/
+static_assert(k_departure_zone <= k_filter_block,"a zone must fit in one flight_filter mask");
+
 struct alliance_t {                                                         /*A copy of the alliance list for each thread*/
     std::vector<std::vector<indexed_string_t>> alliances;
 };
  
+struct spill_state_t {                                                        /*compute_path spill files (-max_memory)*/
+    uint64_t share;                                                           /*Bytes the frontier / final travels may hold*/
+    std::vector<std::string> frontier;                                        /*Spilled frontier partitions , last one first*/
+    std::vector<std::string> finals;                                          /*Spilled final travels*/
+    uint32_t partitions;                                                      /*Partitions written*/
+    uint64_t written,read,io_ns;                                              /*Spill volume (bytes) , time spent writing/reading*/
+};
+
 struct compute_path2_args_t {                                               
-    std::vector<override_stl_allocator(travel_t)>* input;                    /*Input vector to be proccessed*/
+    std::vector<override_stl_allocator(travel_t)>* input;                    /*Input vector to be proccessed (shared,read only)*/
+    std::vector<uint32_t>* order;                                            /*Input positions sorted by (airport,land time)*/
     std::vector<override_stl_allocator(travel_t)>* output;                   /*Remainder to be summed up*/
     std::vector<override_stl_allocator(travel_t)>* final_travels;            /*Final travel list to be returned*/
     indexed_string_t to;                                                     /*Hash of destination*/
-    uint32_t start,end;                                                     /*Start/end offsets in flight list*/
     uint32_t flight_count,thread_index;                                     /*Number of flights , thread index*/
-    int64_t start2,end2;                                                    /*Start/end offsets in input list (bottom->top)*/
+    uint32_t thread_count;                                                  /*Threads of this level (steal victims)*/
     uint64_t t_min,t_max,max_layover_time;                                  /*Time upper/lower bound*/         
+    const uint64_t* feasible;                                               /*Feasibility profile of this leg (fi_feasible)*/
+    const suffix_table_t* suffixes;                                         /*Backward half , 0 while the search is forward only*/
+    uint64_t busy_ns;                                                       /*Time spent expanding chunks in this level*/
+    uint64_t chunks,steals;                                                 /*Chunks expanded , chunks stolen from other threads*/
+    spill_state_t spill;                                                    /*This thread's spill files (-max_memory , share 0 : off)*/
+    uint64_t final_bytes;                                                   /*Bytes of final_travels still in memory*/
+};
+
+struct expand_ctx_t {                                                       /*State shared by all expansions of a thread*/
+    flight_ref_t* flights;                                                  /*This thread's copy of the flight list*/
+    const flight_indice_t* departures;                                      /*Departure index*/
+    const uint64_t* departures_take_off;                                    /*Take off time of each departure*/
+    const uint64_t* departures_land;                                        /*Land time of each departure*/
+    const uint32_t* departures_to;                                          /*Arrival airport of each departure*/
+    const uint64_t* feasible;                                               /*Departures that can still reach the destination*/
+    const suffix_table_t* suffixes;                                         /*Backward half (bidir) or 0*/
+    uint64_t t_min,t_max,max_layover_time;                                  /*Time upper/lower bound*/
+    indexed_string_t to;                                                    /*Hash of destination*/
+    boolean_t visited_exact;                                                /*travel_t::visited is exact*/
+    std::vector<override_stl_allocator(travel_t)>* output;                   /*Next level*/
+    std::vector<override_stl_allocator(travel_t)>* final_travels;            /*Travels that reached the destination*/
+    travel_t* next;                                                         /*Scratch travel*/
+    travel_t* joined;                                                       /*Scratch travel of the bidirectional join*/
+    std::vector<std::vector<indexed_string_t>>* alliances;                 /*This thread's copy of the alliances*/
+};
+
+struct frontier_key_t {                                                     /*Sort key of a frontier travel inside its airport bucket*/
+    uint64_t land_time;
+    uint32_t pos;
+
+    inline bool operator< (const frontier_key_t& other) const {
+        return (land_time != other.land_time) ? (land_time < other.land_time) : (pos < other.pos);
+    }
+};
+
+struct routed_travel_t {                                                    /*A travel on its way to the owner of its current airport*/
+    travel_t travel;
+    uint64_t land_time;                                                     /*Land time of the last flight*/
+    uint32_t airport;                                                       /*Dense id of the current airport*/
+
+    routed_travel_t() : land_time(0) , airport(0) {}
+
+    inline void swap(routed_travel_t& other) {
+        travel.swap(other.travel);
+        std::swap(land_time,other.land_time);
+        std::swap(airport,other.airport);
+    }
+};
+
+struct shard_flight_t {                                                     /*Departure record inside an owner's shard*/
+    uint64_t take_off_time;
+    uint64_t land_time;
+    uint32_t index;                                                         /*Flight index*/
+    uint32_t to_id;                                                         /*Dense id of the arrival airport*/
+    uint32_t pos;                                                           /*Position in the departure index*/
+
+    inline bool operator< (const uint64_t t) const {                        /*For lower_bound on take off time*/
+        return take_off_time < t;
+    }
+};
+
+struct airport_shard_t {                                                    /*Departure lists owned by one thread*/
+    std::vector<uint32_t> offset;                                           /*Departures of slot s live in [offset[s],offset[s+1])*/
+    std::vector<shard_flight_t> departures;
+};
+
+struct owner_path_args_t {
+    uint32_t thread_index,thread_count;                                     /*Thread index , number of threads*/
+    uint32_t to_airport;                                                    /*Dense id of destination*/
+    uint64_t t_min,t_max,max_layover_time;                                  /*Time upper/lower bound*/
+    const uint64_t* feasible;                                               /*Feasibility profile of this leg (fi_feasible)*/
+    uint64_t busy_ns;                                                       /*Time spent expanding*/
+    std::vector<override_stl_allocator(routed_travel_t)>* frontier;          /*Travels at airports owned by this thread*/
+    std::vector<override_stl_allocator(travel_t)>* final_travels;            /*Travels that reached the destination*/
+};
+
+struct thread_stats_t {                                                     /*Per thread accounting of compute_path (-mt_stats)*/
+    uint64_t busy_ns,idle_ns;                                               /*Expanding / waiting or looking for work*/
+    uint64_t chunks,steals;                                                 /*Chunks expanded , chunks stolen*/
+    thread_stats_t() : busy_ns(0) , idle_ns(0) , chunks(0) , steals(0) {}
 };
 
-struct fill_travel_args_t {                 
-    uint32_t start;                                                         /*First element in flight list*/
-    uint32_t end;                                                           /*Last element in flight list*/
-    uint32_t thread_index;                                                  /*Thread index*/
-    uint32_t flight_count;                                                  /*Number of flights*/
-    uint64_t t_min,t_max;                                                   /*time Upper/Lower bound*/
-    std::vector<override_stl_allocator(travel_t)>* results;                  /*Partial result*/
-    indexed_string_t starting_point;                                         /*Source point hash*/
+struct merge_range_t {                                                      /*t1 + any of the sorted travel2 [first,first + count)*/
+    uint32_t t1,first,count;
+};
+
+struct merge_leg_t {                                                        /*travel2 of a merge_path , sorted by first take off*/
+    std::vector<uint32_t> order;                                             /*Positions in travel2 (non empty travels) , stable*/
+    std::vector<uint64_t> take_off;                                          /*First take off time of order[i]*/
 };
 
 struct merge_path_args_t {              
     std::vector<override_stl_allocator(travel_t)>* travel1;                   /*Source travel 1*/
     std::vector<override_stl_allocator(travel_t)>* travel2;                   /*Source travel 2*/
-    std::vector<override_stl_allocator(travel_indice_pair_t)>* results;     /*Partial results*/
-    uint32_t start,end,start2,end2;                                          /*Start/End offsets in travel1/travel2 lists*/
+    const merge_leg_t* leg;                                                  /*travel2 sorted*/
+    std::vector<merge_range_t>* ranges;                                      /*One per t1 with a match*/
+    std::vector<override_stl_allocator(travel_indice_pair_t)>* results;     /*Ranges expanded (relation != k_range)*/
+    std::vector<travel_cost_t>* costs;                                       /*Running price of each result*/
+    uint32_t start,end;                                                      /*Start/End offsets in travel1*/
+    travel_indice_t relation;                                                /*merge_path relation*/
     uint32_t thread_index;                                                   /*Thread index*/
     uint32_t flight_count;                                                   /*Number of flights*/
 };
  
+struct join_value_args_t {
+    uint32_t start,end;                                                      /*Summaries of this thread*/
+    const std::vector<leg_summary_t>* summaries;                             /*Leg being valued (sorted)*/
+    const join_table_t* next;                                                /*Suffix minima of the next leg (0 : last leg)*/
+    const join_partners_t* partners;                                         /*Alliances of the companies*/
+    std::vector<f32>* value;                                                 /*k_join_classes values per summary*/
+};
+
+struct join_search_t {                                                      /*-suffix_minima : exact pass over the chains within slack*/
+    std::vector<override_stl_allocator(travel_t)>* const* legs;              /*Travel list of each leg*/
+    const std::vector<leg_summary_t>* summaries;                             /*Per leg , sorted*/
+    const std::vector<f32>* value;                                           /*Per leg , k_join_classes values per summary*/
+    const join_partners_t* partners;
+    uint32_t leg_count;
+    f32 limit;                                                               /*Cheapest value + slack*/
+    uint32_t chain[k_max_join_legs];                                         /*Summary position of each leg*/
+    travel_t path;
+    boolean_t found;
+    f32 best_cost;
+    uint32_t best_key[k_max_join_legs];                                      /*Travel list positions of the best chain*/
+    travel_t best;
+};
+
 struct find_cheapest_args_t {
     int64_t start,end;                                                       /*Start,end offsets in travel list*/
     uint32_t best_ind,thread_index,flight_count;                             /*Best indice,thread index,number of flights*/
     f32 best_cost;                                                            /*Best cost for this thread*/
     std::vector<override_stl_allocator(travel_t)>* travels;                   /*Input travels*/
     travel_t* out_travel;
+    boolean_t rebuild;                                                        /*Read back from disk : running prices are rebuilt first*/
+};
+
+struct stream_cheapest_args_t {
+    uint32_t thread_index,flight_count;                                     /*Thread index , number of flights*/
+    uint32_t to_airport;                                                    /*Dense id of destination of the streamed leg*/
+    uint64_t t_min,t_max,max_layover_time;                                  /*Time upper/lower bound of the streamed leg*/
+    const uint64_t* feasible;                                               /*Feasibility profile of the streamed leg*/
+    const std::vector<override_stl_allocator(travel_t)>* roots;              /*Starting travels (fill_travel output)*/
+    std::atomic<uint32_t>* next_root;                                       /*Next starting travel to take (shared)*/
+    const std::vector<override_stl_allocator(travel_t)>* const* tails;       /*Legs merged after the streamed one*/
+    uint32_t tail_count;
+    uint32_t size;                                                          /*Flights of the streamed leg in the path being joined*/
+    uint32_t key[k_max_join_legs];                                          /*Tail list positions of the path being joined*/
+    boolean_t found;                                                        /*best is valid*/
+    f32 best_cost;
+    travel_t* best;
+    uint32_t best_size;
+    uint32_t best_key[k_max_join_legs];
+};
+
+struct best_first_item_t {                                                  /*A partial travel of the best first search*/
+    travel_t path;                                                          /*Flights so far , visited airports of the current leg*/
+    f32 fixed,tier;                                                         /*Price without the last flight , its discount from the one before*/
+    uint32_t leg,pos,leg_start;                                             /*Leg/position of the last flight , first flight of its leg in path*/
+
+    best_first_item_t() : fixed(0) , tier(1) , leg(0) , pos(0) , leg_start(0) {}
+
+    inline void swap(best_first_item_t& other) {
+        path.swap(other.path);
+        std::swap(fixed,other.fixed);
+        std::swap(tier,other.tier);
+        std::swap(leg,other.leg);
+        std::swap(pos,other.pos);
+        std::swap(leg_start,other.leg_start);
+    }
+};
+
+struct dag_rest_t {                                                         /*One way to go on from a root of a leg*/
+    f32 cost;                                                               /*Price of this leg's flights and the cheapest rest after them*/
+    uint32_t next;                                                          /*Root index taken in the next leg (k_dp_no_state : last leg)*/
+    uint32_t next_tier;                                                     /*k_dp_tier index that root gets*/
+    std::vector<flight_indice_t> flights;                                   /*Flights of this leg*/
+
+    inline void swap(dag_rest_t& other) {
+        flights.swap(other.flights);
+        std::swap(cost,other.cost);
+        std::swap(next,other.next);
+        std::swap(next_tier,other.next_tier);
+    }
+};
+
+struct dag_suffix_t {                                                       /*Cheapest rest of the travel from a root of a leg*/
+    f32 cost[k_dp_tiers];                                                   /*Per discount the root gets from the flight before it (+infinity : none)*/
+    std::vector<dag_rest_t> rests[k_dp_tiers];                              /*Rests within k_cost_slack of cost[k] : ties are decided on whole travels*/
+};
+
+struct dag_cheapest_args_t {
+    uint32_t thread_index,flight_count;                                     /*Thread index , number of flights*/
+    path_dag_t* const* dags;                                                /*One DAG per leg , in travel order*/
+    uint32_t leg_count;
+    std::vector<dag_suffix_t>* suffixes;                                    /*Per leg (1..) and root : cheapest rest (mt_dag_suffixes) , 0 : one leg*/
+    uint32_t leg;                                                           /*mt_dag_suffixes : leg being built*/
+    std::atomic<uint32_t>* next_root;                                       /*Next root of the first leg to take (shared)*/
+    boolean_t found;                                                        /*best is valid*/
+    f32 best_cost;
+    travel_t* best;
+    std::atomic<uint32_t>* bound;                                           /*Best cost found by any thread (f32 bits , shared) , 0 : no pruning*/
+    uint64_t expanded[k_bnb_depths],pruned[k_bnb_depths];                   /*Branch and bound counters per depth*/
+    multi_queue_c<best_first_item_t>* queue;                                /*Best first : open partial travels (shared)*/
+    std::atomic<uint32_t>* active;                                          /*Best first : threads expanding a popped travel (shared)*/
+    uint64_t popped,stale;                                                  /*Best first : travels popped , popped but beaten meanwhile*/
 };
 
 struct ss_match_args_t {                                                     /*for static_strings.cpp*/
@@ -67,9 +285,49 @@ struct copy_travel_args_t {                                                   /*
     uint32_t base;                                                            /*Base in dst*/
 };
 
-struct merge_phase_node_t {                                                     /*Used to store merge states...*/
-    std::vector<override_stl_allocator(travel_t)> a;
-    std::vector<override_stl_allocator(travel_t)> b;
+struct connect_args_t {                                                       /*for mt_connect_entry_point*/
+    std::atomic<uint32_t>* next;                                              /*Next arrival airport (shared)*/
+    uint64_t connections;                                                     /*Edges of the airports this thread swept*/
+};
+
+struct pattern_build_args_t {                                                 /*for mt_pattern_build_entry_point*/
+    std::atomic<uint32_t>* next;                                              /*Next origin to build (shared)*/
+    FILE* file;                                                               /*Index file , records appended under lock*/
+    pthread_mutex_t* lock;
+    uint64_t max_layover_time;
+    uint32_t built,skipped;                                                   /*Origins this thread built , too large ones*/
+    boolean_t io_failed;                                                      /*A record couldn't be written*/
+};
+
+struct pattern_path_args_t {                                                  /*for mt_pattern_path_entry_point*/
+    std::vector<override_stl_allocator(travel_t)>* input;                      /*fill_travel output (shared,read only)*/
+    std::vector<override_stl_allocator(travel_t)>* output;                     /*Travels that reached the destination*/
+    const pattern_trie_t* trie;                                               /*Patterns of the origin*/
+    uint32_t start,end;                                                       /*Input range*/
+    uint32_t thread_index;
+    uint32_t to_airport;                                                      /*Dense id of destination*/
+    uint32_t to_pattern;                                                      /*Dense id of destination in the tries (whole schedule)*/
+    uint64_t t_min,t_max,max_layover_time;                                    /*Time upper/lower bound*/
+    const uint64_t* feasible;                                                 /*Feasibility profile of this leg (fi_feasible)*/
+};
+
+struct merge_phase_node_t {                                                     /*Composition node : travel2 of a k_range merge_path*/
+    std::vector<override_stl_allocator(travel_t)> b;                             /*Sorted by first take off , entries may be ranged into a later node*/
+    std::vector<uint32_t> b_order;                                              /*Position of each b in travel2*/
+    std::vector<f32> rest;                                                      /*Per b entry and incoming k_dp_tier : cheapest continuation (mt_compose_rest)*/
+};
+
+struct compose_walk_t {                                                         /*find_cheapest pass 2 over one composed travel*/
+    std::vector<override_stl_allocator(merge_phase_node_t)>* nodes;
+    flight_ref_t* flights;
+    std::vector<std::vector<indexed_string_t> >* alliances;
+    f32 limit;                                                                  /*Running prices above it are skipped*/
+    travel_t path;                                                              /*Flights so far*/
+    std::vector<uint32_t> key;                                                  /*Entry , then the travel2 position of each leg*/
+    boolean_t found;
+    f32 best_cost;
+    std::vector<uint32_t> best_key;
+    travel_t best;
 };
 
 struct merge_phase_relation_t {
@@ -92,19 +350,127 @@ uint32_t g_flights_size;
 uint32_t g_mt_initialized = 0;                                                  /*Module initialization flag*/
     
 std::vector<alliance_t> g_alliances;                                             /*A copy of the alliance list*/
+boolean_t g_alliance_masks = false;                                               /*flight_ref_t::alliance_mask covers all alliances*/
 std::vector<override_stl_allocator(merge_phase_relation_t)>* g_merge_phase_relations;   /*All relations in this merge phase*/
 path_permutations_c* g_global_permutations;                                      /*Global permutations*/
+chase_lev_deque_c* g_expand_deques;                                             /*compute_path chunk deque of each thread*/
+std::vector<thread_stats_t> g_thread_stats;                                     /*compute_path busy/idle time of each thread*/
+uint32_t g_numa_nodes;                                                          /*NUMA nodes of this host*/
+std::vector<cpu_set_t> g_numa_cpus;                                             /*CPUs of each NUMA node (owner mode pins its threads)*/
+transfer_patterns_t g_transfer_patterns;                                        /*Per origin airport sequences (-transfer_patterns)*/
+std::atomic<uint32_t> g_spill_sequence(0);                                      /*Spill directory names (expand threads spill too)*/
+std::vector<std::string> g_merge_spill;                                         /*merge_path output on disk (-max_memory) , the next find_cheapest reads it*/
+uint32_t g_prefetch_distance;                                                   /*Batch loops prefetch the flights of item i + D (0 : off)*/
+
+/*Owner computes mode (compute_path)*/
+std::vector<uint32_t> g_airport_owner;                                          /*Dense airport id -> owner thread*/
+std::vector<uint32_t> g_airport_slot;                                           /*Dense airport id -> slot in its owner's shard*/
+std::vector<airport_shard_t> g_airport_shards;                                  /*Departure lists of each thread*/
+spsc_queue_c<routed_travel_t>* g_route_queues;                                  /*[producer * threads + consumer]*/
+std::vector<std::vector<override_stl_allocator(routed_travel_t)> > g_route_overflow; /*Travels that didn't fit in a full queue*/
+std::vector<uint64_t> g_owner_next_size;                                        /*Next level size of each thread*/
+std::atomic<uint64_t> g_owner_producers_done;                                   /*Threads done producing , summed over all levels*/
+pthread_barrier_t g_owner_barrier;                                              /*Level barrier*/
 
 /*Thread entry point functions fw-decl*/
-static void* mt_fill_travel_entry_point(void* in_args);                        /*MT version of fill_travels*/
 static void* mt_merge_path_entry_point(void* in_args);                         /*MT version of merge_path*/
 static void* mt_find_cheapest_entry_point(void* in_args);                      /*MT version of find_cheapest*/
 static void* mt_compute_path2_entry_point(void* in_args);                     /*MT version of compute_path */
 static void* mt_copy_travel_entry_point(void* in_args);                        
+static void* mt_connect_entry_point(void* in_args);                            /*Connection graph of the airports left*/
+static void* mt_join_value_entry_point(void* in_args);                         /*-suffix_minima : cheapest continuation of each travel*/
+static void* mt_pattern_build_entry_point(void* in_args);                      /*Builds the patterns of the origins left*/
+static void* mt_pattern_path_entry_point(void* in_args);                       /*compute_path along the patterns of the origin*/
+static void* mt_stream_cheapest_entry_point(void* in_args);                   /*Streamed compute_path + merge_path + find_cheapest*/
+static void* mt_dag_cheapest_entry_point(void* in_args);                      /*find_cheapest over leg DAGs*/
+static void mt_dag_greedy(dag_cheapest_args_t* args);                          /*Branch and bound seed*/
+static void mt_dag_suffixes(std::vector<dag_suffix_t>* suffixes,path_dag_t* const* dags,const uint32_t leg_count);
+static void mt_best_first_roots(dag_cheapest_args_t* args);                    /*Best first : queues the first leg's roots*/
+static void* mt_best_first_entry_point(void* in_args);                        /*Best first search over leg DAGs*/
+static inline f32 mt_pair_discount(const flight_ref_t& flight_before, const flight_ref_t& current_flight, 
+  std::vector<std::vector<indexed_string_t> >& alliances);
+static inline f32 compute_cost(flight_ref_t* flights,travel_t & travel,std::vector<std::vector<indexed_string_t> >&alliances);
+static boolean_t mt_verify_depth_kernels();                                    /*Depth kernels against the generic loops*/
+static void mt_calibrate_prefetch();                                           /*-prefetch_distance auto*/
+static inline uint64_t mt_travel_bytes(const travel_t& travel);
+static void mt_spill_tail(spill_state_t& spill,std::vector<std::string>& parts,std::vector<override_stl_allocator(travel_t)>& travels,
+                          const uint64_t share);
+static inline void mt_spill_rebuild(travel_t& travel,const flight_ref_t* flights,std::vector<std::vector<indexed_string_t> >& alliances);
  
 
 
-static void join_nodes(travel_t& out,const travel_t& in,const uint32_t thread_index);
+static void mt_sort_frontier(const std::vector<override_stl_allocator(travel_t)>& travels,std::vector<uint32_t>& order);
+static inline bool never_traveled_to(flight_ref_t* p_flights,const travel_t& travel,const uint32_t range,const indexed_string_t city);
+static inline bool has_just_traveled_with_company(const flight_ref_t& flight_before, const flight_ref_t& current_flight);
+static inline bool has_just_traveled_with_alliance(const flight_ref_t& flight_before, const flight_ref_t& current_flight, 
+  std::vector<std::vector<indexed_string_t> >& alliances);
+static inline void mt_cost_start(travel_cost_t& price,const flight_ref_t& flight);
+static inline void mt_cost_append(travel_cost_t& out,const travel_cost_t& in,const flight_ref_t& last,const flight_ref_t& flight,
+                                  const boolean_t first_hop,std::vector<std::vector<indexed_string_t> >& alliances);
+static inline void mt_cost_join(travel_cost_t& out,const travel_cost_t& a,const flight_ref_t& last,const uint32_t hops,
+                                const travel_t& t2,const flight_ref_t* flights,std::vector<std::vector<indexed_string_t> >& alliances);
+static inline void mt_cost_join(travel_cost_t& out,const travel_t& t1,const travel_t& t2,const flight_ref_t* flights,
+                                std::vector<std::vector<indexed_string_t> >& alliances);
+
+/*Monotonic timestamp in nanoseconds*/
+static inline uint64_t mt_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+    Software pipelined gathers for batch loops over travels (travels[order[i]] , order 0 : travels[i]).
+    While item i is processed , item i + 3D gets its travel_t pulled in , item i + 2D its flight list and
+    item i + D the record of its first or last flight , so the three dependent misses of the
+    flights[travel.flights[..]] chain overlap the work instead of stalling on it. D = 0 : nothing.
+*/
+static inline void mt_prefetch_gathers(const travel_t* travels,const uint32_t* order,const uint32_t i,const uint32_t end,
+                                       const uint32_t d,const flight_ref_t* flights,const boolean_t last) {
+    if ((i + (3 * d)) < end) {
+        __builtin_prefetch(&travels[(order != 0) ? order[i + (3 * d)] : i + (3 * d)]);
+    }
+
+    if ((i + (d << 1)) < end) {
+        const travel_t& t = travels[(order != 0) ? order[i + (d << 1)] : i + (d << 1)];
+        if (!t.flights.empty()) {
+            __builtin_prefetch(&t.flights[0]);
+        }
+    }
+
+    if ((i + d) < end) {
+        const travel_t& t = travels[(order != 0) ? order[i + d] : i + d];
+        if (!t.flights.empty()) {
+            __builtin_prefetch(&flights[(last) ? t.flights.back() : t.flights[0]]);
+        }
+    }
+}
+
+/*
+    Same pipeline for loops that cost whole paths (compute_cost , apply_discount and mt_spill_rebuild read every
+    flight of it , not one end) over travels[lo..hi] , walked upwards (step 1) or downwards (step -1) :
+    item i + 3D gets its travel_t , i + 2D its flight list and i + D all its flight records ,
+    the last stage only for travels the cost pass will reach (running price <= limit , or ranged).
+*/
+static inline void mt_prefetch_path_gathers(const travel_t* travels,const int64_t i,const int64_t lo,const int64_t hi,
+                                            const int64_t step,const uint32_t d,const flight_ref_t* flights,const f32 limit) {
+    const int64_t i3 = i + (step * 3 * (int64_t)d),i2 = i + (step * 2 * (int64_t)d),i1 = i + (step * (int64_t)d);
+
+    if ((i3 >= lo) && (i3 <= hi)) {
+        __builtin_prefetch(&travels[i3]);
+    }
+
+    if ((i2 >= lo) && (i2 <= hi) && !travels[i2].flights.empty()) {
+        __builtin_prefetch(&travels[i2].flights[0]);
+    }
+
+    if ((i1 >= lo) && (i1 <= hi) && (travels[i1].ranged() || (travels[i1].price.cost <= limit))) {
+        const travel_t& t = travels[i1];
+        for (uint32_t h = 0,n = (uint32_t)t.flights.size();h < n;++h) {
+            __builtin_prefetch(&flights[t.flights[h]]);
+        }
+    }
+}
 
 /*Wait for all threads to finish their task*/
 static void mt_wait_threads(const uint32_t active_threads) {
@@ -146,19 +512,7 @@ static void calculate_extent(std::vector<extent_t>& result,const uint32_t slice_
 }
 
 /*
-    Links two nodes and creates a copy of them for each thread...
-*/
-void mt_merge_phase_link_node(const std::vector<override_stl_allocator(travel_t)>& a,
-                                   const std::vector<override_stl_allocator(travel_t)>& b,
-                                   const travel_indice_t node) {
-    for (uint32_t i = 0;i < g_thread_contexts;++i) {
-        g_merge_phase_relations->at(i).nodes[node].a = a;
-        g_merge_phase_relations->at(i).nodes[node].b = b;
-    }
-}
-
-/*
-    Initializes merge phase relation list
+    Initializes merge phase relation list , composition nodes are added by each k_range merge_path
 */
 void mt_init_merge_phase_relations() {
     g_merge_phase_relations = new std::vector<override_stl_allocator(merge_phase_relation_t)>();
@@ -166,10 +520,6 @@ void mt_init_merge_phase_relations() {
 
     for (uint32_t i = 0;i < g_thread_contexts;++i) { //We need one for each thread!
         g_merge_phase_relations->push_back(merge_phase_relation_t());   
-
-        for (uint32_t j = 0;j < k_node_range;++j) {    //0...upper bound
-            g_merge_phase_relations->back().nodes.push_back(merge_phase_node_t());
-        }
     }
 }
 
@@ -184,8 +534,39 @@ void mt_get_flights(flight_ref_t*& ptr,uint32_t& size) {
     size = g_flights_size;
 }
 
-/*The MT version of merge_path*/
-void mt_merge_path(std::vector<override_stl_allocator(travel_t)>& travel1,std::vector<override_stl_allocator(travel_t)>& travel2,const travel_indice_t relation,const travel_indice_t node) {
+/*Non empty travels of travel2 by first take off time (stable , ties keep travel2 order)*/
+static void mt_sort_merge_leg(const std::vector<override_stl_allocator(travel_t)>& travel2,merge_leg_t& leg) {
+    std::vector<std::pair<uint64_t,uint32_t> > keys;
+
+    keys.reserve(travel2.size());
+    for (uint32_t i = 0,j = (uint32_t)travel2.size();i < j;++i) {
+        if (!travel2[i].flights.empty()) {
+            keys.push_back(std::make_pair(g_flights[travel2[i].flights[0]].take_off_time,i));
+        }
+    }
+
+    std::sort(keys.begin(),keys.end()); //(take off,position) : the position keeps it stable
+
+    leg.order.resize(keys.size());
+    leg.take_off.resize(keys.size());
+    for (uint32_t i = 0,j = (uint32_t)keys.size();i < j;++i) {
+        leg.take_off[i] = keys[i].first;
+        leg.order[i] = keys[i].second;
+    }
+}
+
+/*
+    The MT version of merge_path : travel2 is sorted by first take off time once , every t1 then finds the
+    travels it can be followed by (take off after t1 lands) with one binary search , a suffix of the sorted list.
+    k_range keeps that suffix as is : the result has one travel per t1 and find_cheapest walks the range ,
+    the sorted travel2 becomes a new composition node. travel2 may be the result of an earlier k_range merge_path ,
+    so a chain of legs is composed from the last one backwards and never flattened.
+    Other relations still get every pair (in travel2 order , travel2 must not be ranged).
+    spill (-max_memory) : once the output goes past its share of the budget , it is written to spill files chunk by chunk
+    (travel1 is left empty) and the next find_cheapest reads them back.
+*/
+void mt_merge_path(std::vector<override_stl_allocator(travel_t)>& travel1,std::vector<override_stl_allocator(travel_t)>& travel2,const travel_indice_t relation,
+                   const boolean_t spill) {
 
     if (travel2.empty()) {
         travel1.clear();
@@ -198,6 +579,53 @@ void mt_merge_path(std::vector<override_stl_allocator(travel_t)>& travel1,std::v
     const uint64_t thresold = g_parameters[0].merge_buffer_thresold;
     std::vector<override_stl_allocator(travel_t)> result;
     uint32_t head = 0,tail = (uint32_t)travel1.size();
+    travel_indice_t node = 0;
+    merge_leg_t leg;
+    spill_state_t spilled;
+    uint64_t bytes = 0;
+    uint32_t counted = 0;
+
+    if (spill && !g_merge_spill.empty()) {
+        printf("mt_merge_path : the last spilled output wasn't read by find_cheapest\n");
+        assert(0);
+        return;
+    }
+
+    spilled.share = (spill) ? g_parameters[0].max_memory / k_spill_share : 0;
+    spilled.partitions = 0;
+    spilled.written = spilled.read = spilled.io_ns = 0;
+
+    for (uint32_t i = 0;i < tail;++i) { //t1 is matched by its own last flight
+        if (travel1[i].ranged()) {
+            printf("mt_merge_path : travel1 is already composed , merge the legs from the last one\n");
+            assert(0);
+            return;
+        }
+    }
+
+    mt_sort_merge_leg(travel2,leg);
+
+    if (relation == k_range) { //The ranges point in the sorted list of each thread
+        std::vector<override_stl_allocator(travel_t)> sorted(leg.order.size());
+
+        node = (travel_indice_t)g_merge_phase_relations->at(0).nodes.size();
+        if (node >= k_compose_nodes) {
+            printf("mt_merge_path : more than %u composition nodes\n",k_compose_nodes);
+            assert(0);
+            return;
+        }
+
+        for (uint32_t i = 0,j = (uint32_t)leg.order.size();i < j;++i) {
+            sorted[i] = travel2[leg.order[i]];
+        }
+
+        for (uint32_t i = 0;i < g_thread_contexts;++i) {
+            g_merge_phase_relations->at(i).nodes.push_back(merge_phase_node_t());
+            g_merge_phase_relations->at(i).nodes.back().b = sorted;
+            g_merge_phase_relations->at(i).nodes.back().b_order = leg.order;
+            g_merge_phase_relations->at(i).nodes.back().rest.assign(sorted.size() * k_dp_tiers,k_rest_unknown);
+        }
+    }
 
     while (head < tail) {
         uint32_t len = thresold;
@@ -205,15 +633,32 @@ void mt_merge_path(std::vector<override_stl_allocator(travel_t)>& travel1,std::v
             len = tail - head;
         }
 
-        mt_merge_path_impl(travel1,travel2,result,head,head + len,relation,node);
+        mt_merge_path_impl(travel1,travel2,leg,result,head,head + len,relation,node);
         head += len;
+
+        if (spilled.share > 0) { //Past the share , everything from here on goes to disk too (keeps the list order)
+            for (const uint32_t j = (uint32_t)result.size();counted < j;++counted) {
+                bytes += mt_travel_bytes(result[counted]);
+            }
+
+            if ((spilled.partitions > 0) || (bytes > spilled.share)) {
+                mt_spill_tail(spilled,g_merge_spill,result,0);
+                bytes = counted = 0;
+            }
+        }
+    }
+
+    if (g_parameters[0].b_mt_stats && (spilled.partitions > 0)) {
+        printf("merge_path spill : %u partitions , %.1fMB written , %.3fms I/O\n",spilled.partitions,
+        (f64)spilled.written / (1024.0 * 1024.0),(f64)spilled.io_ns / 1e6);
     }
 
-    travel1 = result;
+    travel1.swap(result);
 }
 
 void mt_merge_path_impl(std::vector<override_stl_allocator(travel_t)>& travel1,
                                 std::vector<override_stl_allocator(travel_t)>& travel2,
+                                const merge_leg_t& leg,
                                 std::vector<override_stl_allocator(travel_t)>& results,
                                 const uint32_t travel1_start,
                                 const uint32_t travel1_end,
@@ -231,23 +676,22 @@ void mt_merge_path_impl(std::vector<override_stl_allocator(travel_t)>& travel1,
     //Initialize contexts
     my_arg = new merge_path_args_t[thread_count];
     assert(my_arg != 0);
- 
- 
-    boolean_t skip_one_copy = true; //Don't copy travel2 for one of the instances
 
     for (uint32_t i = 0;i < e;++i) {
+        my_arg[i].ranges = new std::vector<merge_range_t>();
+        assert(my_arg[i].ranges != 0);
         my_arg[i].results =  new std::vector<override_stl_allocator(travel_indice_pair_t)>();
         assert(my_arg[i].results != 0);
+        my_arg[i].costs = new std::vector<travel_cost_t>();
+        assert(my_arg[i].costs != 0);
         my_arg[i].travel1 = &travel1;
-        my_arg[i].travel2 = (skip_one_copy) ? &travel2  : new std::vector<override_stl_allocator(travel_t)>(travel2);
-        my_arg[i].start =  extent[i].s0;
-        my_arg[i].end =  extent[i].s1;
-       // printf("%u %u / l %u --> %lu\n",my_arg[i].start,my_arg[i].end,travel1_end - travel1_start,travel1.size());
+        my_arg[i].travel2 = &travel2; //Read only
+        my_arg[i].leg = &leg;
+        my_arg[i].start = travel1_start + extent[i].s0;
+        my_arg[i].end = travel1_start + extent[i].s1;
+        my_arg[i].relation = relation;
         my_arg[i].thread_index = i;
         my_arg[i].flight_count = g_flights_size;
-        my_arg[i].start2 = 0;
-        my_arg[i].end2 = travel2.size();
-        skip_one_copy = false;
     }
  
     for (uint32_t i = 0;i < e;++i) { 
@@ -258,8 +702,18 @@ void mt_merge_path_impl(std::vector<override_stl_allocator(travel_t)>& travel1,
     mt_wait_threads(e);
 
     for (uint32_t q = 0; q < e;++q) {
-        if (&travel2 != my_arg[q].travel2) {
-            delete my_arg[q].travel2;
+        if (relation == k_range) { //One travel per t1 : its own flights + the range
+            const std::vector<merge_range_t>& ranges = *my_arg[q].ranges;
+
+            for (uint32_t j = 0,k = (uint32_t)ranges.size();j < k;++j) {
+                travel_t& t1 = travel1[ranges[j].t1];
+
+                results.push_back(travel_t());
+                travel_t& new_travel = results.back();
+                new_travel.flights.swap(t1.flights); //Each t1 shows up once
+                new_travel.price = t1.price;
+                new_travel.range(ranges[j].first,ranges[j].count,node);
+            }
         }
 
         const uint32_t output_len = my_arg[q].results->size();
@@ -270,30 +724,25 @@ void mt_merge_path_impl(std::vector<override_stl_allocator(travel_t)>& travel1,
 
             results.push_back(travel_t()); 
             travel_t& new_travel = results.back();
-            if (relation == k_mate) {
-                new_travel.mate(a0,a1,node);
-            } else {
-        
-                const travel_t& t1 = travel1[a0];
-                const travel_t& t2 = travel2[a1];
+            new_travel.price = my_arg[q].costs->at(j);
 
-                const uint32_t tsize = t1.flights.size();
-                const uint32_t hsize = t2.flights.size();
-        
-                new_travel.flights.reserve(tsize + hsize);
-                new_travel.relation = k_invalid_relation;
+            const travel_t& t1 = travel1[a0];
+            const travel_t& t2 = travel2[a1];
 
-                for (uint32_t i = 0;i < tsize;++i) {    
-                    new_travel.flights.push_back(t1.flights[i]);
-                }
+            const uint32_t tsize = t1.flights.size();
+            const uint32_t hsize = t2.flights.size();
+        
+            new_travel.flights.resize(tsize + hsize);
+            new_travel.relation = k_invalid_relation;
 
-                for (uint32_t i = 0;i < hsize;++i) {    
-                    new_travel.flights.push_back(t2.flights[i]);
-                }
-            }
+            //Two block copies , no per flight capacity checks
+            memcpy(&new_travel.flights[0],&t1.flights[0],tsize * sizeof(flight_indice_t));
+            memcpy(&new_travel.flights[tsize],&t2.flights[0],hsize * sizeof(flight_indice_t));
         }
 
+        delete my_arg[q].ranges;
         delete my_arg[q].results;
+        delete my_arg[q].costs;
     }
 
     delete []my_arg;
@@ -301,734 +750,3941 @@ void mt_merge_path_impl(std::vector<override_stl_allocator(travel_t)>& travel1,
 
 
 
-/*The MT version of fill_travel*/
+/*
+    fill_travel : Departures from starting_point come straight out of the departure index ,
+    no need to split the flight list between threads anymore.
+*/
 void mt_fill_travel(std::vector<override_stl_allocator(travel_t)>& travels,const indexed_string_t starting_point, uint64_t t_min, uint64_t t_max) {
+    const flight_indice_t* departures;
+    uint32_t first,last;
+    travel_t t;
 
-    const uint32_t thread_count = g_thread_contexts;
-    std::vector<extent_t> extent;
-    uint32_t exp,e;
-    fill_travel_args_t* my_arg;
-    const indexed_string_t starting_point_hash = starting_point;
+    travels.clear();
 
-    //Calculate tile size per worker thread
-    calculate_extent(extent,g_flights_size,thread_count);
-    e = extent.size();
+    fi_departures_window(fi_airport_id(starting_point),t_min,t_max,first,last);
+    if (first == last) {
+        return;
+    }
 
-    //Initialize contexts
-    my_arg = new fill_travel_args_t[thread_count];
-    assert(my_arg != 0);
+    departures = &g_flight_index.departures[0];
+    travels.reserve(last - first);
+    t.flights.push_back(0);
 
-    //Split work in threads
-    for (uint32_t i = 0;i < e;++i) {
-        my_arg[i].t_min = t_min;
-        my_arg[i].t_max = t_max;
-        my_arg[i].starting_point = starting_point_hash;
-        my_arg[i].thread_index = i;
-        my_arg[i].flight_count = g_flights_size;
-        my_arg[i].results = new std::vector<override_stl_allocator(travel_t)>();
-        my_arg[i].start = extent[i].s0;
-        my_arg[i].end = extent[i].s1;
-        pthread_create(&g_thread_context[i],NULL,mt_fill_travel_entry_point,(void*)&my_arg[i]);
-    }
+    //Only the land time is left to test , nothing is visited yet. Zones landing after t_max are skipped whole
+    for (uint32_t base = first,end;base < last;base = end) {
+        const uint32_t zone = base / k_departure_zone;
+        end = ((zone + 1) * k_departure_zone < last) ? (zone + 1) * k_departure_zone : last;
 
-    //Wait for results
-    mt_wait_threads(e);
+        if (fi_zone_rejects(zone,t_max,k_nothing_visited)) {
+            continue;
+        }
 
-    //Sum up wanted size and allocate it
-    exp = 0;
-    for (uint32_t i = 0; i < e;++i) {
-        exp += my_arg[i].results->size();
+        uint64_t mask = ff_filter(&g_flight_index.departures_land[base],&g_flight_index.departures_to[base],end - base,t_max,k_nothing_visited);
+
+        for (;mask != 0;mask &= mask - 1) {
+            const flight_ref_t& f = g_flights[departures[base + __builtin_ctzll(mask)]];
+            t.flights[0] = f.index;
+            mt_cost_start(t.price,f);
+            for (uint32_t j = 0;j < k_visited_words;++j) {
+                t.visited[j] = 0;
+            }
+            t.visit(f.from_id);
+            t.visit(f.to_id);
+            travels.push_back(t);
+        }
     }
+}
 
-    travels.clear();
-    travels.reserve(exp);
+/*
+    Order of the frontier travels a[0..hops) and b[0..hops) (same hop count) in mt_sort_frontier : by airport , land time ,
+    then position in the unsorted frontier. That one is the order their prefixes were expanded in (departure position
+    after that) , fill_travel's departure position on the first level.
+*/
+static int32_t mt_frontier_order(const flight_indice_t* a,const flight_indice_t* b,const uint32_t hops) {
+    const uint32_t pa = g_flight_index.positions[a[hops - 1]];
+    const uint32_t pb = g_flight_index.positions[b[hops - 1]];
 
-    //Append results + cleanup
-    exp = 0;
-    for (uint32_t i = 0; i < e;++i) {
-        const uint32_t output_len = my_arg[i].results->size();
-        for (uint32_t j = 0;j < output_len;++j) {
-            travels.push_back(my_arg[i].results->at(j));
+    if (g_flight_index.departures_to[pa] != g_flight_index.departures_to[pb]) {
+        return (g_flight_index.departures_to[pa] < g_flight_index.departures_to[pb]) ? -1 : 1;
+    }
+    if (g_flight_index.departures_land[pa] != g_flight_index.departures_land[pb]) {
+        return (g_flight_index.departures_land[pa] < g_flight_index.departures_land[pb]) ? -1 : 1;
+    }
+    if (hops > 1) {
+        const int32_t order = mt_frontier_order(a,b,hops - 1);
+        if (0 != order) {
+            return order;
         }
-        delete my_arg[i].results;
     }
- 
-    delete []my_arg;
+
+    return (pa == pb) ? 0 : ((pa < pb) ? -1 : 1);
 }
 
-/*The MT version of find_cheapest*/
-void mt_find_cheapest(travel_t& result,std::vector<override_stl_allocator(travel_t)>& travels,std::vector<std::vector<indexed_string_t> >&alliances) {
+/*
+    Order of two paths of a leg in compute_path's travel list (one thread) : a path of n > 1 flights is pushed when its
+    prefix of n - 1 flights is expanded , level by level , in sorted frontier order and then departure order.
+    A direct flight is pushed on the first level at its own frontier position. -1 , 0 , 1 as a < b , a == b , a > b
+*/
+static int32_t mt_leg_order(const flight_indice_t* a,const uint32_t a_size,const flight_indice_t* b,const uint32_t b_size) {
+    const uint32_t a_level = (a_size > 1) ? a_size - 1 : 1;
+    const uint32_t b_level = (b_size > 1) ? b_size - 1 : 1;
 
-    if (travels.empty()) { //Nothing to do
-        return;
+    if (a_level != b_level) {
+        return (a_level < b_level) ? -1 : 1;
     }
-    
-    const uint32_t thread_count = g_thread_contexts;
-    uint32_t e;
-    find_cheapest_args_t* my_arg; 
-    std::vector<extent_t> extent;
 
-    //Calculate tile size per worker thread
-    calculate_extent(extent,travels.size(),thread_count);
-    e = extent.size();
+    const int32_t order = mt_frontier_order(a,b,a_level);
+    if (0 != order) {
+        return order;
+    } else if (a_size != b_size) { //Same first flight , can't happen : a direct flight isn't expanded
+        return (a_size < b_size) ? -1 : 1;
+    } else if (a_size == a_level) {
+        return 0;
+    }
 
-    //Initialize contexts
-    my_arg = new find_cheapest_args_t[thread_count];
-    assert(my_arg != 0);
+    const uint32_t pa = g_flight_index.positions[a[a_level]];
+    const uint32_t pb = g_flight_index.positions[b[b_level]];
+    return (pa == pb) ? 0 : ((pa < pb) ? -1 : 1);
+}
 
-    //Split work in threads
-    for (uint32_t i = 0;i < e;++i) {
-        my_arg[i].flight_count = g_flights_size;
-        my_arg[i].thread_index = i;
-        my_arg[i].start = (int64_t)extent[i].s0;
-        my_arg[i].end = (int64_t)extent[i].s1;
-        my_arg[i].travels = &travels;
-        my_arg[i].out_travel = new travel_t;
-        pthread_create(&g_thread_context[i],NULL,mt_find_cheapest_entry_point,(void*)&my_arg[i]);
+/*One past the last flight of the leg that starts with t.flights[i] : its first arrival at to*/
+static inline uint32_t mt_leg_end(const travel_t& t,uint32_t i,const uint32_t to) {
+    const uint32_t size = (uint32_t)t.flights.size();
+
+    while ((i < size) && (g_flights[t.flights[i]].to_id != to)) {
+        ++i;
     }
 
-    //Wait for results
-    mt_wait_threads(e);
+    return (i < size) ? i + 1 : size;
+}
 
-    //Figure out which indice contains the best cost
-    const uint32_t bottom = (uint32_t)e-1;
-    uint32_t best_ind = bottom;
-    f32 best_cost = my_arg[bottom].best_cost;
+/*
+    merge_path + find_cheapest order of two travels over the legs' DAGs (leg i ends at the first arrival at its destination) :
+    the travel list position of the first leg , then of the next ones. find_cheapest keeps the highest one on a tie
+*/
+static int32_t mt_dag_order(const travel_t& a,const travel_t& b,path_dag_t* const* dags,const uint32_t leg_count) {
+    uint32_t i = 0,j = 0;
 
-    for (int64_t i = (int64_t)bottom;i >= 0 ;--i) { 
-        if (my_arg[i].best_cost < best_cost) {        
-            best_cost = my_arg[i].best_cost;
-            best_ind = i;
+    for (uint32_t leg = 0;leg < leg_count;++leg) {
+        const uint32_t a_end = mt_leg_end(a,i,dags[leg]->to);
+        const uint32_t b_end = mt_leg_end(b,j,dags[leg]->to);
+        const int32_t order = mt_leg_order(&a.flights[i],a_end - i,&b.flights[j],b_end - j);
+
+        if (0 != order) {
+            return order;
         }
+
+        i = a_end;
+        j = b_end;
     }
 
-    //And return it as result
+    return 0;
+}
 
-    result = *my_arg[best_ind].out_travel;
+/*
+    Streamed work : merge_path + find_cheapest order of two travels , the streamed leg's travel list position
+    (rebuilt from its size first flights) then the tails' ones. find_cheapest keeps the highest one on a tie
+*/
+static int32_t mt_stream_order(const travel_t& a,const uint32_t a_size,const uint32_t* a_key,
+                               const travel_t& b,const uint32_t b_size,const uint32_t* b_key,const uint32_t tail_count) {
+    const int32_t order = mt_leg_order(&a.flights[0],a_size,&b.flights[0],b_size);
 
-    for (uint32_t i = 0;i < e;++i) {
-        delete my_arg[i].out_travel;
+    if (0 != order) {
+        return order;
     }
-    travels.clear();
-    delete []my_arg;
-}
 
-/*Initialize ALL global contexts of mt module*/ 
-boolean_t mt_init(const Parameters& params) {
-    const uint32_t thread_count = (uint32_t)params.nb_threads;
+    for (uint32_t i = 0;i < tail_count;++i) {
+        if (a_key[i] != b_key[i]) {
+            return (a_key[i] < b_key[i]) ? -1 : 1;
+        }
+    }
 
-    g_global_permutations = new path_permutations_c("GLOBAL",(uint32_t)params.perm_size);
-    //g_local_permutations = new path_permutations_c("LOCAL",(uint32_t)params.perm_size);
+    return 0;
+}
 
-    g_thread_contexts = thread_count;
-    g_thread_context = new pthread_t[thread_count];
-    assert(g_thread_context != 0);
-    g_thread_context_res = new uint64_t*[thread_count];
-    assert(g_thread_context_res != 0);
-    g_parameters = new Parameters[thread_count];
-    assert(g_parameters != 0);
+/*
+    Streamed work : the paths of the first leg (to , from travels) are generated depth first in small batches and merged 
+    with the tail legs (already computed) and costed on the fly , so neither the first leg's paths nor the merged travels 
+    are ever stored. Same result as compute_path + merge_path(s) + find_cheapest. Returns false if there is no travel at all.
+*/
+boolean_t mt_stream_cheapest(travel_t& result,f32& cost,const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,
+                             uint64_t t_min,uint64_t t_max,const std::vector<override_stl_allocator(travel_t)>* const* tails,const uint32_t tail_count) {
+    const uint32_t thread_count = g_thread_contexts;
+    std::atomic<uint32_t> next_root(0);
+    stream_cheapest_args_t* my_arg;
+    boolean_t found = false;
 
-    for (uint32_t i = 0;i < thread_count;++i) {
-        g_thread_context[i] = 0;
-        g_thread_context_res[i] = NULL;
-        g_parameters[i] = params;
+    for (uint32_t i = 0;i < tail_count;++i) {
+        if (tails[i]->empty()) {
+            return false;
+        }
     }
 
- 
-    //Set initialization flag and return
-    g_mt_initialized = 1;
-    return true;
-}
- 
-/*Receives all input data for the current session*/
-boolean_t mt_set_work_data(std::vector<flight_ref_t>& flights_ref,
-                 const std::vector<std::vector<indexed_string_t>>& alliances) {
+    if (travels.empty()) {
+        return false;
+    }
+
+    const uint64_t* feasible = fi_feasible(fi_airport_id(to),t_max,g_parameters[0].max_layover_time);
+
+    my_arg = new stream_cheapest_args_t[thread_count];
+    assert(my_arg != 0);
 
-    const uint32_t thread_count = g_thread_contexts;
- 
-    //Allocate space for flights list (one for each thread)
-    g_flights_size = flights_ref.size();
-    g_flights = new flight_ref_t[g_flights_size * thread_count];
-    assert(g_flights != 0);
- 
-    //Create a copy of allianes (one for each thread)
-    g_alliances.reserve(thread_count);
- 
-    //Copy lists
     for (uint32_t i = 0;i < thread_count;++i) {
-        g_alliances.push_back(alliance_t());
-        g_alliances[i].alliances = alliances;
-        flight_ref_t* base = &g_flights[g_flights_size * i];
+        my_arg[i].thread_index = i;
+        my_arg[i].flight_count = g_flights_size;
+        my_arg[i].to_airport = fi_airport_id(to);
+        my_arg[i].t_min = t_min;
+        my_arg[i].t_max = t_max;
+        my_arg[i].max_layover_time = g_parameters[0].max_layover_time;
+        my_arg[i].feasible = feasible;
+        my_arg[i].roots = &travels;
+        my_arg[i].next_root = &next_root;
+        my_arg[i].tails = tails;
+        my_arg[i].tail_count = tail_count;
+        my_arg[i].found = false;
+        my_arg[i].best = new travel_t;
+        if (pthread_create(&g_thread_context[i],NULL,mt_stream_cheapest_entry_point,(void*)&my_arg[i]) != 0) {
+            printf("pthread_create failed!\n"); 
+            assert(0);
+        }
+    }
 
-        for (uint32_t j = 0,k = flights_ref.size();j < k;++j) {
-            base[j].cost = flights_ref[j].cost;
-            base[j].take_off_time = flights_ref[j].take_off_time;
-            base[j].land_time = flights_ref[j].land_time;
-            base[j].discount = flights_ref[j].discount;
-            base[j].index = flights_ref[j].index;
-            base[j].from_hash = flights_ref[j].from_hash;
-            base[j].to_hash = flights_ref[j].to_hash;
-            base[j].company_hash = flights_ref[j].company_hash;
-            base[j].id_hash = flights_ref[j].id_hash;
-            base[j].index = j;
+    mt_wait_threads(thread_count);
+
+    //Same rule as mt_stream_join : which thread streamed which starting travel doesn't matter
+    uint32_t best = 0;
+    for (uint32_t i = 0;i < thread_count;++i) {
+        if (my_arg[i].found && (!found || (my_arg[i].best_cost < cost) || ((my_arg[i].best_cost == cost) &&
+            (mt_stream_order(*my_arg[i].best,my_arg[i].best_size,my_arg[i].best_key,
+                             *my_arg[best].best,my_arg[best].best_size,my_arg[best].best_key,tail_count) > 0)))) {
+            found = true;
+            cost = my_arg[i].best_cost;
+            best = i;
         }
     }
- 
-    return true;
+
+    if (found) {
+        result = *my_arg[best].best;
+    }
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        delete my_arg[i].best;
+    }
+
+    delete[] my_arg;
+    return found;
 }
 
-/*Cleanup session global contexts*/
-void mt_shutdown() {
+/*Builds the DAG of a leg from its fill_travel output (replaces compute_path)*/
+void mt_build_path_dag(path_dag_t& dag,const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,uint64_t t_min,uint64_t t_max) {
+    const uint32_t to_id = fi_airport_id(to);
+    const uint64_t max_layover_time = g_parameters[0].max_layover_time;
 
-    delete g_global_permutations;
-    delete[] g_thread_context;
-    delete[] g_thread_context_res;
-    delete[] g_flights;
-    delete[]  g_parameters;
- 
-    g_global_permutations = 0;
-    g_flights = 0;
-    g_parameters = 0;
-    g_thread_context = 0;
-    g_thread_context_res = 0;
-    g_thread_contexts = 0;
+    pd_build(dag,travels,to_id,t_min,t_max,max_layover_time,fi_feasible(to_id,t_max,max_layover_time));
 
-    g_mt_initialized = 0;
+    if (g_parameters[0].b_mt_stats) {
+        printf("Path DAG : %u roots , %u nodes , %u edges\n",(uint32_t)dag.roots.size(),dag.nodes,(uint32_t)dag.edges.size());
+    }
+}
 
-    g_alliances.clear();
+/*k_dp_tier index of a pair discount*/
+static inline uint32_t mt_dp_tier_index(const f32 t) {
+    return (t < 0.75f) ? 2 : ((t < 0.9f) ? 1 : 0);
 }
- 
-void mt_copy_travel(std::vector<override_stl_allocator(travel_t)>* dst,std::vector<override_stl_allocator(travel_t)>* src,
-    const uint32_t dst_base,const uint32_t len) {
+
+/*DP : state of leg/position q arriving with tier t , from state with value v ending with fp (tier k)*/
+static inline void mt_dp_relax(std::vector<f32>& value,std::vector<uint32_t>& pred,const uint32_t state,const f32 v,
+                               const flight_ref_t& fp,const uint32_t k,const uint32_t leg,const uint32_t flights_size,const uint32_t q,
+                               flight_ref_t* flights,std::vector<std::vector<indexed_string_t>>& alliances) {
+    const f32 t = mt_pair_discount(fp,flights[g_flight_index.departures[q]],alliances);
+    const uint32_t tier = mt_dp_tier_index(t);
+    const uint32_t target = (((leg * flights_size) + q) * k_dp_tiers) + tier;
+    const f32 nv = v + (fp.cost * ((t < k_dp_tier[k]) ? t : k_dp_tier[k]));
+
+    if (nv < value[target]) {
+        value[target] = nv;
+        pred[target] = state;
+    }
+}
+
+/*DP : the flight path[i] lands on an airport its leg already visited (travel.visited holds the leg so far)*/
+static inline boolean_t mt_dp_revisits(const travel_t& travel,const uint32_t leg,const std::vector<uint32_t>& path,
+                                       const uint32_t i,const uint32_t flights_size) {
+    const uint32_t airport = g_flight_index.departures_to[path[i] % flights_size];
+
+    if (!travel.maybe_visited(airport)) {
+        return false;
+    } else if (g_flight_index.visited_exact) {
+        return true;
+    }
+
+    uint32_t j = i;
+    while ((j > 0) && ((path[j - 1] / flights_size) == leg)) { //First flight of the leg
+        --j;
+    }
+
+    if (g_flights[g_flight_index.departures[path[j] % flights_size]].from_id == airport) {
+        return true;
+    }
+
+    for (;j < i;++j) {
+        if (g_flight_index.departures_to[path[j] % flights_size] == airport) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*Branch and bound : per leg bounds (last leg first , prices of thread 0's copy) , bound starts at +infinity*/
+static void mt_dag_bounds(path_dag_t* const* dags,const uint32_t leg_count,std::atomic<uint32_t>* bound) {
+    const uint32_t flights_size = (uint32_t)g_flight_index.departures.size();
+    const f32 none = std::numeric_limits<f32>::infinity();
+    std::vector<f32> cost(flights_size);
+    uint32_t bits;
+
+    for (uint32_t p = 0;p < flights_size;++p) {
+        cost[p] = g_flights[g_flight_index.departures[p]].cost;
+    }
+
+    for (uint32_t i = leg_count;i-- > 0;) {
+        pd_bound(*dags[i],&cost[0],((i + 1) < leg_count) ? dags[i + 1] : 0);
+    }
+
+    memcpy(&bits,&none,sizeof(bits));
+    bound->store(bits);
+}
+
+/*
+    find_cheapest over the legs' DAGs : each leg's simple paths , legs joined with the merge_path rule 
+    (next leg takes off after the previous one lands). Threads take the roots of the first leg one at a time.
+    Same result as compute_path + merge_path(s) + find_cheapest. Returns false if there is no travel at all.
+    seed : first upper bound of the branch and bound (price of a known travel) , +infinity : greedy seed
+*/
+static boolean_t mt_dag_search(travel_t& result,f32& cost,path_dag_t* const* dags,const uint32_t leg_count,const boolean_t b_bound,
+                               const f32 seed) {
     const uint32_t thread_count = g_thread_contexts;
-    copy_travel_args_t* my_arg;
-    std::vector<extent_t> extent;
-    uint32_t e;
+    std::atomic<uint32_t> next_root(0);
+    std::atomic<uint32_t> bound(0);
+    dag_cheapest_args_t* my_arg;
+    boolean_t found = false;
 
-    if (0 == len) { 
-        return;
+    for (uint32_t i = 0;i < leg_count;++i) {
+        if (dags[i]->roots.empty()) {
+            return false;
+        }
     }
 
-    calculate_extent(extent,len,thread_count);
-    e = extent.size();
+    //Legs after the first are walked once per root , the first leg's paths take their cheapest rest from there
+    std::vector<dag_suffix_t>* suffixes = (leg_count > 1) ? new std::vector<dag_suffix_t>[leg_count] : 0;
+    if (0 != suffixes) {
+        mt_dag_suffixes(suffixes,dags,leg_count);
+    }
 
-    my_arg = new copy_travel_args_t[thread_count];
+    my_arg = new dag_cheapest_args_t[thread_count];
     assert(my_arg != 0);
 
-    for (uint32_t i = 0;i < e;++i) {
-        my_arg[i].src = src;
-        my_arg[i].dst = dst;
-        my_arg[i].base = dst_base;
-        my_arg[i].start = extent[i].s0;
-        my_arg[i].end = extent[i].s1;
+    for (uint32_t i = 0;i < thread_count;++i) {
+        my_arg[i].thread_index = i;
+        my_arg[i].flight_count = g_flights_size;
+        my_arg[i].dags = dags;
+        my_arg[i].leg_count = leg_count;
+        my_arg[i].suffixes = suffixes;
+        my_arg[i].next_root = &next_root;
+        my_arg[i].found = false;
+        my_arg[i].best = new travel_t;
+        my_arg[i].bound = (b_bound) ? &bound : 0;
+    }
 
-        if (pthread_create(&g_thread_context[i],NULL,mt_copy_travel_entry_point,(void*)&my_arg[i]) != 0) {
+    if (b_bound) {
+        mt_dag_bounds(dags,leg_count,&bound);
+        if (std::numeric_limits<f32>::infinity() != seed) {
+            uint32_t bits;
+            memcpy(&bits,&seed,sizeof(bits));
+            bound.store(bits);
+        } else {
+            mt_dag_greedy(&my_arg[0]); //Thread 0 keeps the seed travel
+        }
+    }
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        if (pthread_create(&g_thread_context[i],NULL,mt_dag_cheapest_entry_point,(void*)&my_arg[i]) != 0) {
             printf("pthread_create failed!\n"); 
             assert(0);
         }
     }
 
-    mt_wait_threads(e);
+    mt_wait_threads(thread_count);
+
+    //Same rule as mt_dag_offer : which thread walked which root doesn't matter
+    for (uint32_t i = 0;i < thread_count;++i) {
+        if (my_arg[i].found && (!found || (my_arg[i].best_cost < cost) ||
+            ((my_arg[i].best_cost == cost) && (mt_dag_order(*my_arg[i].best,result,dags,leg_count) > 0)))) {
+            found = true;
+            cost = my_arg[i].best_cost;
+            result = *my_arg[i].best;
+        }
+        delete my_arg[i].best;
+    }
+
+    if (b_bound && g_parameters[0].b_mt_stats) {
+        for (uint32_t d = 1;d < k_bnb_depths;++d) {
+            uint64_t expanded = 0,pruned = 0;
+            for (uint32_t i = 0;i < thread_count;++i) {
+                expanded += my_arg[i].expanded[d];
+                pruned += my_arg[i].pruned[d];
+            }
+            if ((expanded + pruned) > 0) {
+                printf("B&B depth %u%s : expanded %llu pruned %llu (%.1f%%)\n",d,((d + 1) == k_bnb_depths) ? "+" : "",
+                       (unsigned long long)expanded,(unsigned long long)pruned,(100.0 * pruned) / (f64)(expanded + pruned));
+            }
+        }
+    }
 
+    delete[] suffixes;
     delete[] my_arg;
+    return found;
 }
- 
-void mt_compute_path(const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,uint64_t t_min,uint64_t t_max) {
-    if (travels.empty()) {  //Nothing to do
-        return;
+
+/*
+    Time ordered DP over the legs' DAGs (connection scan) : a flight's discount only depends on its neighbours , so
+    the cheapest way to arrive with flight p is one value per discount p got from the flight before it.
+    value = price of everything before p (final) , p -> q with tier t : value + p's price x min(p's tier,t) for (q,t).
+    Flights are scanned by take off time so every state is final before it's used , legs one after the other.
+    The DP doesn't know about the no-revisit rule : if its travel revisits an airport the exact search runs instead.
+*/
+static boolean_t mt_dp_cheapest(travel_t& result,f32& cost,path_dag_t* const* dags,const uint32_t leg_count) {
+    const uint32_t flights_size = (uint32_t)g_flight_index.departures.size();
+    const uint32_t states = leg_count * flights_size * k_dp_tiers;
+    const uint64_t* take_off = &g_flight_index.departures_take_off[0];
+    const uint64_t* land = &g_flight_index.departures_land[0];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    const flight_indice_t* departures = &g_flight_index.departures[0];
+    flight_ref_t* flights = g_flights;
+    std::vector<std::vector<indexed_string_t>>& alliances = g_alliances[0].alliances;
+    const f32 none = std::numeric_limits<f32>::infinity();
+    std::vector<f32> value(states,none);
+    std::vector<uint32_t> pred(states,k_dp_no_state);
+    uint32_t best = k_dp_no_state;
+    f32 best_cost = none;
+
+    for (uint32_t i = 0;i < leg_count;++i) {
+        if (dags[i]->roots.empty()) {
+            return false;
+        }
+        for (uint32_t p = 0;p < flights_size;++p) {
+            if (dags[i]->member[p] && (land[p] < take_off[p])) { //Scan order breaks , enumerate
+                return mt_dag_search(result,cost,dags,leg_count,true,none);
+            }
+        }
     }
 
-    compute_path2_args_t* my_arg;
-    const uint32_t thread_count = g_thread_contexts;
-    std::vector<extent_t> extent;
-    uint32_t e;
+    for (uint32_t r = 0,e = (uint32_t)dags[0]->roots.size();r < e;++r) {
+        value[dags[0]->roots[r] * k_dp_tiers] = 0.0f;
+    }
 
-    {
-        //If we visited again this sequence return its previous result..
-        permutation_sequence_t* pseq = g_global_permutations->match(to,travels);
-        if (pseq != 0) {
-            //printf("Match SEQ %lu %lu %lu\n",travels.size(),pseq->travels.size(),pseq->path.size());
-            travels = pseq->path;
-            return;
+    for (uint32_t leg = 0;leg < leg_count;++leg) {
+        const path_dag_t& dag = *dags[leg];
+        const uint32_t leg_base = leg * flights_size;
+
+        for (uint32_t i = 0;i < flights_size;++i) {
+            const uint32_t p = g_flight_index.by_take_off[i];
+
+            if (!dag.member[p]) {
+                continue;
+            }
+
+            flight_ref_t& fp = flights[departures[p]];
+
+            for (uint32_t k = 0;k < k_dp_tiers;++k) {
+                const uint32_t state = ((leg_base + p) * k_dp_tiers) + k;
+                const f32 v = value[state];
+
+                if (v == none) {
+                    continue;
+                }
+
+                if (arrival[p] == dag.to) {
+                    if ((leg + 1) == leg_count) { //Complete travel , p's discount is final
+                        const f32 total = v + (fp.cost * k_dp_tier[k]);
+                        if (total < best_cost) {
+                            best_cost = total;
+                            best = state;
+                        }
+                        continue;
+                    }
+
+                    const path_dag_t& next = *dags[leg + 1];
+                    for (uint32_t r = pd_first_root_after(next,land[p]),e = (uint32_t)next.roots.size();r < e;++r) {
+                        mt_dp_relax(value,pred,state,v,fp,k,leg + 1,flights_size,next.roots[r],flights,alliances);
+                    }
+                    continue;
+                }
+
+                for (uint32_t e = dag.offset[p],e_end = dag.offset[p + 1];e < e_end;++e) {
+                    mt_dp_relax(value,pred,state,v,fp,k,leg,flights_size,dag.edges[e],flights,alliances);
+                }
+            }
         }
     }
 
-    //Calculate tile size for flights.size()
-    calculate_extent(extent,g_flights_size,thread_count);
-    e = extent.size();
+    if (k_dp_no_state == best) {
+        return false;
+    }
 
-    //Initialize contexts up to thread_count since sub-tile-size might differ
-    my_arg = new compute_path2_args_t[thread_count];
+    //Walk back , then check the no-revisit rule leg by leg
+    std::vector<uint32_t> path;
+    for (uint32_t state = best;state != k_dp_no_state;state = pred[state]) {
+        path.push_back(state / k_dp_tiers);
+    }
+    std::reverse(path.begin(),path.end());
+
+    travel_t travel;
+    uint32_t leg = k_dp_no_state;
+    boolean_t simple = true;
+
+    for (uint32_t i = 0,j = (uint32_t)path.size();(i < j) && simple;++i) {
+        const uint32_t p = path[i] % flights_size;
+        const flight_ref_t& f = flights[departures[p]];
+
+        if ((path[i] / flights_size) != leg) { //First flight of a leg
+            leg = path[i] / flights_size;
+            for (uint32_t w = 0;w < k_visited_words;++w) {
+                travel.visited[w] = 0;
+            }
+            travel.visit(f.from_id);
+        }
+
+        simple = !mt_dp_revisits(travel,leg,path,i,flights_size);
+        travel.visit(f.to_id);
+        travel.flights.push_back(f.index);
+    }
+
+    if (g_parameters[0].b_mt_stats) {
+        printf("DP : %u states , %u flights , %s\n",states,(uint32_t)path.size(),(simple) ? "simple" : "revisits an airport (exact search)");
+    }
+
+    if (!simple) { //Exact repair
+        return mt_dag_search(result,cost,dags,leg_count,true,none);
+    }
+
+    //Other travels may have the same price (summed in another order) : the exact search starts with this one's price as
+    //its bound , walks only what can tie and keeps the one find_cheapest would have
+    return mt_dag_search(result,cost,dags,leg_count,true,compute_cost(flights,travel,alliances));
+}
+
+/*
+    Best first over the legs' DAGs : partial travels ordered by price so far + lower bound of the rest (mt_dag_bound) 
+    in a multi queue all threads pop from. A complete travel lowers the shared bound , popped or new travels whose bound 
+    is above it are dropped. Done when the queue is empty and no thread is expanding : nothing left can beat the best.
+*/
+static boolean_t mt_best_first_cheapest(travel_t& result,f32& cost,path_dag_t* const* dags,const uint32_t leg_count) {
+    const uint32_t thread_count = g_thread_contexts;
+    std::atomic<uint32_t> bound(0);
+    std::atomic<uint32_t> active(0);
+    multi_queue_c<best_first_item_t>* queue;
+    dag_cheapest_args_t* my_arg;
+    boolean_t found = false;
+
+    for (uint32_t i = 0;i < leg_count;++i) {
+        if (dags[i]->roots.empty()) {
+            return false;
+        }
+    }
+
+    queue = new multi_queue_c<best_first_item_t>;
+    assert(queue != 0);
+    queue->init(k_best_first_heaps * thread_count);
+
+    my_arg = new dag_cheapest_args_t[thread_count];
     assert(my_arg != 0);
 
-    for (uint32_t i = 0;i < e;++i) {
-        my_arg[i].output = new std::vector<override_stl_allocator(travel_t)>();
-        assert(my_arg[i].output != 0);
-        my_arg[i].input = new std::vector<override_stl_allocator(travel_t)>();
-        assert(my_arg[i].input != 0);
-        my_arg[i].final_travels = new std::vector<override_stl_allocator(travel_t)>();
-        assert(my_arg[i].final_travels != 0);
-        my_arg[i].t_min = t_min;
-        my_arg[i].t_max = t_max;
-        my_arg[i].max_layover_time = g_parameters[0].max_layover_time;
-        my_arg[i].start = extent[i].s0;
-        my_arg[i].end = extent[i].s1;
-        my_arg[i].to = to;
+    for (uint32_t i = 0;i < thread_count;++i) {
         my_arg[i].thread_index = i;
-        my_arg[i].flight_count = g_flights_size;    
- 
+        my_arg[i].flight_count = g_flights_size;
+        my_arg[i].dags = dags;
+        my_arg[i].leg_count = leg_count;
+        my_arg[i].suffixes = 0;
+        my_arg[i].next_root = 0;
+        my_arg[i].found = false;
+        my_arg[i].best = new travel_t;
+        my_arg[i].bound = &bound;
+        my_arg[i].queue = queue;
+        my_arg[i].active = &active;
+        my_arg[i].popped = my_arg[i].stale = 0;
+        for (uint32_t d = 0;d < k_bnb_depths;++d) {
+            my_arg[i].expanded[d] = my_arg[i].pruned[d] = 0;
+        }
     }
 
-    //Partial perm update : Target / Input
-    g_global_permutations->cycle(to,travels);
+    mt_dag_bounds(dags,leg_count,&bound);
+    mt_best_first_roots(&my_arg[0]);
 
-    //Repeat until travel list has no more elements
-    
-    //uint32_t optimized_paths = 0;
-    uint32_t exp = 0;
-    while (!travels.empty()) { 
-        const uint32_t len = travels.size();
+    for (uint32_t i = 0;i < thread_count;++i) {
+        if (pthread_create(&g_thread_context[i],NULL,mt_best_first_entry_point,(void*)&my_arg[i]) != 0) {
+            printf("pthread_create failed!\n"); 
+            assert(0);
+        }
+    }
 
-        for (uint32_t j = 0;j < e ;++j) {
-            //Start/end offsets in flight list
-            my_arg[j].start = extent[j].s0;
-            my_arg[j].end = extent[j].s1;
-                    
-            //Start/end offsets in travels list
-            my_arg[j].start2 = 0;
-            my_arg[j].end2 = len;
-            *my_arg[j].input = travels;
-
-            // printf("%u %u\n",my_arg[j].start2,my_arg[j].end2);
-            if (pthread_create(&g_thread_context[j],NULL,mt_compute_path2_entry_point,(void*)&my_arg[j]) != 0) {
-                printf("pthread_create failed!\n"); 
-                assert(0);
+    mt_wait_threads(thread_count);
+
+    //Same rule as mt_dag_offer : which thread popped which travel doesn't matter
+    for (uint32_t i = 0;i < thread_count;++i) {
+        if (my_arg[i].found && (!found || (my_arg[i].best_cost < cost) ||
+            ((my_arg[i].best_cost == cost) && (mt_dag_order(*my_arg[i].best,result,dags,leg_count) > 0)))) {
+            found = true;
+            cost = my_arg[i].best_cost;
+            result = *my_arg[i].best;
+        }
+        delete my_arg[i].best;
+    }
+
+    if (g_parameters[0].b_mt_stats) {
+        uint64_t queued = 0,pruned = 0,popped = 0,stale = 0;
+        uint32_t nodes = 0;
+        for (uint32_t i = 0;i < thread_count;++i) {
+            for (uint32_t d = 0;d < k_bnb_depths;++d) {
+                queued += my_arg[i].expanded[d];
+                pruned += my_arg[i].pruned[d];
+            }
+            popped += my_arg[i].popped;
+            stale += my_arg[i].stale;
+        }
+        for (uint32_t i = 0;i < leg_count;++i) {
+            nodes += dags[i]->nodes;
+        }
+        printf("Best first : %llu queued , %llu pruned , %llu expanded (%llu beaten in the queue) , DAG nodes %u\n",
+               (unsigned long long)queued,(unsigned long long)pruned,(unsigned long long)(popped - stale),(unsigned long long)stale,nodes);
+    }
+
+    delete[] my_arg;
+    delete queue;
+    return found;
+}
+
+boolean_t mt_dag_cheapest(travel_t& result,f32& cost,path_dag_t* const* dags,const uint32_t leg_count) {
+    if (g_parameters[0].b_dp_engine) {
+        return mt_dp_cheapest(result,cost,dags,leg_count);
+    } else if (g_parameters[0].b_best_first) {
+        return mt_best_first_cheapest(result,cost,dags,leg_count);
+    }
+
+    return mt_dag_search(result,cost,dags,leg_count,0 != g_parameters[0].b_branch_bound,std::numeric_limits<f32>::infinity());
+}
+
+/*
+    -suffix_minima : dense company ids (sorted hashes) and the companies sharing an alliance with each one ,
+    same test as mt_pair_discount on one flight of each company
+*/
+static void mt_join_companies(std::vector<indexed_string_t>& companies,join_partners_t& partners) {
+    std::vector<uint32_t> sample;
+    std::vector<std::vector<indexed_string_t> >& alliances = g_alliances[0].alliances;
+
+    companies.clear();
+    for (uint32_t i = 0;i < g_flights_size;++i) {
+        companies.push_back(g_flights[i].company_hash);
+    }
+    std::sort(companies.begin(),companies.end());
+    companies.erase(std::unique(companies.begin(),companies.end()),companies.end());
+
+    const uint32_t n = (uint32_t)companies.size();
+    sample.assign(n,0);
+    for (uint32_t i = g_flights_size;i-- > 0;) {
+        sample[std::lower_bound(companies.begin(),companies.end(),g_flights[i].company_hash) - companies.begin()] = i;
+    }
+
+    partners.companies = n;
+    partners.offset.assign(n + 1,0);
+    partners.partners.clear();
+    partners.shared.assign(n * n,0);
+    for (uint32_t c1 = 0;c1 < n;++c1) {
+        for (uint32_t c2 = 0;c2 < n;++c2) {
+            if ((c1 == c2) || has_just_traveled_with_alliance(g_flights[sample[c1]],g_flights[sample[c2]],alliances)) {
+                partners.shared[(c1 * n) + c2] = 1;
+                partners.partners.push_back(c2);
+            }
+        }
+        partners.offset[c1 + 1] = (uint32_t)partners.partners.size();
+    }
+}
+
+/*Summary of every travel of a leg , sorted by first take off (stable)*/
+static void mt_join_summarize(std::vector<leg_summary_t>& summaries,const std::vector<override_stl_allocator(travel_t)>& travels,
+                              const std::vector<indexed_string_t>& companies) {
+    const flight_ref_t* flights = g_flights;
+    std::vector<std::vector<indexed_string_t> >& alliances = g_alliances[0].alliances;
+
+    summaries.clear();
+    summaries.reserve(travels.size());
+
+    for (uint32_t i = 0,j = (uint32_t)travels.size();i < j;++i) {
+        const travel_t& t = travels[i];
+        const uint32_t hops = (uint32_t)t.flights.size();
+
+        if (0 == hops) {
+            continue;
+        }
+
+        const flight_ref_t& first = flights[t.flights[0]];
+        const flight_ref_t& last = flights[t.flights[hops - 1]];
+        leg_summary_t s;
+
+        s.take_off = first.take_off_time;
+        s.land = last.land_time;
+        s.first_company = (uint32_t)(std::lower_bound(companies.begin(),companies.end(),first.company_hash) - companies.begin());
+        s.last_company = (uint32_t)(std::lower_bound(companies.begin(),companies.end(),last.company_hash) - companies.begin());
+        s.travel = i;
+        s.hops = hops;
+        s.inner = 0.0f;
+        s.first_cost = first.cost;
+        s.last_cost = (hops > 1) ? last.cost : 0.0f;
+        s.first_tier = s.last_tier = 1.0f;
+
+        //Tiers inside the travel , every flight between the first and the last one gets the lower of its two sides
+        f32 left = 1.0f;
+        for (uint32_t k = 1;k < hops;++k) {
+            const f32 right = mt_pair_discount(flights[t.flights[k - 1]],flights[t.flights[k]],alliances);
+
+            if (1 == k) {
+                s.first_tier = right;
+            } else {
+                s.inner += flights[t.flights[k - 1]].cost * ((left < right) ? left : right);
+            }
+            left = right;
+        }
+        s.last_tier = left;
+
+        summaries.push_back(s);
+    }
+
+    std::sort(summaries.begin(),summaries.end());
+}
+
+static void* mt_join_value_entry_point(void* in_args) {
+    join_value_args_t* args = (join_value_args_t*)in_args;
+    const std::vector<leg_summary_t>& summaries = *args->summaries;
+    std::vector<f32>& value = *args->value;
+
+    for (uint32_t i = args->start;i < args->end;++i) {
+        const leg_summary_t& s = summaries[i];
+        f32 best[k_join_classes];
+
+        if (0 == args->next) {
+            for (uint32_t c = 0;c < k_join_classes;++c) {
+                value[(i * k_join_classes) + c] = lj_price(s,k_join_tier[c],1.0f);
+            }
+            continue;
+        }
+
+        lj_best(*args->next,*args->partners,s.land,s.last_company,best);
+        for (uint32_t c = 0;c < k_join_classes;++c) {
+            f32 v = std::numeric_limits<f32>::infinity();
+
+            for (uint32_t r = 0;r < k_join_classes;++r) {
+                if (best[r] != std::numeric_limits<f32>::infinity()) {
+                    const f32 x = lj_price(s,k_join_tier[c],k_join_tier[r]) + best[r];
+                    v = (x < v) ? x : v;
+                }
+            }
+            value[(i * k_join_classes) + c] = v;
+        }
+    }
+
+    pthread_exit(NULL);
+    return NULL;
+}
+
+/*Values of a leg from the suffix minima of the next one (0 : last leg)*/
+static void mt_join_values(const std::vector<leg_summary_t>& summaries,const join_table_t* next,const join_partners_t& partners,
+                           std::vector<f32>& value) {
+    const uint32_t thread_count = g_thread_contexts;
+    std::vector<extent_t> extent;
+    join_value_args_t* my_arg;
+    uint32_t e;
+
+    value.resize(summaries.size() * k_join_classes);
+    if (summaries.empty()) {
+        return;
+    }
+
+    calculate_extent(extent,(uint32_t)summaries.size(),thread_count);
+    e = extent.size();
+
+    my_arg = new join_value_args_t[thread_count];
+    assert(my_arg != 0);
+
+    for (uint32_t i = 0;i < e;++i) {
+        my_arg[i].start = extent[i].s0;
+        my_arg[i].end = extent[i].s1;
+        my_arg[i].summaries = &summaries;
+        my_arg[i].next = next;
+        my_arg[i].partners = &partners;
+        my_arg[i].value = &value;
+        pthread_create(&g_thread_context[i],NULL,mt_join_value_entry_point,(void*)&my_arg[i]);
+    }
+
+    mt_wait_threads(e);
+    delete []my_arg;
+}
+
+/*
+    Exact pass : the chains whose value is within the slack of the cheapest one are costed with compute_cost ,
+    ties go to the chain merge_path + find_cheapest would have kept (highest travel list positions , first leg first)
+*/
+static void mt_join_walk(join_search_t& w,const uint32_t leg,const uint32_t pos,const uint32_t left,const f32 prefix) {
+    const leg_summary_t& s = w.summaries[leg][pos];
+    const travel_t& t = w.legs[leg]->at(s.travel);
+    const uint32_t size = (uint32_t)w.path.flights.size();
+
+    w.chain[leg] = pos;
+    w.path.flights.insert(w.path.flights.end(),t.flights.begin(),t.flights.end());
+
+    if ((leg + 1) == w.leg_count) {
+        if (prefix + lj_price(s,k_join_tier[left],1.0f) <= w.limit) {
+            const f32 cost = compute_cost(g_flights,w.path,g_alliances[0].alliances);
+            boolean_t better = !w.found || (cost < w.best_cost);
+
+            if (w.found && (cost == w.best_cost)) { //Highest positions win
+                for (uint32_t k = 0;k < w.leg_count;++k) {
+                    const uint32_t a = w.summaries[k][w.chain[k]].travel;
+                    if (a != w.best_key[k]) {
+                        better = (a > w.best_key[k]);
+                        break;
+                    }
+                }
+            }
+
+            if (better) {
+                w.found = true;
+                w.best_cost = cost;
+                w.best = w.path;
+                for (uint32_t k = 0;k < w.leg_count;++k) {
+                    w.best_key[k] = w.summaries[k][w.chain[k]].travel;
+                }
+            }
+        }
+    } else {
+        const std::vector<leg_summary_t>& next = w.summaries[leg + 1];
+        const f32* value = &w.value[leg + 1][0];
+        leg_summary_t key;
+
+        key.take_off = s.land;
+        key.travel = std::numeric_limits<uint32_t>::max();
+        for (uint32_t j = (uint32_t)(std::upper_bound(next.begin(),next.end(),key) - next.begin()),m = (uint32_t)next.size();j < m;++j) {
+            const uint32_t r = lj_class(*w.partners,s.last_company,next[j].first_company);
+            const f32 price = prefix + lj_price(s,k_join_tier[left],k_join_tier[r]);
+
+            if ((price + value[(j * k_join_classes) + r]) <= w.limit) {
+                mt_join_walk(w,leg + 1,j,r,price);
+            }
+        }
+    }
+
+    w.path.flights.resize(size);
+}
+
+/*
+    Cheapest travel over a chain of legs (merge_path rule at every junction) without merging them :
+    backward over the legs , every travel gets the cheapest price from it to the end of the chain for each tier
+    of its left junction (suffix minima of the next leg per junction class , see leg_join.hpp) ,
+    then only the chains within rounding of the cheapest one are costed exactly. Same result as
+    merge_path + find_cheapest. Returns false if there is no travel at all.
+*/
+boolean_t mt_join_cheapest(travel_t& result,f32& cost,std::vector<override_stl_allocator(travel_t)>* const* legs,const uint32_t leg_count) {
+    std::vector<leg_summary_t> summaries[k_max_join_legs];
+    std::vector<f32> value[k_max_join_legs];
+    std::vector<indexed_string_t> companies;
+    join_partners_t partners;
+    join_table_t table;
+    join_search_t* w;
+
+    if ((0 == leg_count) || (leg_count > k_max_join_legs)) {
+        printf("mt_join_cheapest : %u legs (1..%u)\n",leg_count,k_max_join_legs);
+        assert(0);
+        return false;
+    }
+
+    mt_join_companies(companies,partners);
+    for (uint32_t k = 0;k < leg_count;++k) {
+        mt_join_summarize(summaries[k],*legs[k],companies);
+        if (summaries[k].empty()) {
+            return false;
+        }
+    }
+
+    mt_join_values(summaries[leg_count - 1],0,partners,value[leg_count - 1]);
+    for (uint32_t k = leg_count - 1;k-- > 0;) {
+        lj_build(table,summaries[k + 1],value[k + 1],(uint32_t)companies.size());
+        mt_join_values(summaries[k],&table,partners,value[k]);
+    }
+    lj_clear(table);
+
+    f32 limit = std::numeric_limits<f32>::infinity();
+    for (uint32_t i = 0,j = (uint32_t)summaries[0].size();i < j;++i) {
+        limit = (value[0][i * k_join_classes] < limit) ? value[0][i * k_join_classes] : limit;
+    }
+
+    if (limit == std::numeric_limits<f32>::infinity()) {
+        return false;
+    }
+
+    w = new join_search_t;
+    assert(w != 0);
+    w->legs = legs;
+    w->summaries = summaries;
+    w->value = value;
+    w->partners = &partners;
+    w->leg_count = leg_count;
+    w->limit = limit + (limit * k_cost_slack);
+    w->found = false;
+    w->best_cost = 0.0f;
+
+    for (uint32_t i = 0,j = (uint32_t)summaries[0].size();i < j;++i) {
+        if (value[0][i * k_join_classes] <= w->limit) {
+            mt_join_walk(*w,0,i,0,0.0f);
+        }
+    }
+
+    const boolean_t found = w->found;
+    if (found) {
+        result = w->best;
+        cost = w->best_cost;
+    }
+
+    delete w;
+    return found;
+}
+
+/*Starts the find_cheapest threads over travels (one extent each) , returns how many*/
+static uint32_t mt_find_cheapest_start(find_cheapest_args_t* my_arg,std::vector<override_stl_allocator(travel_t)>& travels,const boolean_t rebuild) {
+    const uint32_t thread_count = g_thread_contexts;
+    std::vector<extent_t> extent;
+    uint32_t e;
+
+    //Calculate tile size per worker thread
+    calculate_extent(extent,travels.size(),thread_count);
+    e = extent.size();
+
+    //Split work in threads
+    for (uint32_t i = 0;i < e;++i) {
+        my_arg[i].flight_count = g_flights_size;
+        my_arg[i].thread_index = i;
+        my_arg[i].start = (int64_t)extent[i].s0;
+        my_arg[i].end = (int64_t)extent[i].s1;
+        my_arg[i].travels = &travels;
+        my_arg[i].out_travel = new travel_t;
+        my_arg[i].rebuild = rebuild;
+        pthread_create(&g_thread_context[i],NULL,mt_find_cheapest_entry_point,(void*)&my_arg[i]);
+    }
+
+    return e;
+}
+
+/*Waits for the find_cheapest threads , the cheapest of all (ties : the last thread , highest index)*/
+static void mt_find_cheapest_finish(find_cheapest_args_t* my_arg,const uint32_t e,travel_t& result,f32& cost) {
+    //Wait for results
+    mt_wait_threads(e);
+
+    //Figure out which indice contains the best cost
+    const uint32_t bottom = (uint32_t)e-1;
+    uint32_t best_ind = bottom;
+    f32 best_cost = my_arg[bottom].best_cost;
+
+    for (int64_t i = (int64_t)bottom;i >= 0 ;--i) { 
+        if (my_arg[i].best_cost < best_cost) {        
+            best_cost = my_arg[i].best_cost;
+            best_ind = i;
+        }
+    }
+
+    //And return it as result
+    result = *my_arg[best_ind].out_travel;
+    cost = best_cost;
+
+    for (uint32_t i = 0;i < e;++i) {
+        delete my_arg[i].out_travel;
+    }
+}
+
+/*Next bulk of the spilled merge_path output (partitions in list order , each one removed once read) , false at the end*/
+static boolean_t mt_merge_spill_next(uint32_t& part,streamed_travel_list_reader_c*& reader,std::vector<override_stl_allocator(travel_t)>& bulk) {
+    for (;;) {
+        if (0 == reader) {
+            if (part == g_merge_spill.size()) {
+                return false;
+            }
+            reader = new streamed_travel_list_reader_c(bulk,g_merge_spill[part],k_spill_bulk);
+            assert(reader != 0);
+        }
+
+        if (reader->next_bulk(bulk)) {
+            return true;
+        }
+
+        delete reader; //Removes the files
+        reader = 0;
+        rmdir(g_merge_spill[part++].c_str());
+    }
+}
+
+/*
+    The MT version of find_cheapest , false if there is no travel. A merge_path output that went to disk
+    (g_merge_spill) is read back in bulks : the threads cost one bulk while the main thread reads the next one.
+*/
+boolean_t mt_find_cheapest(travel_t& result,f32& cost,std::vector<override_stl_allocator(travel_t)>& travels,std::vector<std::vector<indexed_string_t> >&alliances) {
+    find_cheapest_args_t* my_arg; 
+    boolean_t found = false;
+
+    if (travels.empty() && g_merge_spill.empty()) { //Nothing to do
+        return false;
+    }
+
+    //Initialize contexts
+    my_arg = new find_cheapest_args_t[g_thread_contexts];
+    assert(my_arg != 0);
+
+    if (g_merge_spill.empty()) {
+        mt_find_cheapest_finish(my_arg,mt_find_cheapest_start(my_arg,travels,false),result,cost);
+        found = true;
+    } else {
+        std::vector<override_stl_allocator(travel_t)> bulk[2];
+        streamed_travel_list_reader_c* reader = 0;
+        uint32_t part = 0,cur = 0;
+        boolean_t more = mt_merge_spill_next(part,reader,bulk[cur]);
+        travel_t block;
+        f32 block_cost;
+
+        while (more) {
+            const uint32_t e = mt_find_cheapest_start(my_arg,bulk[cur],true);
+
+            more = mt_merge_spill_next(part,reader,bulk[cur ^ 1]);
+            mt_find_cheapest_finish(my_arg,e,block,block_cost);
+
+            if (!found || (block_cost <= cost)) { //Later bulks come later in the list
+                found = true;
+                result.swap(block);
+                cost = block_cost;
+            }
+            cur ^= 1;
+        }
+
+        g_merge_spill.clear();
+    }
+
+    travels.clear();
+    delete []my_arg;
+    return found;
+}
+
+/*Initialize ALL global contexts of mt module*/ 
+boolean_t mt_init(const Parameters& params) {
+    const uint32_t thread_count = (uint32_t)params.nb_threads;
+
+    g_global_permutations = new path_permutations_c("GLOBAL",(uint32_t)params.perm_size);
+    //g_local_permutations = new path_permutations_c("LOCAL",(uint32_t)params.perm_size);
+
+    g_thread_contexts = thread_count;
+    g_thread_context = new pthread_t[thread_count];
+    assert(g_thread_context != 0);
+    g_thread_context_res = new uint64_t*[thread_count];
+    assert(g_thread_context_res != 0);
+    g_parameters = new Parameters[thread_count];
+    assert(g_parameters != 0);
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        g_thread_context[i] = 0;
+        g_thread_context_res[i] = NULL;
+        g_parameters[i] = params;
+    }
+
+    g_expand_deques = new chase_lev_deque_c[thread_count];
+    assert(g_expand_deques != 0);
+    g_thread_stats.assign(thread_count,thread_stats_t());
+
+    ff_init((ff_isa_t)params.force_isa);
+    if (params.b_mt_stats) {
+        printf("Flight filter : %s\n",ff_isa());
+    }
+
+    if (params.b_verify_kernels && !ff_verify()) {
+        printf("Kernel self check failed!\n");
+        assert(0);
+        return false;
+    }
+
+    //NUMA nodes show up as /sys/devices/system/node/nodeN , their CPUs as a list of ranges in nodeN/cpulist ("0-3,8-11")
+    g_numa_nodes = 0;
+    g_numa_cpus.clear();
+    for (;;) {
+        char path[64];
+        snprintf(path,sizeof(path),"/sys/devices/system/node/node%u/cpulist",g_numa_nodes);
+        FILE* f = fopen(path,"r");
+        if (0 == f) {
+            break;
+        }
+
+        cpu_set_t cpus;
+        uint32_t lo,hi;
+        CPU_ZERO(&cpus);
+        while (1 <= fscanf(f,"%u",&lo)) {
+            hi = lo;
+            if ('-' == fgetc(f)) {
+                if (1 != fscanf(f,"%u",&hi)) {
+                    break;
+                }
+                fgetc(f);
+            }
+            for (uint32_t c = lo;(c <= hi) && (c < CPU_SETSIZE);++c) {
+                CPU_SET(c,&cpus);
+            }
+        }
+        fclose(f);
+
+        g_numa_cpus.push_back(cpus);
+        ++g_numa_nodes;
+    }
+    g_numa_nodes = (0 == g_numa_nodes) ? 1 : g_numa_nodes;
+
+ 
+    //Set initialization flag and return
+    g_mt_initialized = 1;
+    return true;
+}
+ 
+/*
+    Loads the transfer pattern index and builds the origins it doesn't have yet , threads take origins one by one
+    and append each record as soon as it's done (an interrupted build picks up from there next time).
+    The tries are built on a flight index of the whole schedule (not only this run's time windows) , so the index file
+    stays valid for any query window. This run's dense airport ids are a subset of it (both sorted by string index).
+*/
+static void mt_init_transfer_patterns(std::vector<flight_ref_t>& schedule) {
+    const std::string& path = g_parameters[0].transfer_patterns_file;
+    const uint32_t thread_count = g_thread_contexts;
+    const uint64_t start = mt_time_ns();
+    std::atomic<uint32_t> next(0);
+    pattern_build_args_t* my_arg;
+    pthread_mutex_t lock;
+    uint32_t loaded = 0,built = 0,skipped = 0;
+    boolean_t io_failed = false;
+    FILE* file = 0;
+    flight_index_t session = flight_index_t();
+
+    tp_clear(g_transfer_patterns);
+
+    //Whole schedule index in place of this run's one until the tries are done
+    std::swap(g_flight_index,session);
+    fi_init(schedule);
+
+    if (!g_flight_index.visited_exact) { //Reach bits are travel_t::visited bits
+        printf("Transfer patterns : schedule has more than %u airports , not used\n",k_visited_bits);
+        std::swap(g_flight_index,session);
+        return;
+    }
+
+    g_transfer_patterns.checksum = tp_checksum(g_parameters[0].max_layover_time);
+    if (!tp_open(g_transfer_patterns,path,file)) {
+        printf("Transfer patterns : can't open %s , not used\n",path.c_str());
+        tp_clear(g_transfer_patterns);
+        std::swap(g_flight_index,session);
+        return;
+    }
+
+    for (uint32_t i = 0,j = (uint32_t)g_transfer_patterns.state.size();i < j;++i) {
+        loaded += (g_transfer_patterns.state[i] != pattern_state_missing) ? 1 : 0;
+    }
+
+    pthread_mutex_init(&lock,NULL);
+    my_arg = new pattern_build_args_t[thread_count];
+    assert(my_arg != 0);
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        my_arg[i].next = &next;
+        my_arg[i].file = file;
+        my_arg[i].lock = &lock;
+        my_arg[i].max_layover_time = g_parameters[0].max_layover_time;
+        my_arg[i].built = my_arg[i].skipped = 0;
+        my_arg[i].io_failed = false;
+
+        if (pthread_create(&g_thread_context[i],NULL,mt_pattern_build_entry_point,(void*)&my_arg[i]) != 0) {
+            printf("pthread_create failed!\n"); 
+            assert(0);
+        }
+    }
+
+    mt_wait_threads(thread_count);
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        built += my_arg[i].built;
+        skipped += my_arg[i].skipped;
+        io_failed |= my_arg[i].io_failed;
+    }
+
+    delete[] my_arg;
+    pthread_mutex_destroy(&lock);
+    fclose(file);
+
+    //Back to this run's index , its airports as schedule ids
+    const std::vector<indexed_string_t>& whole = g_flight_index.airports;
+    g_transfer_patterns.airport.resize(session.airports.size());
+    for (uint32_t i = 0,j = (uint32_t)session.airports.size();i < j;++i) {
+        g_transfer_patterns.airport[i] = (uint32_t)(std::lower_bound(whole.begin(),whole.end(),session.airports[i]) - whole.begin());
+    }
+    std::swap(g_flight_index,session);
+
+    if (io_failed) {
+        printf("Transfer patterns : writing %s failed , the next run builds the missing origins again\n",path.c_str());
+    }
+
+    printf("Transfer patterns : %u origins loaded , %u built (%u too large) in %.3fms\n",loaded,built,skipped,
+    (f64)(mt_time_ns() - start) / 1e6);
+}
+
+/*Connection graph for this session's max layover , threads take arrival airports one by one*/
+static void mt_build_connections() {
+    const uint32_t thread_count = g_thread_contexts;
+    const uint64_t start = mt_time_ns();
+    connect_args_t* my_arg;
+    std::atomic<uint32_t> next(0);
+
+    fi_connect_init(g_parameters[0].max_layover_time);
+
+    my_arg = new connect_args_t[thread_count];
+    assert(my_arg != 0);
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        my_arg[i].next = &next;
+        my_arg[i].connections = 0;
+
+        if (pthread_create(&g_thread_context[i],NULL,mt_connect_entry_point,(void*)&my_arg[i]) != 0) {
+            printf("pthread_create failed!\n"); 
+            assert(0);
+        }
+    }
+
+    mt_wait_threads(thread_count);
+
+    if (g_parameters[0].b_mt_stats) {
+        uint64_t connections = 0;
+        for (uint32_t i = 0;i < thread_count;++i) {
+            connections += my_arg[i].connections;
+        }
+
+        printf("Connection graph : %u flights , %lu connections , %.1fKB , %.3fms\n",(uint32_t)g_flight_index.departures.size(),
+        (unsigned long)connections,(f64)fi_connect_bytes() / 1024.0,(f64)(mt_time_ns() - start) / 1e6);
+    }
+
+    delete[] my_arg;
+}
+
+/*Receives all input data for the current session*/
+boolean_t mt_set_work_data(std::vector<flight_ref_t>& flights_ref,
+                 const std::vector<std::vector<indexed_string_t>>& alliances,std::vector<flight_ref_t>& schedule) {
+
+    const uint32_t thread_count = g_thread_contexts;
+
+    //Dense airport ids + departure lists
+    if (!fi_init(flights_ref)) {
+        printf("fi_init failed\n");
+        assert(0);
+    }
+ 
+    //Allocate space for flights list (one for each thread)
+    g_flights_size = flights_ref.size();
+    g_flights = new flight_ref_t[g_flights_size * thread_count];
+    assert(g_flights != 0);
+ 
+    //Create a copy of allianes (one for each thread)
+    g_alliances.reserve(thread_count);
+
+    //Alliances of each company as a bit mask , common alliance test is one AND (see mt_pair_discount)
+    g_alliance_masks = (alliances.size() <= k_max_alliance_masks);
+    for (uint32_t j = 0,k = flights_ref.size();j < k;++j) {
+        flights_ref[j].alliance_mask = 0;
+        for (uint32_t a = 0,b = (g_alliance_masks) ? alliances.size() : 0;a < b;++a) {
+            for (uint32_t c = 0,d = alliances[a].size();c < d;++c) {
+                if (alliances[a][c] == flights_ref[j].company_hash) {
+                    flights_ref[j].alliance_mask |= (uint64_t)1 << a;
+                }
+            }
+        }
+    }
+ 
+    //Copy lists
+    for (uint32_t i = 0;i < thread_count;++i) {
+        g_alliances.push_back(alliance_t());
+        g_alliances[i].alliances = alliances;
+        flight_ref_t* base = &g_flights[g_flights_size * i];
+
+        for (uint32_t j = 0,k = flights_ref.size();j < k;++j) {
+            base[j].cost = flights_ref[j].cost;
+            base[j].take_off_time = flights_ref[j].take_off_time;
+            base[j].land_time = flights_ref[j].land_time;
+            base[j].discount = flights_ref[j].discount;
+            base[j].index = flights_ref[j].index;
+            base[j].from_hash = flights_ref[j].from_hash;
+            base[j].to_hash = flights_ref[j].to_hash;
+            base[j].company_hash = flights_ref[j].company_hash;
+            base[j].id_hash = flights_ref[j].id_hash;
+            base[j].from_id = flights_ref[j].from_id;
+            base[j].to_id = flights_ref[j].to_id;
+            base[j].alliance_mask = flights_ref[j].alliance_mask;
+            base[j].index = j;
+        }
+    }
+
+    mt_build_connections();
+
+    if (g_parameters[0].prefetch_distance >= 0) {
+        g_prefetch_distance = (uint32_t)g_parameters[0].prefetch_distance;
+    } else {
+        mt_calibrate_prefetch();
+    }
+
+    if (g_parameters[0].b_verify_kernels && !mt_verify_depth_kernels()) {
+        printf("Kernel self check failed!\n");
+        assert(0);
+        return false;
+    }
+
+    if (!g_parameters[0].transfer_patterns_file.empty()) {
+        mt_init_transfer_patterns(schedule);
+    }
+ 
+    return true;
+}
+
+/*
+    -prefetch_distance auto (opt in , the default is a fixed distance) : a synthetic frontier (random 3 flight travels over the real flight table , read in a
+    random order as mt_expand_sorted_range reads the sorted frontier) is walked at every candidate distance ,
+    the shortest distance within 2% of the fastest one wins. Takes a few ms.
+*/
+static void mt_calibrate_prefetch() {
+    const uint32_t count = k_prefetch_calibration;
+    const uint32_t candidates = sizeof(k_prefetch_candidates) / sizeof(k_prefetch_candidates[0]);
+    const flight_ref_t* flights = g_flights;
+    std::vector<travel_t> travels(count);
+    std::vector<uint32_t> order(count);
+    uint64_t elapsed[candidates];
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    uint64_t fastest = std::numeric_limits<uint64_t>::max();
+    volatile f32 sink = 0.0f;
+
+    g_prefetch_distance = 0;
+    if (0 == g_flights_size) {
+        return;
+    }
+
+    for (uint32_t i = 0;i < count;++i) {
+        for (uint32_t h = 0;h < 3;++h) {
+            seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+            travels[i].flights.push_back((flight_indice_t)((seed >> 33) % g_flights_size));
+        }
+        order[i] = i;
+    }
+
+    for (uint32_t i = count - 1;i > 0;--i) {
+        seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+        std::swap(order[i],order[(seed >> 33) % (i + 1)]);
+    }
+
+    for (uint32_t c = 0;c < candidates;++c) {
+        const uint32_t d = k_prefetch_candidates[c];
+
+        elapsed[c] = std::numeric_limits<uint64_t>::max();
+        for (uint32_t r = 0;r < 3;++r) { //Best of 3 , the first round also warms the caches up
+            const uint64_t start = mt_time_ns();
+            f32 sum = 0.0f;
+
+            for (uint32_t k = 0;k < count;++k) {
+                mt_prefetch_gathers(&travels[0],&order[0],k,count,d,flights,true);
+                const flight_ref_t& f = flights[travels[order[k]].flights.back()];
+                sum += f.cost * f.discount;
+            }
+
+            sink = sink + sum;
+            const uint64_t ns = mt_time_ns() - start;
+            elapsed[c] = (ns < elapsed[c]) ? ns : elapsed[c];
+        }
+        fastest = (elapsed[c] < fastest) ? elapsed[c] : fastest;
+    }
+
+    for (uint32_t c = 0;c < candidates;++c) {
+        if (elapsed[c] <= fastest + (fastest / 50)) {
+            g_prefetch_distance = k_prefetch_candidates[c];
+            break;
+        }
+    }
+
+    if (g_parameters[0].b_mt_stats) {
+        printf("Prefetch distance : %u (auto ,",g_prefetch_distance);
+        for (uint32_t c = 0;c < candidates;++c) {
+            printf(" %u:%.3fms",k_prefetch_candidates[c],(f64)elapsed[c] / 1e6);
+        }
+        printf(")\n");
+    }
+}
+
+/*Prints compute_path busy/idle time per thread*/
+static void mt_dump_stats() {
+    for (uint32_t i = 0;i < (uint32_t)g_thread_stats.size();++i) {
+        const thread_stats_t& stats = g_thread_stats[i];
+        const f64 total = (f64)(stats.busy_ns + stats.idle_ns);
+
+        printf("compute_path : thread %u | busy %.3fms | idle %.3fms (%.1f%%) | chunks %lu | stolen %lu\n",i,
+        (f64)stats.busy_ns / 1e6,(f64)stats.idle_ns / 1e6,(total > 0.0) ? ((f64)stats.idle_ns * 100.0) / total : 0.0,
+        (unsigned long)stats.chunks,(unsigned long)stats.steals);
+    }
+}
+
+/*Cleanup session global contexts*/
+void mt_shutdown() {
+
+    if (g_parameters[0].b_mt_stats) {
+        mt_dump_stats();
+    }
+
+    delete g_global_permutations;
+    delete[] g_expand_deques;
+    delete[] g_route_queues;
+    delete[] g_thread_context;
+    delete[] g_thread_context_res;
+    delete[] g_flights;
+    delete[]  g_parameters;
+ 
+    g_global_permutations = 0;
+    g_expand_deques = 0;
+    g_route_queues = 0;
+    g_flights = 0;
+    g_parameters = 0;
+    g_thread_context = 0;
+    g_thread_context_res = 0;
+    g_thread_contexts = 0;
+
+    g_mt_initialized = 0;
+
+    g_alliances.clear();
+    g_thread_stats.clear();
+    g_airport_owner.clear();
+    g_airport_slot.clear();
+    g_airport_shards.clear();
+    g_route_overflow.clear();
+    g_owner_next_size.clear();
+    tp_clear(g_transfer_patterns);
+    fi_shutdown();
+}
+ 
+void mt_copy_travel(std::vector<override_stl_allocator(travel_t)>* dst,std::vector<override_stl_allocator(travel_t)>* src,
+    const uint32_t dst_base,const uint32_t len) {
+    const uint32_t thread_count = g_thread_contexts;
+    copy_travel_args_t* my_arg;
+    std::vector<extent_t> extent;
+    uint32_t e;
+
+    if (0 == len) { 
+        return;
+    }
+
+    calculate_extent(extent,len,thread_count);
+    e = extent.size();
+
+    my_arg = new copy_travel_args_t[thread_count];
+    assert(my_arg != 0);
+
+    for (uint32_t i = 0;i < e;++i) {
+        my_arg[i].src = src;
+        my_arg[i].dst = dst;
+        my_arg[i].base = dst_base;
+        my_arg[i].start = extent[i].s0;
+        my_arg[i].end = extent[i].s1;
+
+        if (pthread_create(&g_thread_context[i],NULL,mt_copy_travel_entry_point,(void*)&my_arg[i]) != 0) {
+            printf("pthread_create failed!\n"); 
+            assert(0);
+        }
+    }
+
+    mt_wait_threads(e);
+
+    delete[] my_arg;
+}
+ 
+/*
+    Spill files (-max_memory) : one streamed_travel_list_writer_c file pair per partition , in its own directory.
+    Only the flights are stored , the visited set and the running price are rebuilt when a partition is read back.
+*/
+static inline uint64_t mt_travel_bytes(const travel_t& travel) {
+    return sizeof(travel_t) + (travel.flights.capacity() * sizeof(flight_indice_t));
+}
+
+/*Writes travels [first,last) (swapped out , they are left empty) as one partition*/
+static void mt_spill_write(spill_state_t& spill,std::vector<std::string>& parts,std::vector<override_stl_allocator(travel_t)>& travels,
+                           const uint32_t first,const uint32_t last) {
+    std::vector<override_stl_allocator(travel_t)> part(last - first);
+    char name[64];
+    uint64_t flights = 0;
+
+    for (uint32_t i = first;i < last;++i) {
+        part[i - first].swap(travels[i]);
+        flights += part[i - first].flights.size();
+    }
+
+    snprintf(name,sizeof(name),"/ayc_spill_%u_%u",(uint32_t)getpid(),g_spill_sequence.fetch_add(1));
+    const std::string dir = g_parameters[0].spill_dir + name;
+
+    const uint64_t start = mt_time_ns();
+    if (0 != mkdir(dir.c_str(),0700)) {
+        printf("Unable to create %s\n",dir.c_str());
+        assert(0);
+    }
+
+    streamed_travel_list_writer_c writer(part,dir,k_spill_bulk);
+    spill.io_ns += mt_time_ns() - start;
+    spill.written += (((uint64_t)part.size() * k_stream_record_words) + 3 + flights) * sizeof(flight_indice_t);
+    ++spill.partitions;
+    parts.push_back(dir);
+}
+
+/*Keeps the first travels that fit in share bytes , the rest goes to partitions of up to share bytes each*/
+static void mt_spill_tail(spill_state_t& spill,std::vector<std::string>& parts,std::vector<override_stl_allocator(travel_t)>& travels,
+                          const uint64_t share) {
+    const uint32_t len = (uint32_t)travels.size();
+    uint64_t bytes = 0;
+    uint32_t keep = 0;
+
+    while ((keep < len) && ((bytes + mt_travel_bytes(travels[keep])) <= share)) {
+        bytes += mt_travel_bytes(travels[keep++]);
+    }
+
+    for (uint32_t first = keep;first < len;) {
+        uint32_t last = first + 1;
+
+        bytes = mt_travel_bytes(travels[first]);
+        while ((last < len) && ((bytes + mt_travel_bytes(travels[last])) <= spill.share)) {
+            bytes += mt_travel_bytes(travels[last++]);
+        }
+
+        mt_spill_write(spill,parts,travels,first,last);
+        first = last;
+    }
+
+    travels.resize(keep);
+}
+
+/*Visited set and running price of a travel read back from a spill file (its own flights , a range is kept as is)*/
+static inline void mt_spill_rebuild(travel_t& travel,const flight_ref_t* flights,std::vector<std::vector<indexed_string_t> >& alliances) {
+    const uint32_t size = (uint32_t)travel.flights.size();
+
+    travel.visit(flights[travel.flights[0]].from_id);
+    mt_cost_start(travel.price,flights[travel.flights[0]]);
+    for (uint32_t k = 0;k < size;++k) {
+        travel.visit(flights[travel.flights[k]].to_id);
+        if (k > 0) {
+            mt_cost_append(travel.price,travel.price,flights[travel.flights[k - 1]],flights[travel.flights[k]],1 == k,alliances);
+        }
+    }
+}
+
+/*Appends partition dir to travels (bounded reads) , then removes it*/
+static void mt_spill_read(spill_state_t& spill,const std::string& dir,std::vector<override_stl_allocator(travel_t)>& travels) {
+    const flight_ref_t* flights = g_flights;
+    std::vector<std::vector<indexed_string_t> >& alliances = g_alliances[0].alliances;
+    std::vector<override_stl_allocator(travel_t)> bulk;
+    const uint64_t start = mt_time_ns();
+
+    streamed_travel_list_reader_c reader(bulk,dir,k_spill_bulk);
+
+    while (reader.next_bulk(bulk)) {
+        for (uint32_t i = 0,j = (uint32_t)bulk.size();i < j;++i) {
+            travel_t& travel = bulk[i];
+            const uint32_t size = (uint32_t)travel.flights.size();
+
+            if (0 != g_prefetch_distance) {
+                mt_prefetch_path_gathers(&bulk[0],i,0,j - 1,1,g_prefetch_distance,flights,std::numeric_limits<f32>::infinity());
+            }
+            mt_spill_rebuild(travel,flights,alliances);
+            spill.read += (size + k_stream_record_words) * sizeof(flight_indice_t);
+            travels.push_back(travel_t());
+            travels.back().swap(travel);
+        }
+    }
+
+    reader.shutdown();
+    rmdir(dir.c_str());
+    spill.io_ns += mt_time_ns() - start;
+}
+
+/*compute_path , shared frontier expanded level by level with work stealing*/
+static void mt_compute_path_steal(const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,uint64_t t_min,uint64_t t_max,
+                                  const uint64_t* feasible) {
+    compute_path2_args_t* my_arg;
+    const uint32_t thread_count = g_thread_contexts;
+    std::vector<extent_t> extent;
+    std::vector<uint32_t> order;
+    uint32_t e;
+
+    //Initialize all contexts since the number of tiles changes per level
+    my_arg = new compute_path2_args_t[thread_count];
+    assert(my_arg != 0);
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        my_arg[i].output = new std::vector<override_stl_allocator(travel_t)>();
+        assert(my_arg[i].output != 0);
+        my_arg[i].input = &travels;
+        my_arg[i].order = &order;
+        my_arg[i].final_travels = new std::vector<override_stl_allocator(travel_t)>();
+        assert(my_arg[i].final_travels != 0);
+        my_arg[i].t_min = t_min;
+        my_arg[i].t_max = t_max;
+        my_arg[i].max_layover_time = g_parameters[0].max_layover_time;
+        my_arg[i].to = to;
+        my_arg[i].feasible = feasible;
+        my_arg[i].suffixes = 0;
+        my_arg[i].thread_index = i;
+        my_arg[i].flight_count = g_flights_size;    
+    }
+
+    //Memory budget : each expand thread spills its frontier and final travels past its share of budget / 4
+    spill_state_t spill;
+    spill.share = g_parameters[0].max_memory / k_spill_share;
+    spill.partitions = 0;
+    spill.written = spill.read = spill.io_ns = 0;
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        my_arg[i].spill.share = (spill.share > 0) ? (spill.share + thread_count - 1) / thread_count : 0;
+        my_arg[i].spill.partitions = 0;
+        my_arg[i].spill.written = my_arg[i].spill.read = my_arg[i].spill.io_ns = 0;
+        my_arg[i].final_bytes = 0;
+    }
+
+    //Bidirectional mode is possible only with exact visited sets
+    suffix_table_t suffixes;
+    boolean_t bidir_tried = (0 == g_parameters[0].bidir_thresold) || !g_flight_index.visited_exact;
+
+    //Repeat until travel list (and spilled frontier) has no more elements
+    uint32_t exp = 0;
+    while (!travels.empty() || !spill.frontier.empty()) { 
+        if (travels.empty()) { //Next spilled partition , the latest one first (depth first , fewer files around)
+            mt_spill_read(spill,spill.frontier.back(),travels);
+            spill.frontier.pop_back();
+        }
+
+        //Frontier got too large : build the backward half from halfway between the earliest landing and t_max ,
+        //as deep as the forward half got so far
+        if (!bidir_tried && (travels.size() > g_parameters[0].bidir_thresold)) {
+            uint64_t t_lo = t_max;
+            uint32_t depth = 1;
+            for (uint32_t i = 0,j = (uint32_t)travels.size();i < j;++i) {
+                const uint64_t land = g_flights[travels[i].flights.back()].land_time;
+                const uint32_t hops = (uint32_t)travels[i].flights.size();
+                t_lo = (land < t_lo) ? land : t_lo;
+                depth = (hops > depth) ? hops : depth;
+            }
+            t_lo = (t_lo > t_min) ? t_lo : t_min;
+
+            bidir_tried = true;
+            if (bd_build(suffixes,fi_airport_id(to),t_lo + ((t_max - t_lo) >> 1),t_max,
+                         g_parameters[0].max_layover_time,feasible,depth)) {
+                for (uint32_t i = 0;i < thread_count;++i) {
+                    my_arg[i].suffixes = &suffixes;
+                }
+            }
+        }
+
+        //Group the frontier by airport so each departure list is streamed once per level
+        mt_sort_frontier(travels,order);
+
+        //Split the frontier in fixed size chunks , each thread starts with a contiguous run of them
+        const uint32_t chunk_count = (travels.size() + k_expand_chunk - 1) / k_expand_chunk;
+        calculate_extent(extent,chunk_count,(chunk_count < thread_count) ? chunk_count : thread_count);
+        e = extent.size();
+
+        for (uint32_t j = 0;j < e ;++j) {
+            g_expand_deques[j].init(extent[j].s1 - extent[j].s0);
+            for (uint32_t c = extent[j].s1;c > extent[j].s0;--c) { //Owner pops from the front of its run,thieves take the back
+                g_expand_deques[j].push(c - 1);
+            }
+            my_arg[j].thread_count = e;
+            my_arg[j].chunks = 0;
+            my_arg[j].steals = 0;
+        }
+
+        const uint64_t level_start = mt_time_ns();
+
+        for (uint32_t j = 0;j < e ;++j) {
+            if (pthread_create(&g_thread_context[j],NULL,mt_compute_path2_entry_point,(void*)&my_arg[j]) != 0) {
+                printf("pthread_create failed!\n"); 
+                assert(0);
+            }
+        }
+
+        //Wait for threads to finish their task 
+        mt_wait_threads(e);
+
+        const uint64_t level_ns = mt_time_ns() - level_start;
+        for (uint32_t j = 0;j < e;++j) {
+            thread_stats_t& stats = g_thread_stats[j];
+            stats.busy_ns += my_arg[j].busy_ns;
+            stats.idle_ns += (level_ns > my_arg[j].busy_ns) ? level_ns - my_arg[j].busy_ns : 0;
+            stats.chunks += my_arg[j].chunks;
+            stats.steals += my_arg[j].steals;
+        }
+
+        //Sum up wanted size and allocate it
+        exp = 0;
+        for (uint32_t i = 0; i < e;++i) {
+            exp += my_arg[i].output->size();
+        }
+
+        travels.clear();
+        travels.reserve(exp);
+
+        //Append results (moved , the level is never held twice)
+        for (uint32_t i = 0; i < e;++i) {
+            std::vector<override_stl_allocator(travel_t)>& output = *my_arg[i].output;
+            for (uint32_t j = 0,output_len = (uint32_t)output.size();j < output_len;++j) {
+                travels.push_back(travel_t());
+                travels.back().swap(output[j]);
+            }
+            output.clear();
+        }
+
+        //Collect the partitions the threads spilled during the level
+        for (uint32_t i = 0; i < e;++i) {
+            spill_state_t& part = my_arg[i].spill;
+            spill.frontier.insert(spill.frontier.end(),part.frontier.begin(),part.frontier.end());
+            spill.finals.insert(spill.finals.end(),part.finals.begin(),part.finals.end());
+            spill.partitions += part.partitions;
+            spill.written += part.written;
+            spill.io_ns += part.io_ns;
+            part.frontier.clear();
+            part.finals.clear();
+            part.partitions = 0;
+            part.written = part.io_ns = 0;
+        }
+    }
+
+    //Cleanup
+    for (uint32_t i = 0;i < thread_count;++i) {
+        delete my_arg[i].output;
+    }
+ 
+    //Sum up wanted size and allocate it
+    exp = 0;
+    for (uint32_t i = 0; i < thread_count;++i) {
+        exp += my_arg[i].final_travels->size();
+    }
+
+    travels.clear();
+    travels.reserve(exp);
+
+    //Spilled final travels first (merge_path wants them all in memory)
+    for (uint32_t i = 0,j = (uint32_t)spill.finals.size();i < j;++i) {
+        mt_spill_read(spill,spill.finals[i],travels);
+    }
+
+    if (g_parameters[0].b_mt_stats && (spill.partitions > 0)) {
+        printf("compute_path spill : %u partitions , %.1fMB written , %.1fMB read , %.3fms I/O\n",spill.partitions,
+        (f64)spill.written / (1024.0 * 1024.0),(f64)spill.read / (1024.0 * 1024.0),(f64)spill.io_ns / 1e6);
+    }
+
+    //Append results  
+    for (uint32_t i = 0; i < thread_count;++i) {
+        std::vector<override_stl_allocator(travel_t)>& final_travels = *my_arg[i].final_travels;
+        for (uint32_t j = 0,output_len = (uint32_t)final_travels.size();j < output_len;++j) {
+            travels.push_back(travel_t());
+            travels.back().swap(final_travels[j]);
+        }
+
+        delete my_arg[i].final_travels; 
+    }
+
+    delete[] my_arg;
+}
+
+/*
+    Owner computes mode : every thread owns the departure lists of a static set of airports (g_airport_owner) in a
+    private shard that the thread allocates itself. Owner threads are pinned to the CPUs of one NUMA node
+    (thread index % nodes) , so first touch places the shard on that node and the expansion runs there too.
+    Partial travels are routed through per pair SPSC queues to the owner of their current airport ,
+    flight lookups during the expansion never leave the owner's shard.
+*/
+
+/*Assigns airports to threads , heaviest departure lists first , each one to the least loaded thread*/
+static void mt_partition_airports(const uint32_t thread_count) {
+    const uint32_t airports = fi_airports();
+    std::vector<uint64_t> load(thread_count,0);
+    std::vector<std::pair<uint32_t,uint32_t> > by_size;
+
+    g_airport_owner.assign(airports,0);
+    by_size.reserve(airports);
+
+    for (uint32_t i = 0;i < airports;++i) {
+        const uint32_t departures = fi_departures_end(i) - g_flight_index.departures_offset[i];
+        by_size.push_back(std::pair<uint32_t,uint32_t>(~departures,i)); //~ : descending
+    }
+
+    std::sort(by_size.begin(),by_size.end());
+
+    for (uint32_t i = 0;i < airports;++i) {
+        uint32_t best = 0;
+        for (uint32_t j = 1;j < thread_count;++j) {
+            best = (load[j] < load[best]) ? j : best;
+        }
+        g_airport_owner[by_size[i].second] = best;
+        load[best] += ~by_size[i].first + 1;
+    }
+}
+
+/*
+    Pins an owner mode thread to the CPUs of NUMA node thread_index % nodes , the shard builder and the expansion of
+    the same thread land on the same node. Single node hosts (or a refused affinity) leave the scheduler free.
+*/
+static void mt_pin_owner_thread(const uint32_t thread_index) {
+    if (g_numa_cpus.size() > 1) {
+        pthread_setaffinity_np(pthread_self(),sizeof(cpu_set_t),&g_numa_cpus[thread_index % g_numa_cpus.size()]);
+    }
+}
+
+/*Each thread copies the departure lists of the airports it owns*/
+static void* mt_build_shard_entry_point(void* in_args) {
+    owner_path_args_t* args = (owner_path_args_t*)in_args;
+    airport_shard_t& shard = g_airport_shards[args->thread_index];
+    const flight_ref_t* flights = &g_flights[g_flights_size * args->thread_index];
+    const uint32_t airports = fi_airports();
+
+    mt_pin_owner_thread(args->thread_index);
+
+    shard.offset.clear();
+    shard.departures.clear();
+    shard.offset.push_back(0);
+
+    for (uint32_t i = 0;i < airports;++i) {
+        if (g_airport_owner[i] != args->thread_index) {
+            continue;
+        }
+
+        g_airport_slot[i] = (uint32_t)shard.offset.size() - 1;
+
+        for (uint32_t j = g_flight_index.departures_offset[i],k = fi_departures_end(i);j < k;++j) {
+            const flight_ref_t& f = flights[g_flight_index.departures[j]];
+            shard_flight_t d;
+            d.take_off_time = f.take_off_time;
+            d.land_time = f.land_time;
+            d.index = f.index;
+            d.to_id = f.to_id;
+            d.pos = j;
+            shard.departures.push_back(d);
+        }
+
+        shard.offset.push_back((uint32_t)shard.departures.size());
+    }
+
+    pthread_exit(NULL);
+    return NULL;
+}
+
+/*Builds the airport partition and the per thread shards once*/
+static void mt_init_shards() {
+    const uint32_t thread_count = g_thread_contexts;
+    owner_path_args_t* my_arg;
+
+    if (!g_airport_shards.empty()) {
+        return;
+    }
+
+    mt_partition_airports(thread_count);
+    g_airport_slot.assign(fi_airports(),0);
+    g_airport_shards.resize(thread_count);
+
+    my_arg = new owner_path_args_t[thread_count];
+    assert(my_arg != 0);
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        my_arg[i].thread_index = i;
+        if (pthread_create(&g_thread_context[i],NULL,mt_build_shard_entry_point,(void*)&my_arg[i]) != 0) {
+            printf("pthread_create failed!\n"); 
+            assert(0);
+        }
+    }
+
+    mt_wait_threads(thread_count);
+    delete[] my_arg;
+}
+
+/*Sends a travel to the owner of its current airport*/
+static inline void mt_route_travel(owner_path_args_t* args,const routed_travel_t& item,
+                                    std::vector<override_stl_allocator(routed_travel_t)>& next) {
+    const uint32_t self = args->thread_index;
+    const uint32_t dst = g_airport_owner[item.airport];
+
+    if (dst == self) {
+        next.push_back(item);
+    } else if (!g_route_queues[(self * args->thread_count) + dst].push(item)) {
+        g_route_overflow[(self * args->thread_count) + dst].push_back(item); //Picked up after the level barrier
+    }
+}
+
+/*Pops everything other threads routed to this one , returns the number of travels received*/
+static inline uint32_t mt_drain_routes(owner_path_args_t* args,std::vector<override_stl_allocator(routed_travel_t)>& next,
+                                        routed_travel_t& tmp) {
+    const uint32_t self = args->thread_index;
+    const uint32_t thread_count = args->thread_count;
+    uint32_t received = 0;
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        if (i == self) {
+            continue;
+        }
+
+        spsc_queue_c<routed_travel_t>& q = g_route_queues[(i * thread_count) + self];
+        while (q.pop(tmp)) {
+            next.push_back(routed_travel_t());
+            next.back().swap(tmp);
+            ++received;
+        }
+    }
+
+    return received;
+}
+
+/*Expands one travel inside the shard of its airport's owner*/
+static inline void mt_expand_owned_travel(owner_path_args_t* args,const airport_shard_t& shard,const flight_ref_t* flights,
+                                    const routed_travel_t& item,routed_travel_t& child,
+                                    std::vector<override_stl_allocator(routed_travel_t)>& next) {
+    const travel_t& travel = item.travel;
+    const boolean_t visited_exact = g_flight_index.visited_exact;
+
+    if (item.airport == args->to_airport) {
+        args->final_travels->push_back(travel);
+        return;
+    }
+
+    //Take off > land time , take off - land time <= max layover , take off >= t_min
+    const uint64_t t_lo = ((item.land_time + 1) > args->t_min) ? item.land_time + 1 : args->t_min;
+    const uint64_t t_hi = item.land_time + args->max_layover_time;
+    const uint32_t slot = g_airport_slot[item.airport];
+    const shard_flight_t* b = &shard.departures[0] + shard.offset[slot];
+    const shard_flight_t* e = &shard.departures[0] + shard.offset[slot + 1];
+    const uint32_t travel_size = travel.flights.size();
+
+    b = std::lower_bound(b,e,t_lo);
+    if ((b == e) || (b->take_off_time > t_hi)) {
+        return;
+    }
+
+    child.travel = travel;
+    child.travel.flights.push_back(0);
+
+    const flight_ref_t& last_flight = flights[travel.flights.back()];
+    std::vector<std::vector<indexed_string_t>>& alliances = g_alliances[args->thread_index].alliances;
+
+    for (;(b != e) && (b->take_off_time <= t_hi);++b) {
+        if ((b->land_time > args->t_max) || (0 == (fi_feasible_bits(args->feasible,b->pos) & 1))) {
+            continue;
+        }
+
+        if (travel.maybe_visited(b->to_id) && 
+            (visited_exact || !never_traveled_to((flight_ref_t*)flights,travel,travel_size,flights[b->index].to_hash))) {
+            continue;
+        }
+
+        const uint32_t w = travel_t::visited_word(b->to_id);
+        child.travel.flights[travel_size] = b->index;
+        child.travel.visited[w] = travel.visited[w] | travel_t::visited_mask(b->to_id);
+        mt_cost_append(child.travel.price,travel.price,last_flight,flights[b->index],1 == travel_size,alliances);
+        child.land_time = b->land_time;
+        child.airport = b->to_id;
+
+        if (b->to_id == args->to_airport) {
+            args->final_travels->push_back(child.travel);
+        } else {
+            mt_route_travel(args,child,next);
+        }
+
+        child.travel.visited[w] = travel.visited[w];
+    }
+}
+
+/*Owner computes worker : one thread per shard for the whole leg , levels are separated by barriers*/
+static void* mt_compute_path_owner_entry_point(void* in_args) {
+    owner_path_args_t* args = (owner_path_args_t*)in_args;
+    const uint32_t self = args->thread_index;
+    const uint32_t thread_count = args->thread_count;
+    const airport_shard_t& shard = g_airport_shards[self];
+    const flight_ref_t* flights = &g_flights[g_flights_size * self];
+    std::vector<override_stl_allocator(routed_travel_t)>* frontier = args->frontier;
+    std::vector<override_stl_allocator(routed_travel_t)>* next = new std::vector<override_stl_allocator(routed_travel_t)>();
+    routed_travel_t child,tmp;
+
+    mt_pin_owner_thread(self);
+
+    for (uint64_t level = 1;;++level) {
+        const uint64_t t0 = mt_time_ns();
+
+        next->clear();
+
+        for (uint32_t i = 0,j = (uint32_t)frontier->size();i < j;++i) {
+            mt_expand_owned_travel(args,shard,flights,(*frontier)[i],child,*next);
+
+            if (0 == (i & (k_expand_chunk - 1))) { //Keep the incoming queues moving
+                mt_drain_routes(args,*next,tmp);
+            }
+        }
+
+        args->busy_ns += mt_time_ns() - t0;
+
+        //Wait until every producer of this level is done , draining meanwhile
+        g_owner_producers_done.fetch_add(1,std::memory_order_acq_rel);
+        while (g_owner_producers_done.load(std::memory_order_acquire) < (level * thread_count)) {
+            if (0 == mt_drain_routes(args,*next,tmp)) {
+                sched_yield();
+            }
+        }
+        mt_drain_routes(args,*next,tmp);
+
+        pthread_barrier_wait(&g_owner_barrier);
+
+        //Travels that didn't fit in the queues
+        for (uint32_t i = 0;i < thread_count;++i) {
+            std::vector<override_stl_allocator(routed_travel_t)>& overflow = g_route_overflow[(i * thread_count) + self];
+            for (uint32_t j = 0,k = (uint32_t)overflow.size();j < k;++j) {
+                next->push_back(routed_travel_t());
+                next->back().swap(overflow[j]);
+            }
+            overflow.clear();
+        }
+
+        g_owner_next_size[self] = next->size();
+        pthread_barrier_wait(&g_owner_barrier);
+
+        uint64_t total = 0;
+        for (uint32_t i = 0;i < thread_count;++i) {
+            total += g_owner_next_size[i];
+        }
+
+        frontier->swap(*next);
+        if (0 == total) {
+            break;
+        }
+    }
+
+    delete next;
+
+    pthread_exit(NULL);
+    return NULL;
+}
+
+/*compute_path , owner computes mode*/
+static void mt_compute_path_owner(const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,uint64_t t_min,uint64_t t_max,
+                                  const uint64_t* feasible) {
+    const uint32_t thread_count = g_thread_contexts;
+    owner_path_args_t* my_arg;
+
+    mt_init_shards();
+
+    my_arg = new owner_path_args_t[thread_count];
+    assert(my_arg != 0);
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        my_arg[i].thread_index = i;
+        my_arg[i].thread_count = thread_count;
+        my_arg[i].to_airport = fi_airport_id(to);
+        my_arg[i].t_min = t_min;
+        my_arg[i].t_max = t_max;
+        my_arg[i].max_layover_time = g_parameters[0].max_layover_time;
+        my_arg[i].feasible = feasible;
+        my_arg[i].busy_ns = 0;
+        my_arg[i].frontier = new std::vector<override_stl_allocator(routed_travel_t)>();
+        my_arg[i].final_travels = new std::vector<override_stl_allocator(travel_t)>();
+    }
+
+    //Hand the initial travels to the owners of their airports
+    for (uint32_t i = 0,j = (uint32_t)travels.size();i < j;++i) {
+        const flight_ref_t& f = g_flights[travels[i].flights.back()];
+        std::vector<override_stl_allocator(routed_travel_t)>* frontier = my_arg[g_airport_owner[f.to_id]].frontier;
+        frontier->push_back(routed_travel_t());
+        frontier->back().travel.swap(travels[i]);
+        frontier->back().land_time = f.land_time;
+        frontier->back().airport = f.to_id;
+    }
+
+    travels.clear();
+
+    //Per pair queues , overflow lists , level barrier
+    if (g_route_queues == 0) {
+        g_route_queues = new spsc_queue_c<routed_travel_t>[thread_count * thread_count];
+        assert(g_route_queues != 0);
+        for (uint32_t i = 0;i < (thread_count * thread_count);++i) {
+            g_route_queues[i].init(k_route_queue_len);
+        }
+        g_route_overflow.resize(thread_count * thread_count);
+        g_owner_next_size.resize(thread_count);
+    }
+
+    g_owner_producers_done.store(0);
+    pthread_barrier_init(&g_owner_barrier,NULL,thread_count);
+
+    const uint64_t leg_start = mt_time_ns();
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        if (pthread_create(&g_thread_context[i],NULL,mt_compute_path_owner_entry_point,(void*)&my_arg[i]) != 0) {
+            printf("pthread_create failed!\n"); 
+            assert(0);
+        }
+    }
+
+    mt_wait_threads(thread_count);
+    pthread_barrier_destroy(&g_owner_barrier);
+
+    const uint64_t leg_ns = mt_time_ns() - leg_start;
+
+    //Collect results + stats
+    uint32_t exp = 0;
+    for (uint32_t i = 0;i < thread_count;++i) {
+        exp += my_arg[i].final_travels->size();
+    }
+
+    travels.reserve(exp);
+
+    for (uint32_t i = 0;i < thread_count;++i) {
+        std::vector<override_stl_allocator(travel_t)>* final_travels = my_arg[i].final_travels;
+        for (uint32_t j = 0,k = (uint32_t)final_travels->size();j < k;++j) {
+            travels.push_back(travel_t());
+            travels.back().swap(final_travels->at(j));
+        }
+
+        g_thread_stats[i].busy_ns += my_arg[i].busy_ns;
+        g_thread_stats[i].idle_ns += (leg_ns > my_arg[i].busy_ns) ? leg_ns - my_arg[i].busy_ns : 0;
+
+        delete my_arg[i].frontier;
+        delete final_travels;
+    }
+
+    delete[] my_arg;
+}
+
+/*
+    compute_path over the transfer patterns : the fill_travel flights of an origin with a complete trie are walked
+    depth first , a departure is only taken if its arrival continues the sequence and can still lead to the destination.
+    The trie holds every airport sequence of the schedule , so nothing compute_path would find is missed.
+    Tries are keyed on the whole schedule's dense ids , g_transfer_patterns.airport maps this session's ids to them.
+*/
+static boolean_t mt_use_patterns(const indexed_string_t to,const std::vector<override_stl_allocator(travel_t)>& travels) {
+    if (g_transfer_patterns.state.empty() || (k_invalid_airport == fi_airport_id(to))) {
+        return false;
+    }
+
+    const uint32_t origin = g_flights[travels[0].flights[0]].from_id;
+
+    if (g_transfer_patterns.state[g_transfer_patterns.airport[origin]] != pattern_state_ready) {
+        return false;
+    }
+
+    for (uint32_t i = 0,j = (uint32_t)travels.size();i < j;++i) {
+        if ((travels[i].flights.size() != 1) || (g_flights[travels[i].flights[0]].from_id != origin)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void mt_compute_path_patterns(const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,uint64_t t_min,uint64_t t_max,
+                                     const uint64_t* feasible) {
+    const uint32_t thread_count = g_thread_contexts;
+    pattern_path_args_t* my_arg;
+    std::vector<extent_t> extent;
+    uint32_t e,exp = 0;
+
+    calculate_extent(extent,travels.size(),thread_count);
+    e = extent.size();
+
+    my_arg = new pattern_path_args_t[e];
+    assert(my_arg != 0);
+
+    for (uint32_t i = 0;i < e;++i) {
+        my_arg[i].input = &travels;
+        my_arg[i].output = new std::vector<override_stl_allocator(travel_t)>();
+        assert(my_arg[i].output != 0);
+        my_arg[i].trie = &g_transfer_patterns.tries[g_transfer_patterns.airport[g_flights[travels[0].flights[0]].from_id]];
+        my_arg[i].start = extent[i].s0;
+        my_arg[i].end = extent[i].s1;
+        my_arg[i].thread_index = i;
+        my_arg[i].to_airport = fi_airport_id(to);
+        my_arg[i].to_pattern = g_transfer_patterns.airport[my_arg[i].to_airport];
+        my_arg[i].t_min = t_min;
+        my_arg[i].t_max = t_max;
+        my_arg[i].max_layover_time = g_parameters[0].max_layover_time;
+        my_arg[i].feasible = feasible;
+
+        if (pthread_create(&g_thread_context[i],NULL,mt_pattern_path_entry_point,(void*)&my_arg[i]) != 0) {
+            printf("pthread_create failed!\n"); 
+            assert(0);
+        }
+    }
+
+    mt_wait_threads(e);
+
+    for (uint32_t i = 0;i < e;++i) {
+        exp += my_arg[i].output->size();
+    }
+
+    travels.clear();
+    travels.reserve(exp);
+
+    //Append results in input order
+    for (uint32_t i = 0;i < e;++i) {
+        for (uint32_t j = 0,k = my_arg[i].output->size();j < k;++j) {
+            travels.push_back(my_arg[i].output->at(j));
+        }
+        delete my_arg[i].output;
+    }
+
+    delete[] my_arg;
+}
+
+/*Picks the compute_path mode : one choice for the host , every leg gets the same one (nothing per leg is looked at)*/
+static boolean_t mt_use_owner_mode() {
+    const int32_t mode = g_parameters[0].expand_mode;
+
+    if (g_thread_contexts < 2) { //Nothing to shard
+        return false;
+    } else if (mode != expand_mode_auto) {
+        return (mode == expand_mode_owner);
+    }
+
+    //Only worth it when there is cross socket traffic to save and enough airports to balance the shards
+    return (g_numa_nodes > 1) && (fi_airports() >= (g_thread_contexts << 1));
+}
+
+void mt_compute_path(const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,uint64_t t_min,uint64_t t_max) {
+    if (travels.empty()) {  //Nothing to do
+        return;
+    }
+
+    {
+        //If we visited again this sequence return its previous result..
+        permutation_sequence_t* pseq = g_global_permutations->match(to,travels);
+        if (pseq != 0) {
+            //printf("Match SEQ %lu %lu %lu\n",travels.size(),pseq->travels.size(),pseq->path.size());
+            travels = pseq->path;
+            return;
+        }
+    }
+
+    //Partial perm update : Target / Input
+    g_global_permutations->cycle(to,travels);
+
+    //Departures that can't reach to before t_max anymore are never expanded
+    const uint64_t* feasible = fi_feasible(fi_airport_id(to),t_max,g_parameters[0].max_layover_time);
+
+    if (mt_use_patterns(to,travels)) {
+        mt_compute_path_patterns(to,travels,t_min,t_max,feasible);
+    } else if (mt_use_owner_mode()) {
+        mt_compute_path_owner(to,travels,t_min,t_max,feasible);
+    } else {
+        mt_compute_path_steal(to,travels,t_min,t_max,feasible);
+    }
+
+    //Partial perm update : Output
+    g_global_permutations->cycle(travels);
+
+    //Partial perm update : Index
+    g_global_permutations->cycle();
+}
+ 
+/*
+    Depth specialized kernels : paths are a handful of flights , so the prefix test of never_traveled_to and the
+    discount + sum passes of compute_cost are instantiated for every hop count up to k_depth_kernels , unrolled at
+    compile time (flight I of an N hop path). The tables pick the kernel of a path's hop count , longer paths
+    take the generic loops. Same statements in the same order as the loops , so the results are bit identical.
+*/
+template <uint32_t I,uint32_t N>
+struct depth_kernel_c {
+    static inline bool never_visited(const flight_ref_t* flights,const flight_indice_t* path,const indexed_string_t city) {
+        return (flights[path[I]].from_hash != city) && (flights[path[I]].to_hash != city) &&
+               depth_kernel_c<I + 1,N>::never_visited(flights,path,city);
+    }
+
+    /*Pair (I - 1,I) , see apply_discount*/
+    static inline void discount(flight_ref_t* flights,const flight_indice_t* path,std::vector<std::vector<indexed_string_t> >& alliances) {
+        flight_ref_t& flight_before = flights[path[I - 1]];
+        flight_ref_t& current_flight = flights[path[I]];
+
+        if (has_just_traveled_with_company(flight_before, current_flight)) {
+            flight_before.discount = 0.7;
+            current_flight.discount = 0.7;
+        } else if (has_just_traveled_with_alliance(flight_before, current_flight, alliances)) {
+            if (flight_before.discount > 0.8) {
+                flight_before.discount = 0.8;
+            }
+            current_flight.discount = 0.8;
+        } else {
+            current_flight.discount = 1;
+        }
+
+        depth_kernel_c<I + 1,N>::discount(flights,path,alliances);
+    }
+
+    static inline f32 sum(const flight_ref_t* flights,const flight_indice_t* path,const f32 result) {
+        return depth_kernel_c<I + 1,N>::sum(flights,path,result + (flights[path[I]].cost * flights[path[I]].discount));
+    }
+};
+
+template <uint32_t N>
+struct depth_kernel_c<N,N> {
+    static inline bool never_visited(const flight_ref_t*,const flight_indice_t*,const indexed_string_t) {
+        return true;
+    }
+
+    static inline void discount(flight_ref_t*,const flight_indice_t*,std::vector<std::vector<indexed_string_t> >&) {}
+
+    static inline f32 sum(const flight_ref_t*,const flight_indice_t*,const f32 result) {
+        return result;
+    }
+};
+
+typedef bool (*visit_kernel_t)(const flight_ref_t* flights,const flight_indice_t* path,const indexed_string_t city);
+typedef f32 (*cost_kernel_t)(flight_ref_t* flights,const flight_indice_t* path,std::vector<std::vector<indexed_string_t> >& alliances);
+
+template <uint32_t N>
+static bool mt_visit_kernel(const flight_ref_t* flights,const flight_indice_t* path,const indexed_string_t city) {
+    return depth_kernel_c<0,N>::never_visited(flights,path,city);
+}
+
+template <uint32_t N>
+static f32 mt_cost_kernel(flight_ref_t* flights,const flight_indice_t* path,std::vector<std::vector<indexed_string_t> >& alliances) {
+    flights[path[0]].discount = 1;
+    depth_kernel_c<1,N>::discount(flights,path,alliances);
+    return depth_kernel_c<0,N>::sum(flights,path,0.0f);
+}
+
+static const visit_kernel_t k_visit_kernels[k_depth_kernels + 1] = {
+    mt_visit_kernel<0> , mt_visit_kernel<1> , mt_visit_kernel<2> , mt_visit_kernel<3> , mt_visit_kernel<4> ,
+    mt_visit_kernel<5> , mt_visit_kernel<6> , mt_visit_kernel<7> , mt_visit_kernel<8>
+};
+
+static const cost_kernel_t k_cost_kernels[k_depth_kernels + 1] = {
+    0 , mt_cost_kernel<1> , mt_cost_kernel<2> , mt_cost_kernel<3> , mt_cost_kernel<4> ,
+    mt_cost_kernel<5> , mt_cost_kernel<6> , mt_cost_kernel<7> , mt_cost_kernel<8>
+};
+
+/*Thread entry point functions implementation*/
+/*
+    The only difference from the original version is that string comparisons have been replaced by indexes to string list
+*/
+static inline bool never_traveled_to(flight_ref_t* p_flights,const travel_t& travel,const uint32_t range,const indexed_string_t city) {
+    register const std::vector<override_stl_allocator(flight_indice_t)>& flights = travel.flights ;
+
+    if (range <= k_depth_kernels) {
+        return k_visit_kernels[range](p_flights,&flights[0],city);
+    }
+ 
+    for(register uint32_t i = 0,j = range; i < j;++i) {
+        if ((p_flights[flights[i]].from_hash == city) || (p_flights[flights[i]].to_hash == city)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+    Bidirectional join : travel + every joinable chain of departure pos that doesn't revisit one of the travel's airports.
+    Complete chains give final travels , open ones (max_hops flights) go on with the forward search.
+*/
+static void mt_join_suffixes(expand_ctx_t& ctx,const travel_t& travel,const uint32_t pos) {
+    const suffix_table_t& table = *ctx.suffixes;
+    travel_t* next = ctx.joined;
+
+    for (uint32_t s = table.begin[pos],s_end = table.end[pos];s < s_end;++s) {
+        const suffix_node_t& chain = table.nodes[s];
+        uint64_t common = 0;
+
+        if (!bd_joinable(table,s)) {
+            continue;
+        }
+
+        for (uint32_t w = 0;w < k_visited_words;++w) {
+            common |= chain.visited[w] & travel.visited[w];
+        }
+
+        if (common != 0) {
+            continue;
+        }
+
+        *next = travel;
+        for (uint32_t w = 0;w < k_visited_words;++w) {
+            next->visited[w] |= chain.visited[w];
+        }
+
+        for (uint32_t n = s;n != k_no_suffix;n = table.nodes[n].next) {
+            const uint32_t size = (uint32_t)next->flights.size();
+            mt_cost_append(next->price,next->price,ctx.flights[next->flights.back()],ctx.flights[table.nodes[n].flight],
+                           1 == size,*ctx.alliances);
+            next->flights.push_back(table.nodes[n].flight);
+        }
+
+        if (chain.complete) {
+            ctx.final_travels->push_back(*next);
+        } else {
+            ctx.output->push_back(*next);
+        }
+    }
+}
+
+/*
+    Expands one travel with the departures [first,last) of its current airport , that is every
+    departure that takes off within (land time,land time + max layover] and after t_min.
+    D is the travel's hop count when it's known at compile time (levels 1 and 2 , where most of the candidates are) :
+    the prefix test is the unrolled depth kernel and the first pair discount test folds away. D = 0 is the generic loop.
+*/
+template <uint32_t D>
+static inline void mt_expand_travel_d(expand_ctx_t& ctx,const travel_t& travel,const uint32_t first,const uint32_t last) {
+    register flight_ref_t* flights = ctx.flights;
+    const indexed_string_t to = ctx.to;
+
+    //Save prev len
+    const uint32_t travel_size = (0 != D) ? D : travel.flights.size();
+    travel_t* next = ctx.next;
+
+    //Copy the prefix once and only rewrite its last element in the subloop...
+    *next = travel;
+    next->flights.push_back(0); 
+
+    register flight_indice_t& last_ind = next->flights[travel_size];
+    const flight_ref_t& last_flight = flights[travel.flights.back()];
+
+    //With an exact visited set the filter does the whole cycle test , 
+    //otherwise it's a bloom filter : filter on time only and walk the prefix on a hit
+    const uint64_t* visited = ctx.visited_exact ? travel.visited : k_nothing_visited;
+
+    //Bidirectional : only travels still before the split time (an open chain already crossed it) are joined
+    const boolean_t split = (ctx.suffixes != 0) && (last_flight.take_off_time < ctx.suffixes->t_mid);
+
+    //The window is cut at zone boundaries , zones that can't match are skipped whole
+    for (uint32_t base = first,end;base < last;base = end) { 
+        const uint32_t zone = base / k_departure_zone;
+        end = ((zone + 1) * k_departure_zone < last) ? (zone + 1) * k_departure_zone : last;
+
+        if (fi_zone_rejects(zone,ctx.t_max,visited)) {
+            continue;
+        }
+
+        uint64_t mask = ff_filter(ctx.departures_land + base,ctx.departures_to + base,end - base,ctx.t_max,visited) & 
+                        fi_feasible_bits(ctx.feasible,base);
+
+        for (;mask != 0;mask &= mask - 1) {
+            register const flight_ref_t& flight = flights[ctx.departures[base + __builtin_ctzll(mask)]];
+
+            if ((0 != g_prefetch_distance) && (0 != (mask & (mask - 1)))) { //Next candidate's record
+                __builtin_prefetch(&flights[ctx.departures[base + __builtin_ctzll(mask & (mask - 1))]]);
+            }
+
+            if (!ctx.visited_exact && travel.maybe_visited(flight.to_id) && 
+                !((0 != D) ? mt_visit_kernel<D>(flights,&travel.flights[0],flight.to_hash) :
+                             never_traveled_to(flights,travel,travel_size,flight.to_hash))) {
+                continue;
+            }
+
+            //Bidirectional : past the split time the rest of the path comes from the suffix table
+            if (split && (ctx.departures_take_off[base + __builtin_ctzll(mask)] >= ctx.suffixes->t_mid)) {
+                mt_join_suffixes(ctx,travel,base + __builtin_ctzll(mask));
+                continue;
+            }
+
+            //Set last element here to flight index
+            const uint32_t w = travel_t::visited_word(flight.to_id);
+            last_ind = flight.index;
+            next->visited[w] = travel.visited[w] | travel_t::visited_mask(flight.to_id);
+            mt_cost_append(next->price,travel.price,last_flight,flight,1 == travel_size,*ctx.alliances);
+
+            if (flight.to_hash == to) {
+                ctx.final_travels->push_back(*next); 
+            } else { 
+                ctx.output->push_back(*next); //Push to bucket and handle it in another pass
+            }
+
+            next->visited[w] = travel.visited[w];
+        }
+    }
+}
+
+/*Picks the expand loop of the travel's hop count*/
+static inline void mt_expand_travel(expand_ctx_t& ctx,const travel_t& travel,const uint32_t first,const uint32_t last) {
+    if (first == last) {
+        return;
+    }
+
+    switch (travel.flights.size()) {
+        case 1 : mt_expand_travel_d<1>(ctx,travel,first,last); break;
+        case 2 : mt_expand_travel_d<2>(ctx,travel,first,last); break;
+        default : mt_expand_travel_d<0>(ctx,travel,first,last); break;
+    }
+}
+
+/*
+    Expands the frontier positions [start,end) : the frontier is ordered by (airport,land time) so consecutive
+    travels read the same departure list , the window of each one is a connection graph lookup.
+*/
+static void mt_expand_sorted_range(expand_ctx_t& ctx,const std::vector<override_stl_allocator(travel_t)>& input,
+                                   const uint32_t* order,const uint32_t start,const uint32_t end) {
+    const uint32_t* positions = &g_flight_index.positions[0];
+    const uint32_t d = g_prefetch_distance;
+    uint32_t first,last;
+
+    for (register uint32_t k = start;k < end;++k) {
+        if (0 != d) {
+            mt_prefetch_gathers(&input[0],order,k,end,d,ctx.flights,true);
+        }
+
+        const travel_t& travel = input[order[k]];
+        const flight_ref_t& current_city = ctx.flights[travel.flights.back()];
+
+        if (current_city.to_hash == ctx.to) {  
+            ctx.final_travels->push_back(travel);   
+            continue;
+        }
+
+        fi_next_departures(positions[travel.flights.back()],ctx.t_min,ctx.max_layover_time,first,last);
+        mt_expand_travel(ctx,travel,first,last);
+    }
+}
+
+/*
+    Orders the frontier by (current airport,land time) : bucket by dense airport id , then sort each bucket.
+    Travels ending at the same airport read the same departure list back to back.
+*/
+static void mt_sort_frontier(const std::vector<override_stl_allocator(travel_t)>& travels,std::vector<uint32_t>& order) {
+    const uint32_t len = (uint32_t)travels.size();
+    const uint32_t airports = fi_airports();
+    std::vector<uint32_t> offset(airports + 1,0);
+    std::vector<frontier_key_t> keys(len);
+
+    for (uint32_t i = 0;i < len;++i) {
+        const flight_ref_t& f = g_flights[travels[i].flights.back()];
+        ++offset[f.to_id + 1];
+    }
+
+    for (uint32_t i = 0;i < airports;++i) {
+        offset[i + 1] += offset[i];
+    }
+
+    {
+        std::vector<uint32_t> head(offset.begin(),offset.end() - 1);
+        for (uint32_t i = 0;i < len;++i) {
+            const flight_ref_t& f = g_flights[travels[i].flights.back()];
+            frontier_key_t& key = keys[head[f.to_id]++];
+            key.land_time = f.land_time;
+            key.pos = i;
+        }
+    }
+
+    for (uint32_t i = 0;i < airports;++i) {
+        if ((offset[i + 1] - offset[i]) > 1) {
+            std::sort(keys.begin() + offset[i],keys.begin() + offset[i + 1]);
+        }
+    }
+
+    order.resize(len);
+    for (uint32_t i = 0;i < len;++i) {
+        order[i] = keys[i].pos;
+    }
+}
+
+/*Steals a chunk from any other thread of this level , false when every deque is empty*/
+static boolean_t mt_steal_chunk(uint32_t& chunk,const uint32_t self,const uint32_t thread_count) {
+    for (;;) {
+        boolean_t aborted = false;
+
+        for (uint32_t i = 1;i < thread_count;++i) {
+            const steal_result_t r = g_expand_deques[(self + i) % thread_count].steal(chunk);
+            if (r == steal_result_ok) {
+                return true;
+            }
+            aborted |= (r == steal_result_abort);
+        }
+
+        if (!aborted) {
+            return false;
+        }
+    }
+}
+
+/*  
+    The MT version of compute_path.
+    Works on fixed size chunks of the sorted frontier : pops its own chunks first and steals from the other threads when done.
+*/
+static void* mt_compute_path2_entry_point(void* in_args) {
+    compute_path2_args_t* args = (compute_path2_args_t*)in_args;
+    const std::vector<override_stl_allocator(travel_t)>* input = args->input;
+    const uint32_t len = (uint32_t)input->size();
+    const uint32_t* order = &(*args->order)[0];
+    const uint32_t self = args->thread_index;
+    chase_lev_deque_c& own = g_expand_deques[self];
+    expand_ctx_t ctx;
+    uint32_t chunk;
+
+    ctx.flights = &g_flights[args->flight_count * self];
+    ctx.departures = &g_flight_index.departures[0];
+    ctx.departures_take_off = &g_flight_index.departures_take_off[0];
+    ctx.departures_land = &g_flight_index.departures_land[0];
+    ctx.departures_to = &g_flight_index.departures_to[0];
+    ctx.feasible = args->feasible;
+    ctx.suffixes = args->suffixes;
+    ctx.visited_exact = g_flight_index.visited_exact;
+    ctx.t_min = args->t_min;
+    ctx.t_max = args->t_max;
+    ctx.max_layover_time = args->max_layover_time;
+    ctx.to = args->to;
+    ctx.output = args->output;
+    ctx.final_travels = args->final_travels;
+    ctx.next = new travel_t;
+    ctx.joined = new travel_t;
+    ctx.alliances = &g_alliances[self].alliances;
+
+    spill_state_t& spill = args->spill;
+    uint64_t output_bytes = 0;
+    uint32_t output_counted = 0,finals_counted = (uint32_t)ctx.final_travels->size();
+
+    args->busy_ns = 0;
+
+    for (;;) {
+        if (!own.pop(chunk)) {
+            if (!mt_steal_chunk(chunk,self,args->thread_count)) {
+                break;
+            }
+            ++args->steals;
+        }
+
+        const uint64_t t0 = mt_time_ns();
+        const uint32_t start = chunk * k_expand_chunk;
+        const uint32_t end = ((start + k_expand_chunk) < len) ? start + k_expand_chunk : len;
+
+        mt_expand_sorted_range(ctx,*input,order,start,end);
+
+        //Past this thread's share of the budget : what it holds goes to disk now , not after the level
+        if (spill.share > 0) {
+            for (const uint32_t size = (uint32_t)ctx.output->size();output_counted < size;++output_counted) {
+                output_bytes += mt_travel_bytes(ctx.output->at(output_counted));
+            }
+            for (const uint32_t size = (uint32_t)ctx.final_travels->size();finals_counted < size;++finals_counted) {
+                args->final_bytes += mt_travel_bytes(ctx.final_travels->at(finals_counted));
+            }
+
+            if (output_bytes > spill.share) {
+                mt_spill_tail(spill,spill.frontier,*ctx.output,0);
+                output_bytes = 0;
+                output_counted = 0;
+            }
+            if (args->final_bytes > spill.share) {
+                mt_spill_tail(spill,spill.finals,*ctx.final_travels,0);
+                args->final_bytes = 0;
+                finals_counted = 0;
+            }
+        }
+
+        args->busy_ns += mt_time_ns() - t0;
+        ++args->chunks;
+    }
+
+    delete ctx.next;
+    delete ctx.joined;
+
+    pthread_exit(NULL);
+    return NULL;
+}
+ 
+/*The MT version of merge_path*/
+
+#if 0
+    #include "asm.h"
+#endif
+
+static void* mt_merge_path_entry_point(void* in_args) {
+    merge_path_args_t* args = (merge_path_args_t*)in_args;
+    std::vector<override_stl_allocator(travel_t)>* travel1 = args->travel1;
+    const std::vector<override_stl_allocator(travel_t)>* travel2 = args->travel2;
+    const merge_leg_t& leg = *args->leg;
+    std::vector<std::vector<indexed_string_t>>& alliances = g_alliances[args->thread_index].alliances;
+    const flight_ref_t* flights = &g_flights[args->flight_count * args->thread_index];
+    const uint64_t* take_off = &leg.take_off[0];
+    const uint32_t legs2 = (uint32_t)leg.take_off.size();
+    const uint32_t d = g_prefetch_distance;
+    std::vector<uint64_t> ranks; //Bit p : travel2[p] is in the current suffix (every pair mode)
+
+    if (args->relation != k_range) {
+        ranks.assign((travel2->size() + 63) >> 6,0);
+    }
+
+    for (uint32_t start = args->start,end = args->end;start < end;++start) {
+        if (0 != d) {
+            mt_prefetch_gathers(&travel1->at(0),0,start,end,d,flights,true);
+        }
+
+        const travel_t& t1 = travel1->at(start);
+        if (t1.flights.empty()) { 
+            continue;
+        }
+
+        //First t2 taking off after t1 lands , all the later ones do too
+        const uint64_t land_time = flights[t1.flights.back()].land_time;
+        const uint32_t first = (uint32_t)(std::upper_bound(take_off,take_off + legs2,land_time) - take_off);
+        if (first == legs2) {
+            continue;
+        }
+
+        merge_range_t r;
+        r.t1 = start;
+        r.first = first;
+        r.count = legs2 - first;
+        args->ranges->push_back(r);
+
+        if (args->relation == k_range) {
+            continue;
+        }
+
+        //Every pair , in travel2 order like the full cross product gave them : the suffix goes into the rank bitmap
+        //and comes out in position order (words [lo,hi] , cleared on the way for the next t1)
+        uint32_t lo = std::numeric_limits<uint32_t>::max(),hi = 0;
+        for (uint32_t i = first;i < legs2;++i) {
+            const uint32_t p = leg.order[i];
+            ranks[p >> 6] |= 1ULL << (p & 63);
+            lo = (p < lo) ? p : lo;
+            hi = (p > hi) ? p : hi;
+        }
+
+        const travel_indice_pair_t pair = (travel_indice_pair_t)start << 32; //Encode indices to T1/T2 lists
+        for (uint32_t w = lo >> 6;w <= (hi >> 6);++w) {
+            for (uint64_t bits = ranks[w];bits != 0;bits &= bits - 1) {
+                const uint32_t p = (w << 6) + (uint32_t)__builtin_ctzll(bits);
+                args->results->push_back(pair | (travel_indice_pair_t)p);
+                args->costs->push_back(travel_cost_t());
+                mt_cost_join(args->costs->back(),t1,travel2->at(p),flights,alliances); //Only the junction changes
+            }
+            ranks[w] = 0;
+        }
+    }
+ 
+    pthread_exit(NULL);
+    return NULL;
+}
+ 
+static bool company_are_in_a_common_alliance(const indexed_string_t in_c1, 
+const indexed_string_t in_c2, std::vector<std::vector<indexed_string_t> >& alliances){
+    register const indexed_string_t c1 = in_c1,c2 = in_c2;
+    for(uint32_t i=0,k = alliances.size(); i<k;++i) {
+        uint8_t a = 0,b = 0;
+        register const std::vector<indexed_string_t>& v = alliances[i];
+        for(register uint32_t j=0,l = v.size(); j<l;++j) {
+            const indexed_string_t tmp = v[j];
+            a = (tmp == c1) ? 1 : a;
+            b = (tmp == c2) ? 1 : b;
+        }
+        if ((a + b) == 2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool has_just_traveled_with_company(const flight_ref_t& flight_before, const flight_ref_t& current_flight) {
+    return flight_before.company_hash == current_flight.company_hash;
+}
+
+static inline bool has_just_traveled_with_alliance(const flight_ref_t& flight_before, const flight_ref_t& current_flight, 
+  std::vector<std::vector<indexed_string_t> >& alliances) {
+    if (g_alliance_masks) {
+        return 0 != (current_flight.alliance_mask & flight_before.alliance_mask);
+    }
+    return company_are_in_a_common_alliance(current_flight.company_hash,flight_before.company_hash, alliances);
+}
+
+/*Discount two consecutive flights give each other (a flight gets the lower one of its two sides , see apply_discount)*/
+static inline f32 mt_pair_discount(const flight_ref_t& flight_before, const flight_ref_t& current_flight, 
+  std::vector<std::vector<indexed_string_t> >& alliances) {
+    if (has_just_traveled_with_company(flight_before, current_flight)) {
+        return 0.7f;
+    } else if (has_just_traveled_with_alliance(flight_before, current_flight, alliances)) {
+        return 0.8f;
+    }
+    return 1.0f;
+}
+
+static void apply_discount(flight_ref_t* flights,travel_t & travel, std::vector<std::vector<indexed_string_t> >&alliances){
+    const uint32_t fsize = travel.flights.size();
+    const std::vector<override_stl_allocator(flight_indice_t)>* travel_flights = &travel.flights;
+    if(fsize > 0) {
+        flights[travel.flights[0]].discount = 1;
+    }
+    if(fsize > 1) {
+        for(register uint32_t i = 1,j = fsize;i < j;++i) {
+            flight_ref_t& flight_before = flights[travel_flights->at(i-1)];
+            flight_ref_t& current_flight = flights[travel_flights->at(i)];
+            if(has_just_traveled_with_company(flight_before, current_flight)){
+                flight_before.discount = 0.7;
+                current_flight.discount = 0.7;
+                continue;
+            }else if(has_just_traveled_with_alliance(flight_before, current_flight, alliances)){
+                if(flight_before.discount > 0.8) {
+                    flight_before.discount = 0.8;
+                }
+                current_flight.discount = 0.8;
+                continue;
+            }
+            current_flight.discount = 1;
+        }
+    }
+}
+ 
+static inline f32 compute_cost(flight_ref_t* flights,travel_t & travel,std::vector<std::vector<indexed_string_t> >&alliances) {
+    const uint32_t hops = (uint32_t)travel.flights.size();
+
+    if ((hops > 0) && (hops <= k_depth_kernels)) {
+        return k_cost_kernels[hops](flights,&travel.flights[0],alliances);
+    }
+ 
+    apply_discount(flights,travel, alliances);
+    register f32 result = 0;
+    for(register uint32_t i = 0,j = travel.flights.size();i < j;++i){
+        result += (flights[travel.flights[i]].cost * flights[travel.flights[i]].discount);
+    }
+    return result;
+}
+
+/*-verify_kernels : random paths of every hop count through the depth kernels and the generic loops*/
+static boolean_t mt_verify_depth_kernels() {
+    const uint32_t rounds = 1024;
+    flight_ref_t* flights = g_flights;
+    std::vector<std::vector<indexed_string_t> >& alliances = g_alliances[0].alliances;
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    travel_t travel;
+
+    if (0 == g_flights_size) {
+        return true;
+    }
+
+    for (uint32_t r = 0;r < rounds;++r) {
+        const uint32_t hops = 1 + (r % k_depth_kernels);
+
+        travel.flights.clear();
+        for (uint32_t i = 0;i < hops;++i) {
+            seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+            travel.flights.push_back((flight_indice_t)((seed >> 33) % g_flights_size));
+        }
+
+        //Generic versions
+        apply_discount(flights,travel,alliances);
+        f32 expected = 0;
+        for (uint32_t i = 0;i < hops;++i) {
+            expected += (flights[travel.flights[i]].cost * flights[travel.flights[i]].discount);
+        }
+
+        const indexed_string_t city = flights[travel.flights[(seed >> 7) % hops]].to_hash ^ ((r & 1) ? 0 : 1);
+        boolean_t never = true;
+        for (uint32_t i = 0;i < hops;++i) {
+            never = never && (flights[travel.flights[i]].from_hash != city) && (flights[travel.flights[i]].to_hash != city);
+        }
+
+        const f32 cost = k_cost_kernels[hops](flights,&travel.flights[0],alliances);
+        const bool visit = k_visit_kernels[hops](flights,&travel.flights[0],city);
+        if ((cost != expected) || (visit != never)) {
+            printf("Depth kernel mismatch : round %u , %u hops , cost %f != %f , visit %u != %u\n",r,hops,cost,expected,
+                   (uint32_t)visit,(uint32_t)never);
+            return false;
+        }
+    }
+
+    printf("Depth kernels (1..%u hops) : %u paths verified\n",k_depth_kernels,rounds);
+    return true;
+}
+
+/*Running price of a travel with one flight*/
+static inline void mt_cost_start(travel_cost_t& price,const flight_ref_t& flight) {
+    price.fixed = 0.0f;
+    price.cost = flight.cost;
+    price.first_tier = price.last_tier = 1.0f;
+}
+
+/*
+    Running price of in + flight (last : in's last flight , first_hop : in has one flight).
+    last's discount is final now : the lower one of its two sides. out may be in.
+*/
+static inline void mt_cost_append(travel_cost_t& out,const travel_cost_t& in,const flight_ref_t& last,const flight_ref_t& flight,
+                                  const boolean_t first_hop,std::vector<std::vector<indexed_string_t> >& alliances) {
+    const f32 tier = mt_pair_discount(last,flight,alliances);
+
+    out.fixed = in.fixed + (last.cost * ((tier < in.last_tier) ? tier : in.last_tier));
+    out.cost = out.fixed + (flight.cost * tier);
+    out.first_tier = (first_hop) ? tier : in.first_tier;
+    out.last_tier = tier;
+}
+
+/*
+    Running price of a travel (price a , last flight last , hops flights) + t2 (merge_path) :
+    only the discounts of the travel's last flight and t2's first flight change
+*/
+static inline void mt_cost_join(travel_cost_t& out,const travel_cost_t& a,const flight_ref_t& last,const uint32_t hops,
+                                const travel_t& t2,const flight_ref_t* flights,std::vector<std::vector<indexed_string_t> >& alliances) {
+    const flight_ref_t& first = flights[t2.flights.front()];
+    const travel_cost_t& b = t2.price;
+    const f32 tier = mt_pair_discount(last,first,alliances);
+    const f32 head = a.fixed + (last.cost * ((tier < a.last_tier) ? tier : a.last_tier));
+
+    //t2's first flight had discount first_tier (its right side) , now the lower one of both sides
+    const f32 first_delta = first.cost * (((tier < b.first_tier) ? tier : b.first_tier) - b.first_tier);
+
+    if (1 == t2.flights.size()) {
+        out.fixed = head;
+        out.last_tier = tier;
+    } else {
+        out.fixed = head + b.fixed + first_delta;
+        out.last_tier = b.last_tier;
+    }
+
+    out.cost = head + b.cost + first_delta;
+    out.first_tier = (1 == hops) ? tier : a.first_tier;
+}
+
+static inline void mt_cost_join(travel_cost_t& out,const travel_t& t1,const travel_t& t2,const flight_ref_t* flights,
+                                std::vector<std::vector<indexed_string_t> >& alliances) {
+    mt_cost_join(out,t1.price,flights[t1.flights.back()],(uint32_t)t1.flights.size(),t2,flights,alliances);
+}
+
+static f32 mt_compose_rest(std::vector<override_stl_allocator(merge_phase_node_t)>& nodes,const uint32_t node,const uint32_t j,
+                           const uint32_t k,const flight_ref_t* flights,std::vector<std::vector<indexed_string_t> >& alliances);
+
+/*
+    Cheapest running price of a travel (price , last flight , hops) followed by the composition (node , relation)
+    of its range : every travel2 of the range , then the best of that one's range if it is composed too
+    (memoized per entry , mt_compose_rest)
+*/
+static f32 mt_compose_min(const travel_cost_t& price,const flight_indice_t last,const uint32_t hops,const uint8_t node,
+                          const travel_indice_t relation,std::vector<override_stl_allocator(merge_phase_node_t)>& nodes,
+                          const flight_ref_t* flights,std::vector<std::vector<indexed_string_t> >& alliances) {
+    const uint32_t id = node & ~k_node_ranged;
+    const merge_phase_node_t& n = nodes[id];
+    const uint32_t first = (uint32_t)(relation >> k_relation_shift);
+    const uint32_t count = (uint32_t)relation;
+    f32 best = std::numeric_limits<f32>::infinity();
+    travel_cost_t join;
+
+    for (uint32_t j = first;j < first + count;++j) {
+        const travel_t& t2 = n.b[j];
+        f32 cost;
+
+        mt_cost_join(join,price,flights[last],hops,t2,flights,alliances);
+        cost = (t2.ranged()) ? join.fixed + mt_compose_rest(nodes,id,j,mt_dp_tier_index(join.last_tier),flights,alliances) : join.cost;
+        best = (cost < best) ? cost : best;
+    }
+
+    return best;
+}
+
+/*
+    Cheapest continuation of composed entry nodes[node].b[j] : its last flight (discount k_dp_tier[k] from the one before
+    it) joined to the best chain of its range. A chain's running price through the entry is the fixed part up to that
+    last flight + this whatever came before , so it's kept per (entry , incoming tier) in the node (nodes are per thread)
+*/
+static f32 mt_compose_rest(std::vector<override_stl_allocator(merge_phase_node_t)>& nodes,const uint32_t node,const uint32_t j,
+                           const uint32_t k,const flight_ref_t* flights,std::vector<std::vector<indexed_string_t> >& alliances) {
+    const uint32_t slot = (j * k_dp_tiers) + k;
+
+    if (nodes[node].rest[slot] == k_rest_unknown) {
+        const travel_t& t = nodes[node].b[j];
+        travel_cost_t price;
+
+        price.fixed = 0.0f;
+        price.cost = 0.0f;
+        price.first_tier = 1.0f;
+        price.last_tier = k_dp_tier[k];
+        nodes[node].rest[slot] = mt_compose_min(price,t.flights.back(),2,t.node,t.relation,nodes,flights,alliances);
+    }
+
+    return nodes[node].rest[slot];
+}
+
+/*Cheapest running price of a travel list entry : its own , or the best travel of its composition (merge_path k_range)*/
+static inline f32 mt_entry_price(const travel_t& t,const flight_ref_t* flights,std::vector<override_stl_allocator(merge_phase_node_t)>* nodes,
+                                 std::vector<std::vector<indexed_string_t> >& alliances) {
+    if (!t.ranged()) {
+        return t.price.cost;
+    }
+
+    return mt_compose_min(t.price,t.flights.back(),(uint32_t)t.flights.size(),t.node,t.relation,*nodes,flights,alliances);
+}
+
+/*
+    Pass 2 of find_cheapest over w.path (its flights so far , price) : travels of the composition within the limit
+    are flattened and costed exactly. Ties go to the highest key , as if merge_path had listed every chain
+*/
+static void mt_compose_walk(compose_walk_t& w,const travel_cost_t& price,const travel_t& t) {
+    if (!t.ranged()) {
+        if (price.cost > w.limit) {
+            return;
+        }
+
+        const f32 cost = compute_cost(w.flights,w.path,*w.alliances);
+        if (!w.found || (cost < w.best_cost) || ((cost == w.best_cost) && (w.key > w.best_key))) {
+            w.found = true;
+            w.best_cost = cost;
+            w.best_key = w.key;
+            w.best = w.path;
+        }
+        return;
+    }
+
+    const uint32_t id = t.node & ~k_node_ranged;
+    const merge_phase_node_t& n = (*w.nodes)[id];
+    const uint32_t first = (uint32_t)(t.relation >> k_relation_shift);
+    const uint32_t count = (uint32_t)t.relation;
+    const uint32_t hops = (uint32_t)w.path.flights.size();
+    const flight_ref_t& last = w.flights[w.path.flights.back()];
+    travel_cost_t join;
+
+    for (uint32_t j = first;j < first + count;++j) {
+        const travel_t& t2 = n.b[j];
+
+        mt_cost_join(join,price,last,hops,t2,w.flights,*w.alliances);
+        //Cheapest chain through t2 (pass #0 memoized its continuation) , over the limit none of them is costed
+        const f32 bound = (t2.ranged()) ? join.fixed + mt_compose_rest(*w.nodes,id,j,mt_dp_tier_index(join.last_tier),w.flights,*w.alliances) :
+                                          join.cost;
+        if (bound > w.limit) {
+            continue;
+        }
+
+        w.key.push_back(n.b_order[j]);
+        w.path.flights.insert(w.path.flights.end(),t2.flights.begin(),t2.flights.end());
+        mt_compose_walk(w,join,t2);
+        w.path.flights.resize(hops);
+        w.key.pop_back();
+    }
+}
+
+/*The MT version of find_cheapest*/
+static void* mt_find_cheapest_entry_point(void* in_args) {
+    find_cheapest_args_t* args = (find_cheapest_args_t*)in_args;
+ 
+    register int64_t start = args->start;
+    register int64_t end = args->end;
+    register std::vector<override_stl_allocator(travel_t)>* travels = args->travels;
+    std::vector<std::vector<indexed_string_t>>& alliances = g_alliances[args->thread_index].alliances;
+    flight_ref_t* flights = &g_flights[args->flight_count * args->thread_index];
+    std::vector<override_stl_allocator(merge_phase_node_t)>* nodes = (g_merge_phase_relations != 0) ? &g_merge_phase_relations->at(args->thread_index).nodes : 0;
+
+    compose_walk_t* w = new compose_walk_t;
+    const uint32_t d = g_prefetch_distance;
+    f32 limit;
+
+    if (args->rebuild) { //Only the flights and the range come from the spill file
+        for (int64_t i = start;i < end;++i) {
+            if (0 != d) {
+                mt_prefetch_path_gathers(&travels->at(0),i,start,end - 1,1,d,flights,std::numeric_limits<f32>::infinity());
+            }
+            mt_spill_rebuild(travels->at(i),flights,alliances);
+        }
+    }
+
+    //Pass 1 : cheapest running price , a min over precomputed floats (and over the compositions of ranged travels)
+    end -= end > start; //Won't happen
+    limit = std::numeric_limits<f32>::infinity();
+    for (int64_t i = end;i >= start;--i) {
+        if (0 != d) { //Only composed travels gather flights here
+            mt_prefetch_path_gathers(&travels->at(0),i,start,end,-1,d,flights,-std::numeric_limits<f32>::infinity());
+        }
+
+        const f32 cost = mt_entry_price(travels->at(i),flights,nodes,alliances);
+        limit = (cost < limit) ? cost : limit;
+    }
+
+    //Pass 2 : running prices are summed in another order than compute_cost , the few travels within rounding 
+    //of the minimum are costed exactly. Ties go to the highest index as always , a composed travel counts as
+    //its chains in travel2 order (as if merge_path had listed them)
+    w->nodes = nodes;
+    w->flights = flights;
+    w->alliances = &alliances;
+    w->limit = limit + (limit * k_cost_slack);
+    w->found = false;
+    w->best_cost = 0;
+
+    const int64_t last = end;
+    while (end >= start) {
+        if (0 != d) { //compute_cost's gathers of the travels within the limit
+            mt_prefetch_path_gathers(&travels->at(0),end,start,last,-1,d,flights,w->limit);
+        }
+
+        const travel_t& t = travels->at(end);
+
+        w->key.assign(1,(uint32_t)end);
+        w->path.flights = t.flights;
+        mt_compose_walk(*w,t.price,t);
+        --end;
+    }
+
+    //Return result
+    args->best_cost = w->best_cost;
+    args->best_ind = (w->found) ? w->best_key[0] : (uint32_t)args->start;
+    if (w->found) {
+        *args->out_travel = w->best;
+    } else {
+        *args->out_travel = travels->at(args->best_ind);
+    }
+    delete w;
+ 
+    pthread_exit(NULL);
+    return NULL;
+}
+ 
+/*Appends every matching travel of tails[level..] to path (merge_path rule : next leg takes off after path lands) and costs the result*/
+static void mt_stream_join(stream_cheapest_args_t* args,flight_ref_t* flights,std::vector<std::vector<indexed_string_t>>& alliances,
+                           travel_t& path,const uint32_t level) {
+    if (level == args->tail_count) {
+        const f32 cost = compute_cost(flights,path,alliances);
+        if (!args->found || (cost < args->best_cost) || ((cost == args->best_cost) && 
+            (mt_stream_order(path,args->size,args->key,*args->best,args->best_size,args->best_key,args->tail_count) > 0))) {
+            args->found = true;
+            args->best_cost = cost;
+            *args->best = path;
+            args->best_size = args->size;
+            memcpy(args->best_key,args->key,sizeof(args->key));
+        }
+        return;
+    }
+
+    const std::vector<override_stl_allocator(travel_t)>& tail = *args->tails[level];
+    const uint64_t land_time = flights[path.flights.back()].land_time;
+    const uint32_t path_size = (uint32_t)path.flights.size();
+
+    for (uint32_t i = 0,j = (uint32_t)tail.size();i < j;++i) {
+        const travel_t& t = tail[i];
+        if (t.flights.empty() || (land_time >= flights[t.flights[0]].take_off_time)) {
+            continue;
+        }
+
+        for (uint32_t k = 0,l = (uint32_t)t.flights.size();k < l;++k) {
+            path.flights.push_back(t.flights[k]);
+        }
+
+        args->key[level] = i;
+        mt_stream_join(args,flights,alliances,path,level + 1);
+        path.flights.resize(path_size);
+    }
+}
+
+/*Streamed compute_path + merge_path + find_cheapest , starting travels are handed out one at a time*/
+static void* mt_stream_cheapest_entry_point(void* in_args) {
+    stream_cheapest_args_t* args = (stream_cheapest_args_t*)in_args;
+    flight_ref_t* flights = &g_flights[args->flight_count * args->thread_index];
+    std::vector<std::vector<indexed_string_t>>& alliances = g_alliances[args->thread_index].alliances;
+    const uint32_t roots = (uint32_t)args->roots->size();
+    std::vector<override_stl_allocator(travel_t)> batch;
+    path_generator_c generator;
+    uint32_t r;
+
+    generator.init(flights,args->to_airport,args->t_min,args->t_max,args->max_layover_time,args->feasible);
+    batch.reserve(k_stream_batch);
+
+    while ((r = args->next_root->fetch_add(1,std::memory_order_relaxed)) < roots) {
+        generator.start(args->roots->at(r));
+
+        while (generator.next(batch,k_stream_batch) > 0) {
+            for (uint32_t i = 0,j = (uint32_t)batch.size();i < j;++i) {
+                args->size = (uint32_t)batch[i].flights.size();
+                mt_stream_join(args,flights,alliances,batch[i],0);
+            }
+            batch.clear();
+        }
+    }
+
+    pthread_exit(NULL);
+    return NULL;
+}
+
+struct dag_walk_t {                                                         /*DFS state of one thread over the leg DAGs*/
+    dag_cheapest_args_t* args;
+    flight_ref_t* flights;
+    std::vector<std::vector<indexed_string_t>>* alliances;
+    travel_t path;                                                          /*Flights so far , visited airports of the current leg*/
+    uint32_t leg_start;                                                     /*First flight of the current leg in path*/
+    boolean_t greedy;                                                       /*Stop at the first complete travel (bound seed)*/
+    uint32_t budget;                                                        /*Greedy : expansions left*/
+    uint64_t expanded[k_bnb_depths],pruned[k_bnb_depths];                   /*Branch and bound counters per depth*/
+};
+
+struct dag_candidate_t {                                                    /*Greedy : next flight ordered by its lower bound*/
+    f32 bound;
+    uint32_t pos;                                                           /*Position (first leg roots : root index)*/
+
+    inline bool operator< (const dag_candidate_t& other) const {
+        return bound < other.bound;
+    }
+};
+
+static inline f32 mt_load_bound(const std::atomic<uint32_t>* bound) {
+    const uint32_t bits = bound->load(std::memory_order_relaxed);
+    f32 v;
+    memcpy(&v,&bits,sizeof(v));
+    return v;
+}
+
+/*Lowers the shared bound to cost if it's better*/
+static inline void mt_lower_bound(std::atomic<uint32_t>* bound,const f32 cost) {
+    uint32_t bits = bound->load(std::memory_order_relaxed);
+    uint32_t want;
+    memcpy(&want,&cost,sizeof(want));
+
+    for (;;) {
+        f32 cur;
+        memcpy(&cur,&bits,sizeof(cur));
+        if ((cost >= cur) || bound->compare_exchange_weak(bits,want,std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+/*Cycle test of the current leg (bloom filter past k_visited_bits airports : walk the leg on a hit)*/
+static inline boolean_t mt_dag_visited(const dag_walk_t& w,const uint32_t airport) {
+    if (!w.path.maybe_visited(airport)) {
+        return false;
+    } else if (g_flight_index.visited_exact) {
+        return true;
+    }
+
+    const flight_ref_t* flights = w.flights;
+    if (flights[w.path.flights[w.leg_start]].from_id == airport) {
+        return true;
+    }
+
+    for (uint32_t i = w.leg_start,j = (uint32_t)w.path.flights.size();i < j;++i) {
+        if (flights[w.path.flights[i]].to_id == airport) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+    Lower bound of every travel that goes on with position q (of leg) after the path ending with p.
+    fixed : cost of the path without p , p_tier : discount of p with the flight before it.
+    p's discount is final once q is known , q costs at least 0.7 x its price , min_rest covers the rest.
+*/
+static inline f32 mt_dag_bound(dag_walk_t& w,const uint32_t p,const f32 fixed,const f32 p_tier,const uint32_t leg,const uint32_t q,
+                               f32& q_fixed,f32& q_tier) {
+    flight_ref_t& fp = w.flights[g_flight_index.departures[p]];
+    flight_ref_t& fq = w.flights[g_flight_index.departures[q]];
+
+    //The price so far is kept without pruning too , the cheapest rest of later legs (dag_suffix_t) is added to it
+    q_tier = mt_pair_discount(fp,fq,*w.alliances);
+    q_fixed = fixed + (fp.cost * ((q_tier < p_tier) ? q_tier : p_tier));
+
+    if (0 == w.args->bound) { //No pruning , no bounds
+        return 0.0f;
+    }
+
+    return q_fixed + (k_min_discount * fq.cost) + w.args->dags[leg]->min_rest[q];
+}
+
+/*True if the bound rules the branch out (counted per depth)*/
+static inline boolean_t mt_dag_prune(dag_walk_t& w,const f32 bound) {
+    const uint32_t depth = ((uint32_t)w.path.flights.size() < k_bnb_depths) ? (uint32_t)w.path.flights.size() : k_bnb_depths - 1;
+
+    if (w.args->bound != 0) {
+        //Tiny slack : the bound is summed in another order than compute_cost , ties must survive (mt_dag_offer
+        //decides them on the travel order , a tie found later may still win)
+        if (bound > (mt_load_bound(w.args->bound) * (1.0f + k_bnb_slack))) {
+            ++w.pruned[depth];
+            return true;
+        }
+    }
+
+    ++w.expanded[depth];
+    return false;
+}
+
+/*A complete travel is in w.path : kept if it's the cheapest so far , equal prices go to the highest travel order*/
+static void mt_dag_offer(dag_walk_t& w) {
+    dag_cheapest_args_t* args = w.args;
+    const f32 cost = compute_cost(w.flights,w.path,*w.alliances);
+
+    if (!args->found || (cost < args->best_cost) ||
+        ((cost == args->best_cost) && (mt_dag_order(w.path,*args->best,args->dags,args->leg_count) > 0))) {
+        args->found = true;
+        args->best_cost = cost;
+        *args->best = w.path;
+    }
+    if (args->bound != 0) {
+        mt_lower_bound(args->bound,cost);
+    }
+}
+
+/*
+    Appends the rests of root n of leg (the root gets tier k) to w.path and completes the travels. estimate : price of
+    the travel with the cheapest rest , the others are within k_cost_slack of it and may tie once costed exactly.
+*/
+static void mt_dag_join_chain(dag_walk_t& w,const uint32_t leg,const uint32_t n,const uint32_t k,const f32 estimate) {
+    const dag_suffix_t& d = w.args->suffixes[leg][n];
+    const uint32_t size = (uint32_t)w.path.flights.size();
+
+    for (uint32_t i = 0,j = (uint32_t)d.rests[k].size();i < j;++i) {
+        const dag_rest_t& rest = d.rests[k][i];
+        const f32 price = estimate + (rest.cost - d.cost[k]);
+
+        if (w.args->found && (price > (w.args->best_cost * (1.0f + k_cost_slack)))) {
+            continue;
+        }
+
+        w.path.flights.insert(w.path.flights.end(),rest.flights.begin(),rest.flights.end());
+        if (k_dp_no_state == rest.next) {
+            mt_dag_offer(w);
+        } else {
+            mt_dag_join_chain(w,leg + 1,rest.next,rest.next_tier,price);
+        }
+        w.path.flights.resize(size);
+    }
+}
+
+/*
+    The path ends leg with position p (price without p fixed , p's tier from the flight before it) : joins it with
+    every root of the next leg that takes off after p lands and that root's cheapest rests , the price of each join is
+    known without walking the later legs again. Joins that can beat or tie the best are completed and costed exactly.
+*/
+static boolean_t mt_dag_join_rest(dag_walk_t& w,const uint32_t leg,const uint32_t p,const f32 fixed,const f32 p_tier) {
+    const path_dag_t& next = *w.args->dags[leg + 1];
+    const std::vector<dag_suffix_t>& rest = w.args->suffixes[leg + 1];
+    const flight_ref_t& fp = w.flights[g_flight_index.departures[p]];
+    const f32 none = std::numeric_limits<f32>::infinity();
+    boolean_t found = false;
+
+    for (uint32_t r = pd_first_root_after(next,g_flight_index.departures_land[p]),e = (uint32_t)next.roots.size();r < e;++r) {
+        const f32 t = mt_pair_discount(fp,w.flights[g_flight_index.departures[next.roots[r]]],*w.alliances);
+        const uint32_t k = mt_dp_tier_index(t);
+
+        if (none == rest[r].cost[k]) {
+            continue;
+        }
+
+        const f32 estimate = fixed + (fp.cost * ((t < p_tier) ? t : p_tier)) + rest[r].cost[k];
+        if (mt_dag_prune(w,estimate) || (w.args->found && (estimate > (w.args->best_cost * (1.0f + k_cost_slack))))) {
+            continue;
+        }
+
+        mt_dag_join_chain(w,leg + 1,r,k,estimate);
+        found = true;
+    }
+
+    return found;
+}
+
+/*Position p (price so far fixed , discount with the previous flight p_tier) was just appended to the path as part of leg*/
+static boolean_t mt_dag_walk(dag_walk_t& w,const uint32_t leg,const uint32_t p,const f32 fixed,const f32 p_tier) {
+    const path_dag_t& dag = *w.args->dags[leg];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    std::vector<dag_candidate_t> candidates;                                //Greedy only
+
+    if (w.greedy) {
+        if (0 == w.budget) {
+            return true;
+        }
+        --w.budget;
+    }
+
+    if (arrival[p] == dag.to) {
+        if ((leg + 1) == w.args->leg_count) { //Complete travel
+            mt_dag_offer(w);
+            return true;
+        }
+
+        //Next leg : every root that takes off after we land , with its cheapest rest (mt_dag_suffixes)
+        return mt_dag_join_rest(w,leg,p,fixed,p_tier);
+    }
+
+    const uint32_t e_first = dag.offset[p];
+    const uint32_t e_count = dag.offset[p + 1] - e_first;
+
+    if (w.greedy) { //Cheapest bound first
+        for (uint32_t i = 0;i < e_count;++i) {
+            dag_candidate_t c;
+            f32 q_fixed,q_tier;
+            c.pos = dag.edges[e_first + i];
+            c.bound = mt_dag_bound(w,p,fixed,p_tier,leg,c.pos,q_fixed,q_tier);
+            candidates.push_back(c);
+        }
+        std::sort(candidates.begin(),candidates.end());
+    }
+
+    for (uint32_t i = 0;i < e_count;++i) {
+        const uint32_t q = (w.greedy) ? candidates[i].pos : dag.edges[e_first + i];
+        const uint32_t a = arrival[q];
+        f32 q_fixed,q_tier;
+
+        if (mt_dag_visited(w,a) || mt_dag_prune(w,mt_dag_bound(w,p,fixed,p_tier,leg,q,q_fixed,q_tier))) {
+            continue;
+        }
+
+        const uint32_t word = travel_t::visited_word(a);
+        const uint64_t saved = w.path.visited[word];
+        boolean_t done;
+
+        w.path.visited[word] |= travel_t::visited_mask(a);
+        w.path.flights.push_back(g_flight_index.departures[q]);
+        done = mt_dag_walk(w,leg,q,q_fixed,q_tier) && w.greedy;
+        w.path.flights.pop_back();
+        w.path.visited[word] = saved;
+
+        if (done) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*Starts the walk at root r of the first leg*/
+static boolean_t mt_dag_walk_root(dag_walk_t& w,const uint32_t r) {
+    const uint32_t p = w.args->dags[0]->roots[r];
+    const flight_ref_t& f = w.flights[g_flight_index.departures[p]];
+
+    if ((w.args->bound != 0) && mt_dag_prune(w,(k_min_discount * f.cost) + w.args->dags[0]->min_rest[p])) {
+        return false;
+    }
+
+    w.path.flights.clear();
+    for (uint32_t i = 0;i < k_visited_words;++i) {
+        w.path.visited[i] = 0;
+    }
+    w.path.visit(f.from_id);
+    w.path.visit(f.to_id);
+    w.path.flights.push_back(f.index);
+    w.leg_start = 0;
+    return mt_dag_walk(w,0,p,0.0f,1.0f);
+}
+
+static void mt_dag_walk_init(dag_walk_t& w,dag_cheapest_args_t* args) {
+    w.args = args;
+    w.flights = &g_flights[args->flight_count * args->thread_index];
+    w.alliances = &g_alliances[args->thread_index].alliances;
+    w.leg_start = 0;
+    w.greedy = false;
+    w.budget = 0;
+    for (uint32_t i = 0;i < k_bnb_depths;++i) {
+        w.expanded[i] = w.pruned[i] = 0;
+    }
+}
+
+/*
+    mt_dag_suffixes : the path out.flights[..] of the current leg starts with root and ends with an arrival at the
+    destination , root gets min(k_dp_tier[k],root_tier) and tail is the price of everything after root.
+*/
+static inline void mt_dag_suffix_offer(const dag_walk_t& w,dag_suffix_t& out,const f32 root_cost,const f32 root_tier,const f32 tail,
+                                       const uint32_t next,const uint32_t next_tier) {
+    for (uint32_t k = 0;k < k_dp_tiers;++k) {
+        const f32 total = (root_cost * ((k_dp_tier[k] < root_tier) ? k_dp_tier[k] : root_tier)) + tail;
+        std::vector<dag_rest_t>& rests = out.rests[k];
+
+        if (total > (out.cost[k] + (out.cost[k] * k_cost_slack))) {
+            continue;
+        }
+
+        if (total < out.cost[k]) { //Rests out of the slack of the new cheapest one are dropped
+            const f32 limit = total + (total * k_cost_slack);
+            uint32_t kept = 0;
+
+            out.cost[k] = total;
+            for (uint32_t i = 0,j = (uint32_t)rests.size();i < j;++i) {
+                if (rests[i].cost <= limit) {
+                    rests[kept++].swap(rests[i]);
+                }
+            }
+            rests.resize(kept);
+        }
+
+        rests.push_back(dag_rest_t());
+        rests.back().cost = total;
+        rests.back().next = next;
+        rests.back().next_tier = next_tier;
+        rests.back().flights.assign(w.path.flights.begin(),w.path.flights.end());
+    }
+}
+
+/*
+    mt_dag_suffixes : every path of the leg from root (the path so far ends with p). rest : price of the flights
+    between root and p , p_tier : p's tier from the flight before it , root_tier : root's tier from the second flight.
+    The no-revisit rule only spans a leg , so what follows a leg's last flight is the next leg's table , never walked again.
+*/
+static void mt_dag_suffix_walk(dag_walk_t& w,dag_suffix_t& out,const uint32_t root,const uint32_t p,const f32 rest,
+                               const f32 p_tier,const f32 root_tier) {
+    const uint32_t leg = w.args->leg;
+    const path_dag_t& dag = *w.args->dags[leg];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    const flight_ref_t& fp = w.flights[g_flight_index.departures[p]];
+    const f32 root_cost = w.flights[g_flight_index.departures[root]].cost;
+
+    if (arrival[p] == dag.to) {
+        if ((leg + 1) == w.args->leg_count) { //Last flight of the travel
+            if (p == root) {
+                mt_dag_suffix_offer(w,out,root_cost,1.0f,0.0f,k_dp_no_state,0);
+            } else {
+                mt_dag_suffix_offer(w,out,root_cost,root_tier,rest + (fp.cost * p_tier),k_dp_no_state,0);
             }
+            return;
         }
 
-        //Wait for threads to finish their task 
-        mt_wait_threads(e);
-
+        const path_dag_t& next = *w.args->dags[leg + 1];
+        const std::vector<dag_suffix_t>& next_rest = w.args->suffixes[leg + 1];
 
-        //Sum up wanted size and allocate it
-        exp = 0;
-        for (uint32_t i = 0; i < e;++i) {
-            exp += my_arg[i].output->size();
-        }
+        for (uint32_t r = pd_first_root_after(next,g_flight_index.departures_land[p]),e = (uint32_t)next.roots.size();r < e;++r) {
+            const f32 t = mt_pair_discount(fp,w.flights[g_flight_index.departures[next.roots[r]]],*w.alliances);
+            const uint32_t k = mt_dp_tier_index(t);
+            const f32 tail = next_rest[r].cost[k];
 
-        travels.clear();
-        travels.reserve(exp);
+            if (std::numeric_limits<f32>::infinity() == tail) {
+                continue;
+            }
 
-        //Append results  
-        exp = 0;
-        for (uint32_t i = 0; i < e;++i) {
-            const uint32_t output_len = my_arg[i].output->size();
-            for (uint32_t j = 0;j < output_len;++j) {
-                travels.push_back(my_arg[i].output->at(j));
+            if (p == root) {
+                mt_dag_suffix_offer(w,out,root_cost,t,tail,r,k);
+            } else {
+                mt_dag_suffix_offer(w,out,root_cost,root_tier,rest + (fp.cost * ((t < p_tier) ? t : p_tier)) + tail,r,k);
             }
-            my_arg[i].output->clear();
         }
+        return;
     }
 
-    //Cleanup
-    for (uint32_t i = 0;i < e;++i) {
-        delete my_arg[i].output;
-        delete my_arg[i].input;
- 
-    }
- 
-    //Sum up wanted size and allocate it
-    exp = 0;
-    for (uint32_t i = 0; i < e;++i) {
-        exp += my_arg[i].final_travels->size();
-    }
+    for (uint32_t e = dag.offset[p],e_end = dag.offset[p + 1];e < e_end;++e) {
+        const uint32_t q = dag.edges[e];
+        const uint32_t a = arrival[q];
 
-    travels.clear();
-    travels.reserve(exp);
+        if (mt_dag_visited(w,a)) {
+            continue;
+        }
 
-    //Append results  
-    exp = 0;
-    for (uint32_t i = 0; i < e;++i) {
-        const uint32_t output_len = my_arg[i].final_travels->size();
-        for (uint32_t j = 0;j < output_len;++j) {
-            travels.push_back(my_arg[i].final_travels->at(j));
+        const uint32_t word = travel_t::visited_word(a);
+        const uint64_t saved = w.path.visited[word];
+        const f32 t = mt_pair_discount(fp,w.flights[g_flight_index.departures[q]],*w.alliances);
+
+        w.path.visited[word] |= travel_t::visited_mask(a);
+        w.path.flights.push_back(g_flight_index.departures[q]);
+        if (p == root) {
+            mt_dag_suffix_walk(w,out,root,q,0.0f,t,t);
+        } else {
+            mt_dag_suffix_walk(w,out,root,q,rest + (fp.cost * ((t < p_tier) ? t : p_tier)),t,root_tier);
+        }
+        w.path.flights.pop_back();
+        w.path.visited[word] = saved;
+    }
+}
+
+/*mt_dag_suffixes : threads take the roots of leg args->leg one at a time*/
+static void* mt_dag_suffix_entry_point(void* in_args) {
+    dag_cheapest_args_t* args = (dag_cheapest_args_t*)in_args;
+    const path_dag_t& dag = *args->dags[args->leg];
+    std::vector<dag_suffix_t>& table = args->suffixes[args->leg];
+    const uint32_t roots = (uint32_t)dag.roots.size();
+    dag_walk_t* w = new dag_walk_t;
+    uint32_t r;
+
+    mt_dag_walk_init(*w,args);
+
+    while ((r = args->next_root->fetch_add(1,std::memory_order_relaxed)) < roots) {
+        const uint32_t p = dag.roots[r];
+        const flight_ref_t& f = w->flights[g_flight_index.departures[p]];
+        dag_suffix_t& out = table[r];
+
+        for (uint32_t k = 0;k < k_dp_tiers;++k) {
+            out.cost[k] = std::numeric_limits<f32>::infinity();
+            out.rests[k].clear();
         }
 
-        delete my_arg[i].final_travels; 
+        w->path.flights.clear();
+        for (uint32_t i = 0;i < k_visited_words;++i) {
+            w->path.visited[i] = 0;
+        }
+        w->path.visit(f.from_id);
+        w->path.visit(f.to_id);
+        w->path.flights.push_back(f.index);
+        mt_dag_suffix_walk(*w,out,p,p,0.0f,1.0f,1.0f);
     }
 
-    //if (0 != optimized_paths) {
-        //printf("Optimization pass was successful! Total optimized paths %u \n",optimized_paths);
-   // }
+    delete w;
+    pthread_exit(NULL);
+    return NULL;
+}
 
-    //Partial perm update : Output
-    g_global_permutations->cycle(travels);
+/*
+    Cheapest rest of the travel from every root of the legs after the first one , per discount the root gets from the
+    flight before it (same idea as the suffix minima of lj_build) : last leg first , each one reads the next one's table.
+    The first leg's paths then cost one lookup per root of the second leg instead of walking all the later legs.
+*/
+static void mt_dag_suffixes(std::vector<dag_suffix_t>* suffixes,path_dag_t* const* dags,const uint32_t leg_count) {
+    const uint32_t thread_count = g_thread_contexts;
+    std::atomic<uint32_t> next_root(0);
+    dag_cheapest_args_t* my_arg;
 
-    //Partial perm update : Index
-    g_global_permutations->cycle();
+    my_arg = new dag_cheapest_args_t[thread_count];
+    assert(my_arg != 0);
+
+    for (uint32_t leg = leg_count;leg-- > 1;) {
+        suffixes[leg].resize(dags[leg]->roots.size());
+        next_root.store(0);
+
+        for (uint32_t i = 0;i < thread_count;++i) {
+            my_arg[i].thread_index = i;
+            my_arg[i].flight_count = g_flights_size;
+            my_arg[i].dags = dags;
+            my_arg[i].leg_count = leg_count;
+            my_arg[i].suffixes = suffixes;
+            my_arg[i].leg = leg;
+            my_arg[i].next_root = &next_root;
+            my_arg[i].bound = 0;
+            if (pthread_create(&g_thread_context[i],NULL,mt_dag_suffix_entry_point,(void*)&my_arg[i]) != 0) {
+                printf("pthread_create failed!\n"); 
+                assert(0);
+            }
+        }
+
+        mt_wait_threads(thread_count);
+    }
 
     delete[] my_arg;
 }
- 
- 
-/*Thread entry point functions implementation*/
+
 /*
-    The only difference from the original version is that string comparisons have been replaced by indexes to string list
+    Seeds the shared bound : depth first , cheapest lower bound first , stops at the first complete travel
+    (or after k_bnb_greedy_budget expansions). Runs on the main thread with thread 0's data.
 */
-static inline bool never_traveled_to(flight_ref_t* p_flights,const travel_t& travel,const uint32_t range,const indexed_string_t city) {
-    register const std::vector<override_stl_allocator(flight_indice_t)>& flights = travel.flights ;
- 
-    for(register uint32_t i = 0,j = range; i < j;++i) {
-        if ((p_flights[flights[i]].from_hash == city) || (p_flights[flights[i]].to_hash == city)) {
-            return false;
+static void mt_dag_greedy(dag_cheapest_args_t* args) {
+    const path_dag_t& first = *args->dags[0];
+    std::vector<dag_candidate_t> roots;
+    dag_walk_t* w = new dag_walk_t;
+
+    mt_dag_walk_init(*w,args);
+    w->greedy = true;
+    w->budget = k_bnb_greedy_budget;
+
+    for (uint32_t r = 0,e = (uint32_t)first.roots.size();r < e;++r) {
+        dag_candidate_t c;
+        c.bound = (k_min_discount * w->flights[g_flight_index.departures[first.roots[r]]].cost) + first.min_rest[first.roots[r]];
+        c.pos = r;
+        roots.push_back(c);
+    }
+    std::sort(roots.begin(),roots.end());
+
+    for (uint32_t i = 0,j = (uint32_t)roots.size();(i < j) && (w->budget > 0);++i) {
+        if (mt_dag_walk_root(*w,roots[i].pos)) {
+            break;
         }
     }
 
-    return true;
+    delete w;
 }
 
-/*  
-    The MT version of compute_path.
-*/
-static void* mt_compute_path2_entry_point(void* in_args) {
-    compute_path2_args_t* args = (compute_path2_args_t*)in_args;
+/*Best first : w.path ends with position q of leg (price without q fixed , q's tier). Completes the travel or queues it*/
+static void mt_best_first_child(dag_walk_t& w,best_first_item_t& scratch,const uint32_t leg,const uint32_t q,
+                                const f32 fixed,const f32 tier,const f32 bound,uint32_t& rng) {
+    dag_cheapest_args_t* args = w.args;
+
+    if ((g_flight_index.departures_to[q] == args->dags[leg]->to) && ((leg + 1) == args->leg_count)) { //Complete travel
+        mt_dag_offer(w);
+        return;
+    }
+
+    if (mt_dag_prune(w,bound)) {
+        return;
+    }
 
-    const uint64_t t_min = args->t_min;
-    const uint64_t t_max = args->t_max;
-    const uint64_t max_layover_time = args->max_layover_time;
-    const indexed_string_t to = args->to;
-    std::vector<override_stl_allocator(travel_t)>* final_travels = args->final_travels;
-    std::vector<override_stl_allocator(travel_t)>* input = args->input;
-    std::vector<override_stl_allocator(travel_t)>* output = args->output;
+    scratch.path = w.path;
+    scratch.fixed = fixed;
+    scratch.tier = tier;
+    scratch.leg = leg;
+    scratch.pos = q;
+    scratch.leg_start = w.leg_start;
+    args->queue->push(bound,scratch,rng);
+}
 
-    register flight_ref_t* flights = &g_flights[args->flight_count * args->thread_index];
-        
- 
+/*Best first : every way to go on from item (same moves as mt_dag_walk)*/
+static void mt_best_first_expand(dag_walk_t& w,best_first_item_t& item,best_first_item_t& scratch,uint32_t& rng) {
+    const uint32_t p = item.pos;
+    const uint32_t leg = item.leg;
+    const path_dag_t& dag = *w.args->dags[leg];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+
+    w.path.swap(item.path);
+    w.leg_start = item.leg_start;
+
+    if (arrival[p] == dag.to) { //Next leg : new visited set , roots that take off after we land
+        const path_dag_t& next = *w.args->dags[leg + 1];
+
+        w.leg_start = (uint32_t)w.path.flights.size();
+        for (uint32_t r = pd_first_root_after(next,g_flight_index.departures_land[p]),e = (uint32_t)next.roots.size();r < e;++r) {
+            const uint32_t q = next.roots[r];
+            const flight_ref_t& f = w.flights[g_flight_index.departures[q]];
+            f32 q_fixed,q_tier;
+            const f32 bound = mt_dag_bound(w,p,item.fixed,item.tier,leg + 1,q,q_fixed,q_tier);
+
+            for (uint32_t k = 0;k < k_visited_words;++k) {
+                w.path.visited[k] = 0;
+            }
+            w.path.visit(f.from_id);
+            w.path.visit(f.to_id);
+            w.path.flights.push_back(f.index);
+            mt_best_first_child(w,scratch,leg + 1,q,q_fixed,q_tier,bound,rng);
+            w.path.flights.pop_back();
+        }
+        return;
+    }
 
-    for (register int64_t k = (int64_t)args->end2-1,m = args->start2;k >= m;--k) { 
-        register travel_t& travel = input->at(k);
-        register const flight_ref_t& current_city = flights[travel.flights.back()];
+    for (uint32_t e = dag.offset[p],e_end = dag.offset[p + 1];e < e_end;++e) {
+        const uint32_t q = dag.edges[e];
+        const uint32_t a = arrival[q];
 
-        if (current_city.to_hash == to) {  
-            final_travels->push_back(travel);   
+        if (mt_dag_visited(w,a)) {
             continue;
         }
 
-        //Save prev len
-        const uint32_t travel_size = travel.flights.size();
+        const uint32_t word = travel_t::visited_word(a);
+        const uint64_t saved = w.path.visited[word];
+        f32 q_fixed,q_tier;
+        const f32 bound = mt_dag_bound(w,p,item.fixed,item.tier,leg,q,q_fixed,q_tier);
 
-        //Expand list a bit to write to that element in subloop...
-        travel.flights.push_back(0); 
+        w.path.visited[word] |= travel_t::visited_mask(a);
+        w.path.flights.push_back(g_flight_index.departures[q]);
+        mt_best_first_child(w,scratch,leg,q,q_fixed,q_tier,bound,rng);
+        w.path.flights.pop_back();
+        w.path.visited[word] = saved;
+    }
+}
 
-        register flight_indice_t& last_ind = travel.flights[travel_size];
+/*Best first : the first leg's roots go in the queue (main thread , thread 0's data)*/
+static void mt_best_first_roots(dag_cheapest_args_t* args) {
+    const path_dag_t& first = *args->dags[0];
+    dag_walk_t* w = new dag_walk_t;
+    best_first_item_t* scratch = new best_first_item_t;
+    uint32_t rng = 0x9e3779b9;
 
-        for (register uint32_t i = args->start,j = args->end;i < j;++i) { // 1 fraction of the flight list
-            register const flight_ref_t& flight = flights[i];
- 
-            if ((flight.from_hash == current_city.to_hash) &&  (flight.take_off_time >= t_min) && 
-                (flight.land_time <= t_max) && 
-                (flight.take_off_time > current_city.land_time) && 
-                ((flight.take_off_time - current_city.land_time) <= max_layover_time) &&  
-                never_traveled_to(flights,travel,travel_size,flight.to_hash)   ) {
- 
-                //Set last element here to flight index
-                last_ind = flight.index;
+    mt_dag_walk_init(*w,args);
 
-                if (flight.to_hash == to) {
-                    final_travels->push_back(travel); 
-                } else { 
-                    output->push_back(travel); //Push to bucket and handle it in another pass
-                }
-            } 
+    for (uint32_t r = 0,e = (uint32_t)first.roots.size();r < e;++r) {
+        const uint32_t p = first.roots[r];
+        const flight_ref_t& f = w->flights[g_flight_index.departures[p]];
+
+        w->path.flights.clear();
+        for (uint32_t i = 0;i < k_visited_words;++i) {
+            w->path.visited[i] = 0;
         }
+        w->path.visit(f.from_id);
+        w->path.visit(f.to_id);
+        w->path.flights.push_back(f.index);
+        w->leg_start = 0;
+        mt_best_first_child(*w,*scratch,0,p,0.0f,1.0f,(k_min_discount * f.cost) + first.min_rest[p],rng);
+    }
 
-        //Restore contents...
-        travel.flights.pop_back();
+    for (uint32_t i = 0;i < k_bnb_depths;++i) {
+        args->expanded[i] += w->expanded[i];
+        args->pruned[i] += w->pruned[i];
     }
-     
-    //final_travels->shrink_to_fit();
 
-    pthread_exit(NULL);
-    return NULL;
+    delete scratch;
+    delete w;
 }
- 
-/*The MT version of fill travel*/
-static void* mt_fill_travel_entry_point(void* in_args) {
-    fill_travel_args_t* args = (fill_travel_args_t*)in_args;
-    uint32_t fcount = args->flight_count;
-    register flight_ref_t* flights = &g_flights[fcount * args->thread_index];
-    register uint32_t start = args->start;
-    register uint32_t end = args->end;
-    register const uint64_t t_min = args->t_min;
-    register const uint64_t t_max = args->t_max;
-    std::vector<override_stl_allocator(travel_t)>* results = args->results;
-    const indexed_string_t starting_point = args->starting_point;
-    travel_t* t = new travel_t;
-
-    #define fetch(f) {\
-        if( (f.from_hash == starting_point) && (f.take_off_time >= t_min) && (f.land_time <= t_max) ){\
-            t->flights[0] = f.index;\
-            results->push_back(*t);\
-        }\
-    }
-
-    t->flights.push_back(0);
-    results->reserve((fcount >> 8) + 2);
-
-    //Handle blocks of 16 first and give hints to the compiler and cpu's hw prefetcher...
-    while ((start + 16) <= end) {
-        const flight_ref_t& f0 = flights[start + 0];
-        const flight_ref_t& f1 = flights[start + 1];
-        const flight_ref_t& f2 = flights[start + 2];
-        const flight_ref_t& f3 = flights[start + 3];
-        const flight_ref_t& f4 = flights[start + 4];
-        const flight_ref_t& f5 = flights[start + 5];
-        const flight_ref_t& f6 = flights[start + 6];
-        const flight_ref_t& f7 = flights[start + 7];
-        const flight_ref_t& f8 = flights[start + 8];
-        const flight_ref_t& f9 = flights[start + 9];
-        const flight_ref_t& f10 = flights[start + 10];
-        const flight_ref_t& f11 = flights[start + 11];
-        const flight_ref_t& f12 = flights[start + 12];
-        const flight_ref_t& f13 = flights[start + 13];
-        const flight_ref_t& f14 = flights[start + 14];
-        const flight_ref_t& f15 = flights[start + 15];
-
-        fetch(f0);
-        fetch(f1);
-        fetch(f2);
-        fetch(f3);
-        fetch(f4);
-        fetch(f5);
-        fetch(f6);
-        fetch(f7);
-        fetch(f8);
-        fetch(f9);
-        fetch(f10);
-        fetch(f11);
-        fetch(f12);
-        fetch(f13);
-        fetch(f14);
-        fetch(f15);
-
-        start += 16;
-    }
-
-    //Handle remainder
-    while (start < end) {
-        const flight_ref_t& f = flights[start++];
-        fetch(f);
-    }
-    #undef fetch
-
-    delete t;
+
+/*Best first worker : pop , drop if beaten , expand. Quits once the queue is empty and nobody can refill it*/
+static void* mt_best_first_entry_point(void* in_args) {
+    dag_cheapest_args_t* args = (dag_cheapest_args_t*)in_args;
+    dag_walk_t* w = new dag_walk_t;
+    best_first_item_t* item = new best_first_item_t;
+    best_first_item_t* scratch = new best_first_item_t;
+    uint32_t rng = 0x9e3779b9 ^ ((args->thread_index + 1) * 0x85ebca6b);
+    f32 key;
+
+    mt_dag_walk_init(*w,args);
+
+    for (;;) {
+        args->active->fetch_add(1); //Before the pop : an empty queue with active == 0 means done
+        if (args->queue->pop(*item,key,rng)) {
+            ++args->popped;
+            if (key > (mt_load_bound(args->bound) * (1.0f + k_bnb_slack))) {
+                ++args->stale;
+            } else {
+                mt_best_first_expand(*w,*item,*scratch,rng);
+            }
+            args->active->fetch_sub(1);
+            continue;
+        }
+        args->active->fetch_sub(1);
+
+        if ((0 == args->active->load()) && (0 == args->queue->size())) {
+            break;
+        }
+        sched_yield();
+    }
+
+    for (uint32_t i = 0;i < k_bnb_depths;++i) {
+        args->expanded[i] += w->expanded[i];
+        args->pruned[i] += w->pruned[i];
+    }
+
+    delete scratch;
+    delete item;
+    delete w;
 
     pthread_exit(NULL);
     return NULL;
 }
 
-/*The MT version of merge_path*/
+/*find_cheapest over leg DAGs , roots of the first leg are handed out one at a time*/
+static void* mt_dag_cheapest_entry_point(void* in_args) {
+    dag_cheapest_args_t* args = (dag_cheapest_args_t*)in_args;
+    const uint32_t roots = (uint32_t)args->dags[0]->roots.size();
+    dag_walk_t* w = new dag_walk_t;
+    uint32_t r;
 
-#if 0
-    #include "asm.h"
-#endif
+    mt_dag_walk_init(*w,args);
 
-static void* mt_merge_path_entry_point(void* in_args) {
-    merge_path_args_t* args = (merge_path_args_t*)in_args;
-    register std::vector<override_stl_allocator(travel_t)>* travel1 = args->travel1;
-    register std::vector<override_stl_allocator(travel_t)>* travel2 = args->travel2;
-    register std::vector<override_stl_allocator(travel_indice_pair_t)>* results = args->results;
-    register uint32_t start = args->start;
-    register const uint32_t end = args->end;
-    register flight_ref_t* flights = &g_flights[args->flight_count * args->thread_index];
+    while ((r = args->next_root->fetch_add(1,std::memory_order_relaxed)) < roots) {
+        mt_dag_walk_root(*w,r);
+    }
 
-    for (;start < end;++start) {
-        const travel_t& t1 = travel1->at(start);
-        if (t1.flights.empty()) { 
-            continue;
-        }
+    for (uint32_t i = 0;i < k_bnb_depths;++i) {
+        args->expanded[i] = w->expanded[i];
+        args->pruned[i] = w->pruned[i];
+    }
 
-        const flight_ref_t& last_flight_t1 = flights[t1.flights.back()];
+    delete w;
 
-        //Encode indices to T1/T2 lists
-        travel_indice_pair_t pair = (travel_indice_pair_t)start << 32;
+    pthread_exit(NULL);
+    return NULL;
+}
 
-        for (register uint32_t j = args->start2,m = args->end2;j < m;++j) {
-            const travel_t& t2 = travel2->at(j);
-            if (t2.flights.empty()) {
-                continue;
-            }
-            const flight_ref_t& first_flight_t2 = flights[t2.flights[0]];
-    
-            if (last_flight_t1.land_time < first_flight_t2.take_off_time) {
-                results->push_back(pair | (travel_indice_pair_t)j);
-            }
-        }
-    
-        //printf("%u %u\n",added,args->end2);
+/*Swaps contents in src with dst*/
+static void* mt_copy_travel_entry_point(void* in_args) {
+    copy_travel_args_t* args = (copy_travel_args_t*)in_args;
+    register uint32_t start = args->start,end = args->end,base = args->base;
+    register std::vector<override_stl_allocator(travel_t)>* src = args->src;
+    register std::vector<override_stl_allocator(travel_t)>* dst = args->dst;
+
+    for (;start < end;++start) {
+        dst->at(base + start)  = src->at(start);
     }
- 
-     //printf("%lu %lu\n",((results->size()+1)*sizeof(uint64_t))/(1024*1024),((results->capacity()+1)*sizeof(uint64_t))/(1024*1024));
-    //results->shrink_to_fit();
- 
+
     pthread_exit(NULL);
     return NULL;
 }
- 
-static bool company_are_in_a_common_alliance(const indexed_string_t in_c1, 
-const indexed_string_t in_c2, std::vector<std::vector<indexed_string_t> >& alliances){
-    register const indexed_string_t c1 = in_c1,c2 = in_c2;
-    for(uint32_t i=0,k = alliances.size(); i<k;++i) {
-        uint8_t a = 0,b = 0;
-        register const std::vector<indexed_string_t>& v = alliances[i];
-        for(register uint32_t j=0,l = v.size(); j<l;++j) {
-            const indexed_string_t tmp = v[j];
-            a = (tmp == c1) ? 1 : a;
-            b = (tmp == c2) ? 1 : b;
+
+static void* mt_pattern_build_entry_point(void* in_args) {
+    pattern_build_args_t* args = (pattern_build_args_t*)in_args;
+    const uint32_t airports = (uint32_t)g_transfer_patterns.state.size();
+
+    for (uint32_t origin = args->next->fetch_add(1);origin < airports;origin = args->next->fetch_add(1)) {
+        if (g_transfer_patterns.state[origin] != pattern_state_missing) {
+            continue;
         }
-        if ((a + b) == 2) {
-            return true;
+
+        pattern_trie_t& trie = g_transfer_patterns.tries[origin];
+        const boolean_t complete = tp_build(trie,origin,args->max_layover_time,k_pattern_max_nodes);
+
+        pthread_mutex_lock(args->lock);
+        if (!args->io_failed && !tp_append(args->file,trie)) {
+            args->io_failed = true;
         }
+        pthread_mutex_unlock(args->lock);
+
+        g_transfer_patterns.state[origin] = (uint8_t)((complete) ? pattern_state_ready : pattern_state_skipped);
+        ++args->built;
+        args->skipped += (complete) ? 0 : 1;
     }
-    return false;
-}
 
-static inline bool has_just_traveled_with_company(flight_ref_t& flight_before, flight_ref_t& current_flight) {
-    return flight_before.company_hash == current_flight.company_hash;
+    pthread_exit(NULL);
+    return NULL;
 }
 
-static inline bool has_just_traveled_with_alliance(flight_ref_t& flight_before, flight_ref_t& current_flight, 
-  std::vector<std::vector<indexed_string_t> >& alliances) {
-    return company_are_in_a_common_alliance(current_flight.company_hash,flight_before.company_hash, alliances);
-}
+/*Depth first walk of travel (ending at trie node) , appends every completion at the destination to output*/
+static void mt_pattern_walk(pattern_path_args_t* args,const flight_ref_t* flights,std::vector<std::vector<indexed_string_t> >& alliances,
+                            travel_t& travel,const uint32_t node) {
+    const flight_ref_t& last = flights[travel.flights.back()];
+    const pattern_trie_t& trie = *args->trie;
+    const uint64_t* land = &g_flight_index.departures_land[0];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    const flight_indice_t* departures = &g_flight_index.departures[0];
+    const uint32_t size = (uint32_t)travel.flights.size();
+    const travel_cost_t price = travel.price;
+    uint32_t first,last_pos;
+
+    fi_next_departures(g_flight_index.positions[travel.flights.back()],args->t_min,args->max_layover_time,first,last_pos);
+
+    for (uint32_t p = first;p < last_pos;++p) {
+        if ((land[p] > args->t_max) || (0 == (fi_feasible_bits(args->feasible,p) & 1))) {
+            continue;
+        }
 
-static void apply_discount(flight_ref_t* flights,travel_t & travel, std::vector<std::vector<indexed_string_t> >&alliances){
-    const uint32_t fsize = travel.flights.size();
-    const std::vector<override_stl_allocator(flight_indice_t)>* travel_flights = &travel.flights;
-    if(fsize > 0) {
-        flights[travel.flights[0]].discount = 1;
-    }
-    if(fsize > 1) {
-        for(register uint32_t i = 1,j = fsize;i < j;++i) {
-            flight_ref_t& flight_before = flights[travel_flights->at(i-1)];
-            flight_ref_t& current_flight = flights[travel_flights->at(i)];
-            if(has_just_traveled_with_company(flight_before, current_flight)){
-                flight_before.discount = 0.7;
-                current_flight.discount = 0.7;
-                continue;
-            }else if(has_just_traveled_with_alliance(flight_before, current_flight, alliances)){
-                if(flight_before.discount > 0.8) {
-                    flight_before.discount = 0.8;
-                }
-                current_flight.discount = 0.8;
-                continue;
-            }
-            current_flight.discount = 1;
+        //The trie never repeats an airport , no visited test needed
+        const uint32_t c = tp_child(trie,node,g_transfer_patterns.airport[arrival[p]]);
+        if ((k_pattern_none == c) || !tp_reaches(trie,c,args->to_pattern)) {
+            continue;
         }
-    }
-}
- 
-static inline f32 compute_cost(flight_ref_t* flights,travel_t & travel,std::vector<std::vector<indexed_string_t> >&alliances) {
- 
-    apply_discount(flights,travel, alliances);
-    register f32 result = 0;
-    for(register uint32_t i = 0,j = travel.flights.size();i < j;++i){
-        result += (flights[travel.flights[i]].cost * flights[travel.flights[i]].discount);
-    }
-    return result;
-}
 
-/*Joins two nodes that relate to each other...*/
-static void join_nodes(travel_t& out,const travel_t& in,const uint32_t thread_index) {
-    if (in.relation == k_invalid_relation) {
-        out = in;
-        return;
-    } else {
-        const uint32_t a0 = (uint32_t)(in.relation >> k_relation_shift);
-        const uint32_t a1 = (uint32_t)(in.relation);
-        const travel_t& t1 = g_merge_phase_relations->at(thread_index).nodes[in.node].a[a0];
-        const travel_t& t2 = g_merge_phase_relations->at(thread_index).nodes[in.node].b[a1];
+        const flight_ref_t& flight = flights[departures[p]];
+        const uint32_t w = travel_t::visited_word(flight.to_id);
+        const uint64_t saved = travel.visited[w];
 
-        const uint32_t tsize = t1.flights.size();
-        const uint32_t hsize = t2.flights.size();
-       // printf("(N%u) t %u(%lu) h %u(%lu)\n",in.node,tsize,g_merge_phase_relations->at(thread_index).nodes[in.node].a.size(),
-       // hsize,g_merge_phase_relations->at(thread_index).nodes[in.node].b.size());
-        out.flights.clear();
-        out.flights.reserve(tsize + hsize);
-        out.relation = in.relation;
-        out.node = in.node;
+        travel.flights.push_back(flight.index);
+        travel.visited[w] |= travel_t::visited_mask(flight.to_id);
+        mt_cost_append(travel.price,price,last,flight,1 == size,alliances);
 
-        for (uint32_t i = 0;i < tsize;++i) {    
-            out.flights.push_back(t1.flights[i]);
+        if (flight.to_id == args->to_airport) {
+            args->output->push_back(travel);
+        } else {
+            mt_pattern_walk(args,flights,alliances,travel,c);
         }
 
-        for (uint32_t i = 0;i < hsize;++i) {    
-            out.flights.push_back(t2.flights[i]);
-        }
+        travel.visited[w] = saved;
+        travel.flights.pop_back();
+        travel.price = price;
     }
 }
 
-/*The MT version of find_cheapest*/
-static void* mt_find_cheapest_entry_point(void* in_args) {
-    find_cheapest_args_t* args = (find_cheapest_args_t*)in_args;
- 
-    register int64_t start = args->start;
-    register int64_t end = args->end;
-    register f32 best_cost,curr_cost;
-    register uint32_t best_ind;
-    register std::vector<override_stl_allocator(travel_t)>* travels = args->travels;
-    std::vector<std::vector<indexed_string_t>>& alliances = g_alliances[args->thread_index].alliances;
-    flight_ref_t* flights = &g_flights[args->flight_count * args->thread_index];
-
-    travel_t* tmp = new travel_t;
-
-    //Get initial cost
-    end -= end > start; //Won't happen
-    best_ind = (uint32_t)end--;
-
-    join_nodes(*tmp,travels->at(best_ind),args->thread_index);
-    best_cost = compute_cost(flights,*tmp,alliances);
+static void* mt_pattern_path_entry_point(void* in_args) {
+    pattern_path_args_t* args = (pattern_path_args_t*)in_args;
+    const flight_ref_t* flights = &g_flights[g_flights_size * args->thread_index];
+    std::vector<std::vector<indexed_string_t> >& alliances = g_alliances[args->thread_index].alliances;
+    travel_t travel;
 
-    while (end >= start) {
+    for (uint32_t i = args->start;i < args->end;++i) {
+        const travel_t& root = args->input->at(i);
+        const uint32_t a = flights[root.flights[0]].to_id;
 
-        //Get current cost
-        join_nodes(*tmp,travels->at(end),args->thread_index);
-        curr_cost = compute_cost(flights,*tmp,alliances);
+        if (a == args->to_airport) {
+            args->output->push_back(root);
+            continue;
+        }
 
-        //Keep track of new records
-        if (curr_cost < best_cost) {
-            best_ind = (uint32_t)end;
-            best_cost = curr_cost;
+        const uint32_t c = tp_child(*args->trie,0,g_transfer_patterns.airport[a]);
+        if ((k_pattern_none == c) || !tp_reaches(*args->trie,c,args->to_pattern)) {
+            continue;
         }
 
-        --end;
+        travel = root;
+        mt_pattern_walk(args,flights,alliances,travel,c);
     }
 
-    //Return result
-    args->best_cost = best_cost;
-    args->best_ind = best_ind;
-
-    join_nodes(*tmp,travels->at(best_ind),args->thread_index);
-    *args->out_travel = *tmp;
-    delete tmp;
- 
     pthread_exit(NULL);
     return NULL;
 }
- 
-/*Swaps contents in src with dst*/
-static void* mt_copy_travel_entry_point(void* in_args) {
-    copy_travel_args_t* args = (copy_travel_args_t*)in_args;
-    register uint32_t start = args->start,end = args->end,base = args->base;
-    register std::vector<override_stl_allocator(travel_t)>* src = args->src;
-    register std::vector<override_stl_allocator(travel_t)>* dst = args->dst;
 
-    for (;start < end;++start) {
-        dst->at(base + start)  = src->at(start);
+static void* mt_connect_entry_point(void* in_args) {
+    connect_args_t* args = (connect_args_t*)in_args;
+    const uint32_t airports = fi_airports();
+
+    for (uint32_t a = args->next->fetch_add(1);a < airports;a = args->next->fetch_add(1)) {
+        fi_connect(a);
+
+        for (uint32_t i = g_flight_index.inbound_offset[a],j = g_flight_index.inbound_offset[a + 1];i < j;++i) {
+            const uint32_t p = g_flight_index.inbound[i];
+            args->connections += g_flight_index.next_end[p] - g_flight_index.next_begin[p];
+        }
     }
 
     pthread_exit(NULL);
     return NULL;
 }
-
-
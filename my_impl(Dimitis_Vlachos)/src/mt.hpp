@@ -10,26 +10,31 @@
 
 boolean_t mt_init(const Parameters& params);
 boolean_t mt_set_work_data(std::vector<flight_ref_t>& flights_ref,
-                 const std::vector<std::vector<indexed_string_t>>& alliances);
+                 const std::vector<std::vector<indexed_string_t>>& alliances,std::vector<flight_ref_t>& schedule);
 //boolean_t mt_ss_match(uint32_t& result_offset,std::vector<std::string>& children,const std::string& look_for);
 void mt_get_flights(flight_ref_t*& ptr,uint32_t& size);
 void mt_compute_path(const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,uint64_t t_min,uint64_t t_max);
 void mt_fill_travel(std::vector<override_stl_allocator(travel_t)>& travels,const indexed_string_t starting_point, uint64_t t_min, uint64_t t_max);
 void mt_merge_path(std::vector<override_stl_allocator(travel_t)>& travel1,std::vector<override_stl_allocator(travel_t)>& travel2,
-    const travel_indice_t relation,const travel_indice_t node);
-void mt_find_cheapest(travel_t& result,std::vector<override_stl_allocator(travel_t)>& travels,
+    const travel_indice_t relation,const boolean_t spill);
+struct path_dag_t;
+void mt_build_path_dag(path_dag_t& dag,const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,uint64_t t_min,uint64_t t_max);
+boolean_t mt_dag_cheapest(travel_t& result,f32& cost,path_dag_t* const* dags,const uint32_t leg_count);
+boolean_t mt_stream_cheapest(travel_t& result,f32& cost,const indexed_string_t to,std::vector<override_stl_allocator(travel_t)>& travels,
+                             uint64_t t_min,uint64_t t_max,const std::vector<override_stl_allocator(travel_t)>* const* tails,const uint32_t tail_count);
+boolean_t mt_join_cheapest(travel_t& result,f32& cost,std::vector<override_stl_allocator(travel_t)>* const* legs,const uint32_t leg_count);
+boolean_t mt_find_cheapest(travel_t& result,f32& cost,std::vector<override_stl_allocator(travel_t)>& travels,
                     std::vector<std::vector<indexed_string_t> >&alliances);
 void mt_shutdown();
 void mt_copy_travel(std::vector<override_stl_allocator(travel_t)>* dst,std::vector<override_stl_allocator(travel_t)>* src,const uint32_t dst_base,const uint32_t len);
 
-void mt_merge_phase_link_node(const std::vector<override_stl_allocator(travel_t)>& a,
-                                   const std::vector<override_stl_allocator(travel_t)>& b,
-                                   const travel_indice_t node);
 void mt_init_merge_phase_relations();
 void mt_shutdown_merge_phase_relations();
 
+struct merge_leg_t;
 void mt_merge_path_impl(std::vector<override_stl_allocator(travel_t)>& travel1,
                                 std::vector<override_stl_allocator(travel_t)>& travel2,
+                                const merge_leg_t& leg,
                                 std::vector<override_stl_allocator(travel_t)>& results,
                                 const uint32_t travel1_start,
                                 const uint32_t travel1_end,
@@ -0,0 +1,170 @@
+#ifndef _multi_queue_hpp_
+#define _multi_queue_hpp_
+/*
+    Concurrent relaxed priority queue (MultiQueue , Rihani et al. 2015).
+    c x threads binary min heaps , each behind its own lock. push() goes to a random heap , pop() looks at the tops of
+    two random heaps and takes the smaller one , so pops are close to the global minimum without a shared hot spot.
+    Heaps hold (key,slot) pairs , elements sit in per heap slots and are swapped in/out (T::swap) so their buffers
+    are recycled instead of copied.
+*/
+#include "types.hpp"
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+extern "C" {
+    #include <pthread.h>
+}
+
+template <typename T>
+class multi_queue_c {
+    private:
+    struct entry_t {
+        f32 key;
+        uint32_t slot;
+
+        inline bool operator< (const entry_t& other) const {        /*Min heap*/
+            return key > other.key;
+        }
+    };
+
+    struct heap_t {
+        pthread_mutex_t lock;
+        std::atomic<uint32_t> top;                                  /*Key of the top as f32 bits (+infinity : empty)*/
+        std::vector<entry_t> entries;
+        std::vector<T> slots;
+        std::vector<uint32_t> free_slots;
+        uint8_t pad[64];                                            /*Keep neighbouring locks off the same line*/
+
+        heap_t() {
+            pthread_mutex_init(&lock,NULL);
+        }
+        ~heap_t() {
+            pthread_mutex_destroy(&lock);
+        }
+    };
+
+    heap_t* m_heaps;
+    uint32_t m_count;
+    std::atomic<uint64_t> m_size;                                   /*Elements in all heaps*/
+
+    multi_queue_c(const multi_queue_c&);
+    multi_queue_c& operator= (const multi_queue_c&);
+
+    static inline uint32_t key_bits(const f32 key) {
+        uint32_t bits;
+        memcpy(&bits,&key,sizeof(bits));
+        return bits;
+    }
+
+    static inline f32 bits_key(const uint32_t bits) {
+        f32 key;
+        memcpy(&key,&bits,sizeof(key));
+        return key;
+    }
+
+    static inline uint32_t next_random(uint32_t& rng) {             /*xorshift32 , rng != 0*/
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    }
+
+    inline void update_top(heap_t& h) {
+        h.top.store(key_bits((h.entries.empty()) ? std::numeric_limits<f32>::infinity() : h.entries.front().key),
+                    std::memory_order_relaxed);
+    }
+
+    public:
+    multi_queue_c() : m_heaps(0) , m_count(0) , m_size(0) {}
+    ~multi_queue_c() { shutdown(); }
+
+    /*Not thread safe*/
+    void init(const uint32_t heap_count) {
+        shutdown();
+        m_count = (heap_count > 0) ? heap_count : 1;
+        m_heaps = new heap_t[m_count];
+        assert(m_heaps != 0);
+        for (uint32_t i = 0;i < m_count;++i) {
+            update_top(m_heaps[i]);
+        }
+        m_size.store(0);
+    }
+
+    void shutdown() {
+        delete[] m_heaps;
+        m_heaps = 0;
+        m_count = 0;
+    }
+
+    /*Elements in the queue (exact once every thread is done)*/
+    inline uint64_t size() const {
+        return m_size.load();
+    }
+
+    /*x is swapped into the queue (x gets a recycled element back)*/
+    void push(const f32 key,T& x,uint32_t& rng) {
+        heap_t& h = m_heaps[next_random(rng) % m_count];
+        entry_t e;
+
+        m_size.fetch_add(1);
+        pthread_mutex_lock(&h.lock);
+
+        if (h.free_slots.empty()) {
+            e.slot = (uint32_t)h.slots.size();
+            h.slots.push_back(T());
+        } else {
+            e.slot = h.free_slots.back();
+            h.free_slots.pop_back();
+        }
+
+        e.key = key;
+        h.slots[e.slot].swap(x);
+        h.entries.push_back(e);
+        std::push_heap(h.entries.begin(),h.entries.end());
+        update_top(h);
+
+        pthread_mutex_unlock(&h.lock);
+    }
+
+    /*Smaller top of two random heaps into x , false if every heap looked empty*/
+    boolean_t pop(T& x,f32& key,uint32_t& rng) {
+        for (uint32_t attempt = 0;m_size.load() > 0;++attempt) {
+            uint32_t i = next_random(rng) % m_count;
+            const uint32_t j = next_random(rng) % m_count;
+
+            if (bits_key(m_heaps[j].top.load(std::memory_order_relaxed)) < bits_key(m_heaps[i].top.load(std::memory_order_relaxed))) {
+                i = j;
+            }
+
+            if (attempt >= (m_count << 1)) { //Unlucky draws , sweep for anything left
+                i = attempt % m_count;
+            }
+
+            heap_t& h = m_heaps[i];
+            pthread_mutex_lock(&h.lock);
+
+            if (h.entries.empty()) {
+                pthread_mutex_unlock(&h.lock);
+                continue;
+            }
+
+            std::pop_heap(h.entries.begin(),h.entries.end());
+            const entry_t e = h.entries.back();
+            h.entries.pop_back();
+            key = e.key;
+            x.swap(h.slots[e.slot]);
+            h.free_slots.push_back(e.slot);
+            update_top(h);
+
+            pthread_mutex_unlock(&h.lock);
+            m_size.fetch_sub(1);
+            return true;
+        }
+
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*
+    path_dag module : The path set of a leg as a DAG of flights
+*/
+
+#include "path_dag.hpp"
+
+struct root_sort_t {                                                        /*Orders positions by (take off time,position)*/
+    inline bool operator() (const uint32_t a,const uint32_t b) const {
+        const uint64_t ta = g_flight_index.departures_take_off[a];
+        const uint64_t tb = g_flight_index.departures_take_off[b];
+        return (ta != tb) ? (ta < tb) : (a < b);
+    }
+};
+
+void pd_clear(path_dag_t& dag) {
+    dag.roots.clear();
+    dag.offset.clear();
+    dag.edges.clear();
+    dag.nodes = 0;
+    dag.member.clear();
+    dag.min_rest.clear();
+    dag.root_rest.clear();
+}
+
+/*
+    Two passes over the departure index : mark what's reachable from the roots , 
+    then lay the successors of the marked positions out in position order (CSR)
+*/
+void pd_build(path_dag_t& dag,const std::vector<override_stl_allocator(travel_t)>& travels,const uint32_t to,
+              const uint64_t t_min,const uint64_t t_max,const uint64_t max_layover_time,const uint64_t* feasible) {
+    const uint32_t flights_size = (uint32_t)g_flight_index.departures.size();
+    const uint64_t* land = &g_flight_index.departures_land[0];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    std::vector<uint8_t> reached(flights_size,0);
+    std::vector<uint32_t> stack;
+
+    pd_clear(dag);
+    dag.to = to;
+
+    for (uint32_t i = 0,j = (uint32_t)travels.size();i < j;++i) {
+        assert(travels[i].flights.size() == 1);
+        const uint32_t p = g_flight_index.positions[travels[i].flights[0]];
+        if ((land[p] <= t_max) && (fi_feasible_bits(feasible,p) & 1)) {
+            dag.roots.push_back(p);
+            if (!reached[p]) {
+                reached[p] = 1;
+                stack.push_back(p);
+            }
+        }
+    }
+
+    //fill_travel output comes from one departure list so it's sorted already , but don't rely on it
+    std::sort(dag.roots.begin(),dag.roots.end(),root_sort_t());
+
+    //Pass 1 : reachable positions
+    while (!stack.empty()) {
+        const uint32_t p = stack.back();
+        stack.pop_back();
+
+        if (arrival[p] == to) { //Travels end at their first arrival to the destination
+            continue;
+        }
+
+        uint32_t first,last;
+        fi_next_departures(p,t_min,max_layover_time,first,last);
+
+        for (uint32_t q = first;q < last;++q) {
+            if ((land[q] <= t_max) && (fi_feasible_bits(feasible,q) & 1) && !reached[q]) {
+                reached[q] = 1;
+                stack.push_back(q);
+            }
+        }
+    }
+
+    //Pass 2 : CSR
+    dag.offset.assign(flights_size + 1,0);
+    for (uint32_t p = 0;p < flights_size;++p) {
+        dag.offset[p] = (uint32_t)dag.edges.size();
+
+        if (!reached[p]) {
+            continue;
+        }
+
+        ++dag.nodes;
+        if (arrival[p] == to) {
+            continue;
+        }
+
+        uint32_t first,last;
+        fi_next_departures(p,t_min,max_layover_time,first,last);
+
+        for (uint32_t q = first;q < last;++q) {
+            if ((land[q] <= t_max) && (fi_feasible_bits(feasible,q) & 1)) {
+                dag.edges.push_back(q);
+            }
+        }
+    }
+    dag.offset[flights_size] = (uint32_t)dag.edges.size();
+    dag.member.swap(reached);
+}
+
+/*
+    Successors take off after their predecessor lands , so a reverse take off sweep sees them first.
+    Flights that land before they take off break that order : then every bound is 0 (nothing gets pruned).
+*/
+void pd_bound(path_dag_t& dag,const f32* cost,const path_dag_t* next) {
+    const uint32_t flights_size = (uint32_t)g_flight_index.departures.size();
+    const uint64_t* take_off = &g_flight_index.departures_take_off[0];
+    const uint64_t* land = &g_flight_index.departures_land[0];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    const f32 none = std::numeric_limits<f32>::infinity();
+
+    dag.min_rest.assign(flights_size,none);
+    dag.root_rest.assign(dag.roots.size() + 1,none);
+
+    for (uint32_t p = 0;p < flights_size;++p) {
+        if (dag.member[p] && (land[p] < take_off[p])) {
+            dag.min_rest.assign(flights_size,0.0f);
+            dag.root_rest.assign(dag.roots.size() + 1,0.0f);
+            return;
+        }
+    }
+
+    for (uint32_t i = flights_size;i-- > 0;) {
+        const uint32_t p = g_flight_index.by_take_off[i];
+
+        if (!dag.member[p]) {
+            continue;
+        }
+
+        f32 best = none;
+        if (arrival[p] == dag.to) {
+            if (0 == next) {
+                best = 0.0f;
+            } else {
+                best = next->root_rest[pd_first_root_after(*next,land[p])];
+            }
+        } else {
+            for (uint32_t e = dag.offset[p],e_end = dag.offset[p + 1];e < e_end;++e) {
+                const uint32_t q = dag.edges[e];
+                const f32 v = (k_min_discount * cost[q]) + dag.min_rest[q];
+                best = (v < best) ? v : best;
+            }
+        }
+        dag.min_rest[p] = best;
+    }
+
+    for (uint32_t r = (uint32_t)dag.roots.size();r-- > 0;) {
+        const uint32_t p = dag.roots[r];
+        const f32 v = (k_min_discount * cost[p]) + dag.min_rest[p];
+        dag.root_rest[r] = (v < dag.root_rest[r + 1]) ? v : dag.root_rest[r + 1];
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef _path_dag_hpp_
+#define _path_dag_hpp_
+/*
+    path_dag module : The path set of a leg as a DAG of flights
+    Nodes are departure positions (flight_index) , an edge p -> q means q may follow p in compute_path
+    (takes off within max layover after p lands , lands by t_max , can still reach the destination).
+    Every simple path from a root to a flight arriving at the destination is one travel of the leg :
+    the no-revisit rule is applied by whoever walks the DAG , so the DAG never grows past flights + connections.
+*/
+#include "flight_index.hpp"
+
+static const f32 k_min_discount = 0.7f;            /*Best discount a flight can get (same company on both sides)*/
+
+struct path_dag_t {
+    uint32_t to;                                    /*Dense id of destination*/
+    std::vector<uint32_t> roots;                    /*Positions of the first flights , sorted by take off time*/
+    std::vector<uint32_t> offset;                   /*Successors of position p : edges [offset[p],offset[p+1])*/
+    std::vector<uint32_t> edges;                    /*Successor positions , sorted by take off time*/
+    uint32_t nodes;                                 /*Positions reachable from the roots*/
+    std::vector<uint8_t> member;                    /*member[p] : p is one of the nodes*/
+    std::vector<f32> min_rest;                      /*pd_bound : lower bound of what follows node p (this leg + later legs)*/
+    std::vector<f32> root_rest;                     /*pd_bound : lower bound of a travel from roots [r,..] on (suffix minima)*/
+};
+
+/*travels : fill_travel output (one flight each)*/
+void pd_build(path_dag_t& dag,const std::vector<override_stl_allocator(travel_t)>& travels,const uint32_t to,
+              const uint64_t t_min,const uint64_t t_max,const uint64_t max_layover_time,const uint64_t* feasible);
+void pd_clear(path_dag_t& dag);
+
+/*
+    Branch and bound lower bounds : a flight costs at least k_min_discount x its price whatever its neighbours.
+    cost : price of every position , next : DAG of the next leg (0 for the last one , bounds already computed).
+    Nodes that can't end a travel get +infinity.
+*/
+void pd_bound(path_dag_t& dag,const f32* cost,const path_dag_t* next);
+
+/*First root that takes off after t (merge_path rule)*/
+static inline uint32_t pd_first_root_after(const path_dag_t& dag,const uint64_t t) {
+    uint32_t lo = 0,hi = (uint32_t)dag.roots.size();
+
+    while (lo < hi) {
+        const uint32_t mid = (lo + hi) >> 1;
+        if (g_flight_index.departures_take_off[dag.roots[mid]] > t) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return lo;
+}
+
+#endif
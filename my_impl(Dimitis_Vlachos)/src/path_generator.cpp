@@ -0,0 +1,111 @@
+/*
+    path_generator module : Lazy depth first version of compute_path
+*/
+
+#include "path_generator.hpp"
+
+void path_generator_c::init(const flight_ref_t* flights,const uint32_t to,const uint64_t t_min,const uint64_t t_max,
+                            const uint64_t max_layover_time,const uint64_t* feasible) {
+    m_flights = flights;
+    m_to = to;
+    m_t_min = t_min;
+    m_t_max = t_max;
+    m_max_layover_time = max_layover_time;
+    m_feasible = feasible;
+    m_visited_exact = g_flight_index.visited_exact;
+    m_stack.clear();
+    m_root_pending = false;
+}
+
+/*Departure window of a hop that took departure pos*/
+void path_generator_c::push_frame(const uint32_t pos,const uint32_t word,const uint64_t saved) {
+    frame_t f;
+
+    fi_next_departures(pos,m_t_min,m_max_layover_time,f.cursor,f.last);
+    f.visited_word = word;
+    f.visited_saved = saved;
+    m_stack.push_back(f);
+}
+
+/*Cycle test , the visited set is a bloom filter past k_visited_bits airports : then walk the path on a hit*/
+boolean_t path_generator_c::visited(const uint32_t airport) const {
+    if (!m_path.maybe_visited(airport)) {
+        return false;
+    } else if (m_visited_exact) {
+        return true;
+    }
+
+    if (m_flights[m_path.flights[0]].from_id == airport) {
+        return true;
+    }
+
+    for (uint32_t i = 0,j = (uint32_t)m_path.flights.size();i < j;++i) {
+        if (m_flights[m_path.flights[i]].to_id == airport) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void path_generator_c::start(const travel_t& travel) {
+    const flight_ref_t& last = m_flights[travel.flights.back()];
+
+    m_path = travel;
+    m_stack.clear();
+    m_root_pending = (last.to_id == m_to);
+
+    if (!m_root_pending) {
+        push_frame(g_flight_index.positions[travel.flights.back()],0,m_path.visited[0]);
+    }
+}
+
+uint32_t path_generator_c::next(std::vector<override_stl_allocator(travel_t)>& batch,const uint32_t max) {
+    const uint64_t* land = &g_flight_index.departures_land[0];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    const flight_indice_t* departures = &g_flight_index.departures[0];
+    uint32_t count = 0;
+
+    if (m_root_pending && (max > 0)) {
+        m_root_pending = false;
+        batch.push_back(m_path);
+        ++count;
+    }
+
+    while (!m_stack.empty() && (count < max)) {
+        frame_t& f = m_stack.back();
+
+        if (f.cursor == f.last) { //This hop is exhausted : drop it from the path (the first frame is the starting travel's)
+            if (m_stack.size() > 1) {
+                m_path.visited[f.visited_word] = f.visited_saved;
+                m_path.flights.pop_back();
+            }
+            m_stack.pop_back();
+            continue;
+        }
+
+        const uint32_t p = f.cursor++;
+        const uint32_t a = arrival[p];
+
+        if ((land[p] > m_t_max) || (0 == (fi_feasible_bits(m_feasible,p) & 1)) || visited(a)) {
+            continue;
+        }
+
+        const uint32_t w = travel_t::visited_word(a);
+        const uint64_t saved = m_path.visited[w];
+
+        m_path.flights.push_back(departures[p]);
+        m_path.visited[w] |= travel_t::visited_mask(a);
+
+        if (a == m_to) { //Done , the path stops at its first arrival to the destination
+            batch.push_back(m_path);
+            ++count;
+            m_path.visited[w] = saved;
+            m_path.flights.pop_back();
+        } else {
+            push_frame(p,w,saved); //(f is invalid from here)
+        }
+    }
+
+    return count;
+}
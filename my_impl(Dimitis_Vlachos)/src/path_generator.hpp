@@ -0,0 +1,46 @@
+#ifndef _path_generator_hpp_
+#define _path_generator_hpp_
+/*
+    path_generator module : Lazy depth first version of compute_path
+    Enumerates the same paths as mt_compute_path for one starting travel , but one at a time with an explicit stack ,
+    so memory is the current path + one departure window cursor per hop whatever the number of results.
+*/
+#include "flight_index.hpp"
+
+class path_generator_c {
+    private:
+    struct frame_t {                                /*One hop of the current path*/
+        uint32_t cursor,last;                       /*Departures [cursor,last) still to try from this hop's airport*/
+        uint32_t visited_word;                      /*travel_t::visited word this hop changed ...*/
+        uint64_t visited_saved;                     /*... and its value before*/
+    };
+
+    const flight_ref_t* m_flights;
+    const uint64_t* m_feasible;                     /*fi_feasible profile of the leg*/
+    uint32_t m_to;                                  /*Dense id of destination*/
+    uint64_t m_t_min,m_t_max,m_max_layover_time;
+    boolean_t m_visited_exact;
+
+    travel_t m_path;                                /*Current path (starting travel + hops)*/
+    std::vector<frame_t> m_stack;
+    boolean_t m_root_pending;                       /*Starting travel is already at the destination*/
+
+    void push_frame(const uint32_t pos,const uint32_t word,const uint64_t saved);
+    boolean_t visited(const uint32_t airport) const;
+
+    public:
+    path_generator_c() : m_flights(0) , m_feasible(0) , m_to(k_invalid_airport) , m_t_min(0) , m_t_max(0) ,
+                         m_max_layover_time(0) , m_visited_exact(false) , m_root_pending(false) {}
+    ~path_generator_c() {}
+
+    void init(const flight_ref_t* flights,const uint32_t to,const uint64_t t_min,const uint64_t t_max,
+              const uint64_t max_layover_time,const uint64_t* feasible);
+
+    /*Restarts the enumeration from travel*/
+    void start(const travel_t& travel);
+
+    /*Appends up to max completed paths to batch , returns how many (0 : done)*/
+    uint32_t next(std::vector<override_stl_allocator(travel_t)>& batch,const uint32_t max);
+};
+
+#endif
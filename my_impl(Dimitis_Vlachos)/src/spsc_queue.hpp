@@ -0,0 +1,73 @@
+#ifndef _spsc_queue_hpp_
+#define _spsc_queue_hpp_
+/*
+    Bounded single producer / single consumer ring (Lamport queue).
+    Slots are reused , pop() swaps the slot into the destination (T::swap) so the element's buffers are recycled.
+*/
+#include "types.hpp"
+#include <atomic>
+
+template <typename T>
+class spsc_queue_c {
+    private:
+    std::atomic<uint32_t> m_head;                                             /*Next slot to pop (consumer)*/
+    uint8_t m_pad0[64 - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> m_tail;                                             /*Next slot to push (producer)*/
+    uint8_t m_pad1[64 - sizeof(std::atomic<uint32_t>)];
+    T* m_buffer;
+    uint32_t m_mask;
+
+    spsc_queue_c(const spsc_queue_c&);
+    spsc_queue_c& operator= (const spsc_queue_c&);
+
+    public:
+    spsc_queue_c() : m_head(0) , m_tail(0) , m_buffer(0) , m_mask(0) {}
+    ~spsc_queue_c() { shutdown(); }
+
+    /*Not thread safe. capacity is rounded up to a power of 2*/
+    void init(const uint32_t capacity) {
+        uint32_t len = 1;
+        while (len < capacity) {
+            len <<= 1;
+        }
+
+        shutdown();
+        m_buffer = new T[len];
+        assert(m_buffer != 0);
+        m_mask = len - 1;
+        m_head.store(0,std::memory_order_relaxed);
+        m_tail.store(0,std::memory_order_relaxed);
+    }
+
+    void shutdown() {
+        delete[] m_buffer;
+        m_buffer = 0;
+        m_mask = 0;
+    }
+
+    /*Producer only , false when full*/
+    inline boolean_t push(const T& x) {
+        const uint32_t t = m_tail.load(std::memory_order_relaxed);
+        if ((t - m_head.load(std::memory_order_acquire)) > m_mask) {
+            return false;
+        }
+
+        m_buffer[t & m_mask] = x;
+        m_tail.store(t + 1,std::memory_order_release);
+        return true;
+    }
+
+    /*Consumer only , false when empty*/
+    inline boolean_t pop(T& x) {
+        const uint32_t h = m_head.load(std::memory_order_relaxed);
+        if (h == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        x.swap(m_buffer[h & m_mask]);
+        m_head.store(h + 1,std::memory_order_release);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,332 @@
+/*
+    transfer_patterns module : Per origin airport sequence tries + their index file
+*/
+
+#include "transfer_patterns.hpp"
+
+extern "C" {
+    #include <unistd.h>
+}
+
+static const char k_pattern_magic[8] = { 'T','P','I','D','X','0','0','1' };
+
+struct pattern_header_t {                               /*Index file header*/
+    char magic[8];
+    uint64_t checksum;
+    uint32_t airports;
+    uint32_t reserved;
+};
+
+struct pattern_record_t {                               /*One origin , followed by node_count packed nodes*/
+    uint32_t origin;
+    uint32_t complete;
+    uint32_t node_count;
+    uint32_t reserved;
+};
+
+struct pattern_arrival_t {                              /*A departure that can follow the current sequence*/
+    uint32_t airport;
+    uint64_t land_time;
+
+    inline bool operator< (const pattern_arrival_t& other) const {
+        return (airport != other.airport) ? (airport < other.airport) : (land_time < other.land_time);
+    }
+
+    inline bool operator== (const pattern_arrival_t& other) const {
+        return (airport == other.airport) && (land_time == other.land_time);
+    }
+};
+
+struct pattern_build_t {
+    pattern_trie_t* trie;
+    uint64_t max_layover_time;
+    uint32_t max_nodes;
+    uint64_t visited[k_visited_words];                  /*Airports of the current sequence*/
+    std::vector<std::vector<pattern_arrival_t> > arrivals; /*Per depth scratch*/
+};
+
+static const uint32_t k_pattern_field_max = 0xffff;     /*Packed node fields are 16 bits*/
+
+/*Packed node : airport | children << 16*/
+static inline uint32_t tp_pack(const pattern_node_t& n) {
+    if ((n.airport > k_pattern_field_max) || (n.child_count > k_pattern_field_max)) {
+        printf("Transfer patterns : node (airport %u , %u children) doesn't fit in 16 bits\n",n.airport,n.child_count);
+        assert(0);
+    }
+
+    return n.airport | (n.child_count << 16);
+}
+
+static inline void tp_set_reach(pattern_trie_t& trie,const uint32_t node) {
+    pattern_node_t& n = trie.nodes[node];
+
+    for (uint32_t w = 0;w < k_visited_words;++w) {
+        n.reach[w] = 0;
+    }
+    n.reach[travel_t::visited_word(n.airport)] |= travel_t::visited_mask(n.airport);
+
+    for (uint32_t c = n.first_child,c_end = n.first_child + n.child_count;c < c_end;++c) {
+        for (uint32_t w = 0;w < k_visited_words;++w) {
+            n.reach[w] |= trie.nodes[c].reach[w];
+        }
+    }
+}
+
+uint64_t tp_checksum(const uint64_t max_layover_time) {
+    uint64_t h = 14695981039346656037ULL; //FNV-1a
+    const uint64_t words[2] = { max_layover_time , (uint64_t)fi_airports() };
+
+    #define TP_HASH(ptr,len) for (size_t i = 0,j = (len);i < j;++i) { h = (h ^ ((const uint8_t*)(ptr))[i]) * 1099511628211ULL; }
+    TP_HASH(words,sizeof(words));
+    TP_HASH(&g_flight_index.departures_offset[0],g_flight_index.departures_offset.size() * sizeof(uint32_t));
+    TP_HASH(&g_flight_index.departures_take_off[0],g_flight_index.departures_take_off.size() * sizeof(uint64_t));
+    TP_HASH(&g_flight_index.departures_land[0],g_flight_index.departures_land.size() * sizeof(uint64_t));
+    TP_HASH(&g_flight_index.departures_to[0],g_flight_index.departures_to.size() * sizeof(uint32_t));
+    #undef TP_HASH
+
+    return h;
+}
+
+/*
+    Children of node : every departure from its airport that takes off within (land,land + max layover] of one of
+    the flights that can end the sequence (lands , sorted) , grouped by arrival. The origin takes any departure.
+*/
+static boolean_t tp_expand(pattern_build_t& b,const uint32_t node,const pattern_arrival_t* lands,const uint32_t land_count,
+                           const uint32_t depth) {
+    pattern_trie_t& trie = *b.trie;
+    std::vector<pattern_arrival_t>& next = b.arrivals[depth];
+    const uint32_t airport = trie.nodes[node].airport;
+    const uint64_t* take_off = &g_flight_index.departures_take_off[0];
+    const uint64_t* land = &g_flight_index.departures_land[0];
+    const uint32_t* arrival = &g_flight_index.departures_to[0];
+    uint32_t first,last;
+
+    if (0 == depth) {
+        first = g_flight_index.departures_offset[airport];
+        last = fi_departures_end(airport);
+    } else {
+        fi_departures_window(airport,lands[0].land_time + 1,lands[land_count - 1].land_time + b.max_layover_time,first,last);
+    }
+
+    next.clear();
+    for (uint32_t q = first,i = 0;q < last;++q) {
+        const uint32_t a = arrival[q];
+
+        if (b.visited[travel_t::visited_word(a)] & travel_t::visited_mask(a)) {
+            continue;
+        }
+
+        if (depth > 0) { //Latest landing that is still within max layover , take off times only grow
+            while ((i < land_count) && (lands[i].land_time + b.max_layover_time < take_off[q])) {
+                ++i;
+            }
+            if ((i == land_count) || (lands[i].land_time >= take_off[q])) {
+                continue;
+            }
+        }
+
+        pattern_arrival_t p;
+        p.airport = a;
+        p.land_time = land[q];
+        next.push_back(p);
+    }
+
+    std::sort(next.begin(),next.end());
+    next.erase(std::unique(next.begin(),next.end()),next.end());
+
+    //Children block
+    trie.nodes[node].first_child = (uint32_t)trie.nodes.size();
+    trie.nodes[node].child_count = 0;
+    for (uint32_t i = 0,j = (uint32_t)next.size();i < j;++i) {
+        if ((i > 0) && (next[i].airport == next[i - 1].airport)) {
+            continue;
+        }
+
+        pattern_node_t n;
+        n.airport = next[i].airport;
+        n.first_child = n.child_count = 0;
+        trie.nodes.push_back(n);
+        ++trie.nodes[node].child_count;
+    }
+
+    if (trie.nodes.size() > b.max_nodes) {
+        return false;
+    }
+
+    //Then every child , with the landings of its own group
+    for (uint32_t i = 0,j = (uint32_t)next.size(),c = trie.nodes[node].first_child;i < j;++c) {
+        const uint32_t a = next[i].airport;
+        uint32_t k = i;
+
+        while ((k < j) && (next[k].airport == a)) {
+            ++k;
+        }
+
+        b.visited[travel_t::visited_word(a)] |= travel_t::visited_mask(a);
+        const boolean_t ok = tp_expand(b,c,&next[i],k - i,depth + 1);
+        b.visited[travel_t::visited_word(a)] &= ~travel_t::visited_mask(a);
+
+        if (!ok) {
+            return false;
+        }
+        i = k;
+    }
+
+    tp_set_reach(trie,node);
+    return true;
+}
+
+boolean_t tp_build(pattern_trie_t& trie,const uint32_t origin,const uint64_t max_layover_time,const uint32_t max_nodes) {
+    pattern_build_t b;
+    pattern_node_t root;
+
+    trie.origin = origin;
+    trie.complete = false;
+    trie.nodes.clear();
+
+    if (fi_airports() > (k_pattern_field_max + 1)) { //Airport ids (and so child counts) wouldn't fit a packed node
+        return false;
+    }
+
+    root.airport = origin;
+    root.first_child = root.child_count = 0;
+    trie.nodes.push_back(root);
+
+    b.trie = &trie;
+    b.max_layover_time = max_layover_time;
+    b.max_nodes = max_nodes;
+    b.arrivals.resize(fi_airports() + 1);
+    for (uint32_t w = 0;w < k_visited_words;++w) {
+        b.visited[w] = 0;
+    }
+    b.visited[travel_t::visited_word(origin)] |= travel_t::visited_mask(origin);
+
+    trie.complete = tp_expand(b,0,0,0,0);
+    if (!trie.complete) {
+        std::vector<pattern_node_t>().swap(trie.nodes);
+    }
+
+    return trie.complete;
+}
+
+/*Children offsets in build order (see tp_expand) , then reach bits bottom up*/
+static void tp_link(pattern_trie_t& trie,const uint32_t node,uint32_t& next) {
+    pattern_node_t& n = trie.nodes[node];
+
+    n.first_child = next;
+    next += n.child_count;
+
+    for (uint32_t c = n.first_child,c_end = n.first_child + n.child_count;c < c_end;++c) {
+        tp_link(trie,c,next);
+    }
+
+    tp_set_reach(trie,node);
+}
+
+void tp_clear(transfer_patterns_t& patterns) {
+    patterns.tries.clear();
+    patterns.state.clear();
+    patterns.airport.clear();
+}
+
+boolean_t tp_open(transfer_patterns_t& patterns,const std::string& path,FILE*& file) {
+    const uint32_t airports = fi_airports();
+    pattern_header_t header;
+    long good;
+
+    patterns.tries.assign(airports,pattern_trie_t());
+    patterns.state.assign(airports,(uint8_t)pattern_state_missing);
+
+    file = fopen(path.c_str(),"r+b");
+    if ((file != 0) && ((fread(&header,sizeof(header),1,file) != 1) || (0 != memcmp(header.magic,k_pattern_magic,sizeof(k_pattern_magic))) ||
+        (header.checksum != patterns.checksum) || (header.airports != airports))) {
+        fclose(file);
+        file = 0;
+    }
+
+    if (0 == file) { //New or stale : start over
+        file = fopen(path.c_str(),"w+b");
+        if (0 == file) {
+            return false;
+        }
+
+        memset(&header,0,sizeof(header));
+        memcpy(header.magic,k_pattern_magic,sizeof(k_pattern_magic));
+        header.checksum = patterns.checksum;
+        header.airports = airports;
+        if (fwrite(&header,sizeof(header),1,file) != 1) {
+            fclose(file);
+            file = 0;
+            return false;
+        }
+        fflush(file);
+        return true;
+    }
+
+    //Records up to the first torn one (interrupted build)
+    good = ftell(file);
+    for (;;) {
+        pattern_record_t record;
+        std::vector<uint32_t> packed;
+
+        if ((fread(&record,sizeof(record),1,file) != 1) || (record.origin >= airports) || (record.node_count > k_pattern_max_nodes)) {
+            break;
+        }
+
+        packed.resize(record.node_count);
+        if ((record.node_count > 0) && (fread(&packed[0],sizeof(uint32_t),record.node_count,file) != record.node_count)) {
+            break;
+        }
+
+        pattern_trie_t& trie = patterns.tries[record.origin];
+        trie.origin = record.origin;
+        trie.complete = (0 != record.complete) && (record.node_count > 0);
+        trie.nodes.resize(record.node_count);
+        for (uint32_t i = 0;i < record.node_count;++i) {
+            trie.nodes[i].airport = packed[i] & 0xffff;
+            trie.nodes[i].child_count = packed[i] >> 16;
+        }
+
+        if (trie.complete) {
+            uint32_t next = 1;
+            tp_link(trie,0,next);
+            if (next != record.node_count) { //Doesn't add up : corrupt
+                trie.nodes.clear();
+                break;
+            }
+        }
+
+        patterns.state[record.origin] = (uint8_t)((trie.complete) ? pattern_state_ready : pattern_state_skipped);
+        good = ftell(file);
+    }
+
+    fflush(file);
+    if ((0 != ftruncate(fileno(file),good)) || (0 != fseek(file,good,SEEK_SET))) {
+        fclose(file);
+        file = 0;
+        return false;
+    }
+
+    return true;
+}
+
+boolean_t tp_append(FILE* file,const pattern_trie_t& trie) {
+    pattern_record_t record;
+    std::vector<uint32_t> packed(trie.nodes.size());
+
+    record.origin = trie.origin;
+    record.complete = (trie.complete) ? 1 : 0;
+    record.node_count = (uint32_t)trie.nodes.size();
+    record.reserved = 0;
+
+    for (uint32_t i = 0;i < record.node_count;++i) {
+        packed[i] = tp_pack(trie.nodes[i]);
+    }
+
+    if ((fwrite(&record,sizeof(record),1,file) != 1) ||
+        ((record.node_count > 0) && (fwrite(&packed[0],sizeof(uint32_t),record.node_count,file) != record.node_count))) {
+        return false;
+    }
+
+    return 0 == fflush(file);
+}
@@ -0,0 +1,83 @@
+#ifndef _transfer_patterns_hpp_
+#define _transfer_patterns_hpp_
+/*
+    transfer_patterns module : Airport sequences a travel can follow , precomputed per origin and kept on disk
+    The patterns of an origin form a trie : a node is a simple airport sequence (origin,a1,..,ak) that some chain of
+    flights follows anywhere in the schedule under max layover. A travel of any query window follows one of them ,
+    so compute_path from that origin only has to try the departures whose arrival is a child of the current node
+    and can still lead to the destination (reach bits of the child).
+    Index file : header + one record per origin , appended as soon as the origin is done so an interrupted build
+    resumes where it stopped. Nodes are stored as (airport,children) in expansion order , 4 bytes each (16 bits each ,
+    tp_build leaves an origin to compute_path past that) , children offsets and reach bits are rebuilt at load time.
+    Reach bits are travel_t::visited bits : a schedule of more than k_visited_bits (256) airports gets no index at all.
+*/
+#include "flight_index.hpp"
+
+static const uint32_t k_pattern_none = (uint32_t)std::numeric_limits<uint32_t>::max();
+static const uint32_t k_pattern_max_nodes = 4 * 1024 * 1024;   /*Per origin , past that the origin is left to compute_path*/
+
+struct pattern_node_t {
+    uint32_t airport;                                   /*Dense id of the last airport of the sequence*/
+    uint32_t first_child,child_count;                   /*Children [first_child,first_child + child_count) , sorted by airport*/
+    uint64_t reach[k_visited_words];                    /*Airports this sequence or a longer one ends at (travel_t::visited bits)*/
+};
+
+struct pattern_trie_t {
+    uint32_t origin;                                    /*Dense id of the origin airport (node 0)*/
+    boolean_t complete;                                 /*False : too many patterns , nodes is empty*/
+    std::vector<pattern_node_t> nodes;
+};
+
+enum pattern_state_t {
+    pattern_state_missing = 0,                          /*Not built yet*/
+    pattern_state_ready,                                /*Complete trie*/
+    pattern_state_skipped                               /*Built but too large , compute_path as usual*/
+};
+
+struct transfer_patterns_t {
+    uint64_t checksum;                                  /*tp_checksum of the whole schedule's flight index*/
+    std::vector<pattern_trie_t> tries;                  /*Per origin dense id (whole schedule)*/
+    std::vector<uint8_t> state;                         /*pattern_state_t per origin*/
+    std::vector<uint32_t> airport;                      /*Dense id of the session's flight index -> dense id of the whole schedule*/
+};
+
+/*
+    Flight index + max layover fingerprint , an index file built for another network is rebuilt.
+    Taken on the index of the whole schedule (untrimmed by the time windows) , so changing the query window keeps it.
+*/
+uint64_t tp_checksum(const uint64_t max_layover_time);
+
+/*Builds the trie of origin (thread safe , reads g_flight_index only) , false if it went past max_nodes*/
+boolean_t tp_build(pattern_trie_t& trie,const uint32_t origin,const uint64_t max_layover_time,const uint32_t max_nodes);
+
+/*Loads the records of path into patterns (sized for fi_airports()) , a missing or stale file is started over*/
+boolean_t tp_open(transfer_patterns_t& patterns,const std::string& path,FILE*& file);
+
+/*Appends the record of trie (complete or not) and flushes it*/
+boolean_t tp_append(FILE* file,const pattern_trie_t& trie);
+
+void tp_clear(transfer_patterns_t& patterns);
+
+/*Child of node with airport , k_pattern_none if that sequence never happens*/
+static inline uint32_t tp_child(const pattern_trie_t& trie,const uint32_t node,const uint32_t airport) {
+    const pattern_node_t& n = trie.nodes[node];
+    uint32_t lo = n.first_child,hi = n.first_child + n.child_count;
+
+    while (lo < hi) {
+        const uint32_t mid = (lo + hi) >> 1;
+        if (trie.nodes[mid].airport < airport) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return ((lo < n.first_child + n.child_count) && (trie.nodes[lo].airport == airport)) ? lo : k_pattern_none;
+}
+
+/*Some travel following node's sequence can end at airport*/
+static inline boolean_t tp_reaches(const pattern_trie_t& trie,const uint32_t node,const uint32_t airport) {
+    return 0 != (trie.nodes[node].reach[travel_t::visited_word(airport)] & travel_t::visited_mask(airport));
+}
+
+#endif
@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits>
+#include <algorithm>
 
 
 typedef int32_t boolean_t;
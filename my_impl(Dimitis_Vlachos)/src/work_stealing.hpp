@@ -0,0 +1,111 @@
+#ifndef _work_stealing_hpp_
+#define _work_stealing_hpp_
+/*
+    Chase-Lev work stealing deque (fixed capacity).
+    The owner thread pushes/pops at the bottom , any other thread steals from the top.
+    Memory orderings follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013).
+*/
+#include "types.hpp"
+#include <atomic>
+
+enum steal_result_t {
+    steal_result_ok = 0,
+    steal_result_empty = 1,
+    steal_result_abort = 2,                                                   /*Lost a race , retry*/
+};
+
+class chase_lev_deque_c {
+    private:
+    std::atomic<int64_t> m_top;
+    std::atomic<int64_t> m_bottom;
+    std::atomic<uint32_t>* m_buffer;
+    int64_t m_mask;
+
+    chase_lev_deque_c(const chase_lev_deque_c&);
+    chase_lev_deque_c& operator= (const chase_lev_deque_c&);
+
+    public:
+    chase_lev_deque_c() : m_top(0) , m_bottom(0) , m_buffer(0) , m_mask(-1) {}
+    ~chase_lev_deque_c() { shutdown(); }
+
+    /*Not thread safe : call it only while no other thread touches the deque*/
+    void init(const uint32_t capacity) {
+        int64_t len = 1;
+        while (len < (int64_t)capacity) {
+            len <<= 1;
+        }
+
+        if ((len - 1) != m_mask) {
+            delete[] m_buffer;
+            m_buffer = new std::atomic<uint32_t>[len];
+            assert(m_buffer != 0);
+            m_mask = len - 1;
+        }
+
+        m_top.store(0,std::memory_order_relaxed);
+        m_bottom.store(0,std::memory_order_relaxed);
+    }
+
+    void shutdown() {
+        delete[] m_buffer;
+        m_buffer = 0;
+        m_mask = -1;
+    }
+
+    /*Owner only*/
+    inline boolean_t push(const uint32_t x) {
+        const int64_t b = m_bottom.load(std::memory_order_relaxed);
+        const int64_t t = m_top.load(std::memory_order_acquire);
+
+        if ((b - t) > m_mask) { //Full
+            return false;
+        }
+
+        m_buffer[b & m_mask].store(x,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1,std::memory_order_relaxed);
+        return true;
+    }
+
+    /*Owner only*/
+    inline boolean_t pop(uint32_t& x) {
+        const int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(b,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) { //Empty
+            m_bottom.store(b + 1,std::memory_order_relaxed);
+            return false;
+        }
+
+        x = m_buffer[b & m_mask].load(std::memory_order_relaxed);
+        if (t == b) { //Last element , race against thieves
+            const boolean_t won = m_top.compare_exchange_strong(t,t + 1,std::memory_order_seq_cst,std::memory_order_relaxed);
+            m_bottom.store(b + 1,std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    /*Any thread*/
+    inline steal_result_t steal(uint32_t& x) {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return steal_result_empty;
+        }
+
+        x = m_buffer[t & m_mask].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(t,t + 1,std::memory_order_seq_cst,std::memory_order_relaxed)) {
+            return steal_result_abort;
+        }
+
+        return steal_result_ok;
+    }
+};
+
+#endif